@@ -0,0 +1,149 @@
+/**
+ * Throughput of the concurrent hashtable against a hashtable behind one global mutex, from 1 thread
+ * up to the number of online CPUs, for a read-mostly mix (90% lookups) and a 50/50 mix of lookups and
+ * writes.  Writes are split evenly between inserts and removes, so the table size stays about the same
+ *
+ *   chashtable_bench [max threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "hashtable.h"
+#include "chashtable.h"
+
+#define KEYS        (1 << 16)
+#define OPS         (1 << 20)       /* Per thread */
+#define MAX_THREADS 256
+
+typedef struct  {
+    int     locked;         /* Nonzero to use the mutex wrapped hashtable */
+    int     read_percent;
+    int     seed;
+} worker_args;
+
+static int _keys[KEYS];
+static chashtable _cht;
+static hashtable _ht;
+static pthread_mutex_t _ht_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int _hash(const void* key)   {
+    return *(const int*)key;
+}
+
+static int _match(const void* key1, const void* key2)   {
+    return *(const int*)key1 == *(const int*)key2;
+}
+
+static void* _worker(void* arg) {
+    worker_args* args = (worker_args*)arg;
+    uint32_t x = args->seed * 2654435761u + 1;
+    unsigned long sink;
+    void* data;
+    int i, op;
+
+    sink = 0;
+    for (i = 0; i < OPS; i++)   {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data = &_keys[x % KEYS];
+        op = (x >> 16) % 100;
+
+        if (args->locked)   {
+            pthread_mutex_lock(&_ht_lock);
+        }
+
+        if (op < args->read_percent)    {
+            sink += args->locked? ht_lookup(&_ht, &data) : cht_lookup(&_cht, &data);
+        } else if (op % 2)  {
+            sink += args->locked? ht_insert(&_ht, data) : cht_insert(&_cht, data);
+        } else {
+            sink += args->locked? ht_remove(&_ht, &data) : cht_remove(&_cht, &data);
+        }
+
+        if (args->locked)   {
+            pthread_mutex_unlock(&_ht_lock);
+        }
+    }
+
+    return (void*)sink;
+}
+
+/**
+ * Returns millions of operations per second with the given number of threads
+ */
+static double _run(int locked, int read_percent, int threads)   {
+    pthread_t tids[MAX_THREADS];
+    worker_args args[MAX_THREADS];
+    struct timespec start, end;
+    double seconds;
+    int i;
+
+    if (locked) {
+        ht_init_engine(&_ht, HT_ENGINE_OPEN, KEYS, _hash, _match, 0);
+    } else {
+        cht_init(&_cht, KEYS, _hash, _match, 0);
+    }
+
+    for (i = 0; i < KEYS; i += 2)   {
+        if (locked) {
+            ht_insert(&_ht, &_keys[i]);
+        } else {
+            cht_insert(&_cht, &_keys[i]);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threads; i++)   {
+        args[i].locked = locked;
+        args[i].read_percent = read_percent;
+        args[i].seed = i + 1;
+        pthread_create(&tids[i], 0, _worker, &args[i]);
+    }
+
+    for (i = 0; i < threads; i++)   {
+        pthread_join(tids[i], 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (locked) {
+        ht_destroy(&_ht);
+    } else {
+        cht_destroy(&_cht);
+    }
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)OPS * threads / seconds / 1e6;
+}
+
+int main(int argc, char** argv) {
+    static const int mixes[] = { 90, 50 };
+    int cpus, threads, m, i;
+
+    for (i = 0; i < KEYS; i++)  {
+        _keys[i] = i;
+    }
+
+    cpus = argc > 1? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1 || cpus > MAX_THREADS)  {
+        cpus = cpus < 1? 1 : MAX_THREADS;
+    }
+
+    printf("%d keys, %d operations per thread, Mops/s\n", KEYS, OPS);
+    for (m = 0; m < 2; m++) {
+        printf("%d%% lookups\n  threads   chashtable   hashtable+mutex\n", mixes[m]);
+        for (threads = 1; ; threads = threads * 2 < cpus? threads * 2 : cpus)   {
+            printf("  %7d   %10.2f   %15.2f\n", threads, _run(0, mixes[m], threads), _run(1, mixes[m], threads));
+            if (threads == cpus)    {
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
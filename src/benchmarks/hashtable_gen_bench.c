@@ -0,0 +1,245 @@
+/**
+ * Compares a table generated by HT_DECLARE against the callback based hashtable (both engines) for
+ * uint64_t keys and short string keys: insert speed, and the speed of lookups that hit and that miss.
+ * The callback tables hold boxed key/value pairs, which is what a user of hashtable has to do
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "platform.h"
+#include "hashtable.h"
+#include "hashtable_gen.h"
+
+#define KEYS        500000
+#define REPEATS     10
+
+HT_DECLARE(u64_map, uint64_t, uint64_t, ht_gen_hash_u64, ht_gen_eq_u64)
+HT_DECLARE(str_map, const char*, int, ht_gen_hash_str, ht_gen_eq_str)
+
+typedef struct  {
+    uint64_t key;
+    uint64_t val;
+} u64_pair;
+
+typedef struct  {
+    const char* key;
+    int val;
+} str_pair;
+
+static int _hash_u64(const void* key)   {
+    return (int)ht_gen_hash_u64(((const u64_pair*)key)->key);
+}
+
+static int _match_u64(const void* key1, const void* key2)   {
+    return ((const u64_pair*)key1)->key == ((const u64_pair*)key2)->key;
+}
+
+static int _hash_str(const void* key)   {
+    return (int)ht_gen_hash_str(((const str_pair*)key)->key);
+}
+
+static int _match_str(const void* key1, const void* key2)   {
+    return !strcmp(((const str_pair*)key1)->key, ((const str_pair*)key2)->key);
+}
+
+static double _elapsed_ns(clock_t start, int operations)    {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / operations;
+}
+
+static void _report(const char* name, double insert_ns, double hit_ns, double miss_ns, uint64_t sink)  {
+    printf("  %-22s %8.1f %8.1f %8.1f   (%llu)\n", name, insert_ns, hit_ns, miss_ns, (unsigned long long)sink);
+}
+
+static void _bench_u64(uint64_t* keys, uint64_t* missing)   {
+    u64_pair* pairs;
+    u64_pair probe;
+    hashtable ht;
+    u64_map m;
+    clock_t start;
+    double insert_ns, hit_ns, miss_ns;
+    uint64_t sink;
+    uint64_t* val;
+    void* data;
+    int engine, i, r;
+
+    sink = 0;
+    start = clock();
+    u64_map_init(&m, 0);
+    for (i = 0; i < KEYS; i++)  {
+        u64_map_put(&m, keys[i], i);
+    }
+    insert_ns = _elapsed_ns(start, KEYS);
+
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        for (i = 0; i < KEYS; i++)  {
+            if ((val = u64_map_get(&m, keys[i])) != 0)   {
+                sink += *val;
+            }
+        }
+    }
+    hit_ns = _elapsed_ns(start, REPEATS * KEYS);
+
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        for (i = 0; i < KEYS; i++)  {
+            sink += u64_map_get(&m, missing[i]) != 0;
+        }
+    }
+    miss_ns = _elapsed_ns(start, REPEATS * KEYS);
+    _report("HT_DECLARE", insert_ns, hit_ns, miss_ns, sink);
+    u64_map_destroy(&m);
+
+    for (engine = HT_ENGINE_CHAINED; engine <= HT_ENGINE_OPEN; engine++)    {
+        sink = 0;
+        start = clock();
+        pairs = (u64_pair*)malloc(KEYS * sizeof(u64_pair));
+        ht_init_engine(&ht, engine, 16, _hash_u64, _match_u64, 0);
+        for (i = 0; i < KEYS; i++)  {
+            pairs[i].key = keys[i];
+            pairs[i].val = i;
+            ht_insert(&ht, &pairs[i]);
+        }
+        insert_ns = _elapsed_ns(start, KEYS);
+
+        start = clock();
+        for (r = 0; r < REPEATS; r++)   {
+            for (i = 0; i < KEYS; i++)  {
+                probe.key = keys[i];
+                data = &probe;
+                if (ht_lookup(&ht, &data) == 0) {
+                    sink += ((u64_pair*)data)->val;
+                }
+            }
+        }
+        hit_ns = _elapsed_ns(start, REPEATS * KEYS);
+
+        start = clock();
+        for (r = 0; r < REPEATS; r++)   {
+            for (i = 0; i < KEYS; i++)  {
+                probe.key = missing[i];
+                data = &probe;
+                sink += ht_lookup(&ht, &data) == 0;
+            }
+        }
+        miss_ns = _elapsed_ns(start, REPEATS * KEYS);
+        _report(engine == HT_ENGINE_OPEN? "hashtable (open)" : "hashtable (chained)", insert_ns, hit_ns, miss_ns, sink);
+
+        ht_destroy(&ht);
+        free(pairs);
+    }
+}
+
+static void _bench_str(char** keys, char** missing) {
+    str_pair* pairs;
+    str_pair probe;
+    hashtable ht;
+    str_map m;
+    clock_t start;
+    double insert_ns, hit_ns, miss_ns;
+    uint64_t sink;
+    int* val;
+    void* data;
+    int engine, i, r;
+
+    sink = 0;
+    start = clock();
+    str_map_init(&m, 0);
+    for (i = 0; i < KEYS; i++)  {
+        str_map_put(&m, keys[i], i);
+    }
+    insert_ns = _elapsed_ns(start, KEYS);
+
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        for (i = 0; i < KEYS; i++)  {
+            if ((val = str_map_get(&m, keys[i])) != 0)   {
+                sink += *val;
+            }
+        }
+    }
+    hit_ns = _elapsed_ns(start, REPEATS * KEYS);
+
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        for (i = 0; i < KEYS; i++)  {
+            sink += str_map_get(&m, missing[i]) != 0;
+        }
+    }
+    miss_ns = _elapsed_ns(start, REPEATS * KEYS);
+    _report("HT_DECLARE", insert_ns, hit_ns, miss_ns, sink);
+    str_map_destroy(&m);
+
+    for (engine = HT_ENGINE_CHAINED; engine <= HT_ENGINE_OPEN; engine++)    {
+        sink = 0;
+        start = clock();
+        pairs = (str_pair*)malloc(KEYS * sizeof(str_pair));
+        ht_init_engine(&ht, engine, 16, _hash_str, _match_str, 0);
+        for (i = 0; i < KEYS; i++)  {
+            pairs[i].key = keys[i];
+            pairs[i].val = i;
+            ht_insert(&ht, &pairs[i]);
+        }
+        insert_ns = _elapsed_ns(start, KEYS);
+
+        start = clock();
+        for (r = 0; r < REPEATS; r++)   {
+            for (i = 0; i < KEYS; i++)  {
+                probe.key = keys[i];
+                data = &probe;
+                if (ht_lookup(&ht, &data) == 0) {
+                    sink += ((str_pair*)data)->val;
+                }
+            }
+        }
+        hit_ns = _elapsed_ns(start, REPEATS * KEYS);
+
+        start = clock();
+        for (r = 0; r < REPEATS; r++)   {
+            for (i = 0; i < KEYS; i++)  {
+                probe.key = missing[i];
+                data = &probe;
+                sink += ht_lookup(&ht, &data) == 0;
+            }
+        }
+        miss_ns = _elapsed_ns(start, REPEATS * KEYS);
+        _report(engine == HT_ENGINE_OPEN? "hashtable (open)" : "hashtable (chained)", insert_ns, hit_ns, miss_ns, sink);
+
+        ht_destroy(&ht);
+        free(pairs);
+    }
+}
+
+int main(void)  {
+    static uint64_t keys[KEYS], missing[KEYS];
+    static char* str_keys[KEYS];
+    static char* str_missing[KEYS];
+    char buf[32];
+    int i;
+
+    for (i = 0; i < KEYS; i++)  {
+        keys[i] = (uint64_t)i * 0x9e3779b97f4a7c15ULL;
+        missing[i] = keys[i] + 1;
+
+        sprintf(buf, "k%d", i);
+        str_keys[i] = xp_strdup(buf);
+        sprintf(buf, "m%d", i);
+        str_missing[i] = xp_strdup(buf);
+    }
+
+    printf("%d keys, ns per operation:  insert      hit     miss\n", KEYS);
+    printf("uint64_t keys\n");
+    _bench_u64(keys, missing);
+    printf("short string keys\n");
+    _bench_str(str_keys, str_missing);
+
+    for (i = 0; i < KEYS; i++)  {
+        free(str_keys[i]);
+        free(str_missing[i]);
+    }
+
+    return 0;
+}
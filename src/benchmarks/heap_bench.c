@@ -0,0 +1,104 @@
+/**
+ * Time to hold "pending" timeouts and repeatedly fire the earliest and schedule a new one, with the
+ * timeouts in a sorted list (the way they were kept before) and in a heap
+ *
+ *   heap_bench [operations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "list.h"
+#include "heap.h"
+
+#define DEFAULT_OPERATIONS  (1 << 20)
+
+static uint32_t _x = 2463534242u;
+
+static size_t _next_timeout(size_t now)  {
+    _x ^= _x << 13;
+    _x ^= _x >> 17;
+    _x ^= _x << 5;
+    return now + 1 + _x % 100000;
+}
+
+static int _compare(const void* key1, const void* key2) {
+    size_t a = (size_t)key1, b = (size_t)key2;
+
+    return a < b? -1 : a > b;
+}
+
+static double _elapsed_ns(clock_t start, long operations)   {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / operations;
+}
+
+/**
+ * Inserts the timeout after every one due no later than it
+ */
+static void _list_insert(list* l, size_t timeout)    {
+    list_element* prev = 0;
+    list_element* e;
+
+    for (e = list_head(l); e && (size_t)list_data(e) <= timeout; e = list_next(e))  {
+        prev = e;
+    }
+
+    list_insert_next(l, prev, (void*)timeout);
+}
+
+static void _bench_list(int pending, long operations)   {
+    clock_t start;
+    void* data;
+    long i;
+    list l;
+
+    list_init(&l, 0);
+    for (i = 0; i < pending; i++)   {
+        _list_insert(&l, _next_timeout(0));
+    }
+
+    start = clock();
+    for (i = 0; i < operations; i++)    {
+        list_remove_next(&l, 0, &data);
+        _list_insert(&l, _next_timeout((size_t)data));
+    }
+
+    printf("sorted list  %6d pending  %10.1f ns/op\n", pending, _elapsed_ns(start, operations));
+    list_destroy(&l);
+}
+
+static void _bench_heap(int pending, long operations)   {
+    clock_t start;
+    void* data;
+    long i;
+    heap h;
+
+    heap_init(&h, pending, _compare, 0);
+    for (i = 0; i < pending; i++)   {
+        heap_push(&h, (void*)_next_timeout(0));
+    }
+
+    start = clock();
+    for (i = 0; i < operations; i++)    {
+        heap_pop(&h, &data);
+        heap_push(&h, (void*)_next_timeout((size_t)data));
+    }
+
+    printf("4-ary heap   %6d pending  %10.1f ns/op\n", pending, _elapsed_ns(start, operations));
+    heap_destroy(&h);
+}
+
+int main(int argc, char** argv) {
+    long operations = argc > 1? atol(argv[1]) : DEFAULT_OPERATIONS;
+    int pending;
+
+    for (pending = 16; pending <= 65536; pending *= 16)  {
+        // A sorted list insert is a walk of half the list, so give it proportionally fewer operations
+        _bench_list(pending, operations / (pending / 16));
+        _bench_heap(pending, operations);
+    }
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * Time to walk a list and sum its values, for a list whose nodes were allocated in order (close to the
+ * best case for list), a list whose nodes were linked in random order (like a list built up while the
+ * rest of a program allocates and frees), and an unrolled list
+ *
+ *   list_bench [values]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "list.h"
+#include "ulist.h"
+
+#define DEFAULT_VALUES  (1 << 22)
+#define REPEATS         5
+
+static double _elapsed_ns(clock_t start, long operations)   {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / operations;
+}
+
+static void _bench_list(const char* name, list* l)  {
+    list_element* e;
+    clock_t start;
+    size_t sum;
+    int r;
+
+    sum = 0;
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        for (e = list_head(l); e; e = list_next(e)) {
+            sum += (size_t)list_data(e);
+        }
+    }
+
+    printf("%-24s %6.2f ns/value   (sum %zu)\n", name, _elapsed_ns(start, (long)REPEATS * list_size(l)), sum);
+}
+
+/**
+ * Builds a list from "count" nodes allocated up front, linked in random order
+ */
+static void _scatter(list* l, list_element** nodes, int count)  {
+    list_element* tmp;
+    uint32_t x = 2463534242u;
+    int i, j;
+
+    for (i = 0; i < count; i++) {
+        nodes[i] = (list_element*)malloc(sizeof(list_element));
+        nodes[i]->data = (void*)(size_t)i;
+    }
+
+    for (i = count - 1; i > 0; i--) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        j = x % (i + 1);
+        tmp = nodes[i];
+        nodes[i] = nodes[j];
+        nodes[j] = tmp;
+    }
+
+    list_init(l, 0);
+    for (i = 0; i < count; i++) {
+        nodes[i]->next = i + 1 < count? nodes[i + 1] : 0;
+    }
+    l->head = nodes[0];
+    l->tail = nodes[count - 1];
+    l->size = count;
+}
+
+int main(int argc, char** argv) {
+    list_element** nodes;
+    void** e;
+    clock_t start;
+    size_t sum;
+    list l;
+    ulist u;
+    int count, i, r;
+
+    count = argc > 1? atoi(argv[1]) : DEFAULT_VALUES;
+    if (count < 1 || (nodes = (list_element**)malloc(count * sizeof(list_element*))) == 0) {
+        fprintf(stderr, "usage: list_bench [values]\n");
+        return 1;
+    }
+
+    printf("%d values, %d walks each\n", count, REPEATS);
+
+    list_init(&l, 0);
+    for (i = 0; i < count; i++) {
+        list_insert_next(&l, list_tail(&l), (void*)(size_t)i);
+    }
+    _bench_list("list (allocated in order)", &l);
+    list_destroy(&l);
+
+    _scatter(&l, nodes, count);
+    _bench_list("list (scattered)", &l);
+    list_destroy(&l);
+
+    ulist_init(&u, 0);
+    for (i = 0; i < count; i++) {
+        ulist_append(&u, (void*)(size_t)i);
+    }
+
+    sum = 0;
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        for (e = ulist_head(&u); e; e = ulist_next(e))  {
+            sum += (size_t)ulist_data(e);
+        }
+    }
+    printf("%-24s %6.2f ns/value   (sum %zu)\n", "ulist", _elapsed_ns(start, (long)REPEATS * count), sum);
+    ulist_destroy(&u);
+
+    free(nodes);
+    return 0;
+}
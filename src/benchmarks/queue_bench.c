@@ -0,0 +1,265 @@
+/**
+ * Throughput of the lock-free queues against a list behind a mutex, for one producer and one consumer,
+ * N producers and one consumer, and N of each, moving single values and batches of QUEUE_BATCH.  Then
+ * the round trip latency of bouncing one value between two threads through a pair of queues
+ *
+ *   queue_bench [N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "list.h"
+#include "queue.h"
+
+#define MESSAGES        (1 << 22)   /* In total, split between the producers */
+#define ROUND_TRIPS     (1 << 16)
+#define CAPACITY        1024
+#define QUEUE_BATCH     32
+#define MAX_THREADS     64
+
+/* A list behind one mutex, the way work was handed between threads before */
+typedef struct  {
+    pthread_mutex_t lock;
+    list            l;
+} locked_list;
+
+/* One queue implementation, through pointers so the same loops drive them all */
+typedef struct  {
+    const char* name;
+    int         spsc;           /* Nonzero if only usable with one producer and one consumer */
+    int         (*init)(void* q);
+    void        (*destroy)(void* q);
+    size_t      (*push)(void* q, void* const* data, size_t n);
+    size_t      (*pop)(void* q, void** data, size_t n);
+} queue_impl;
+
+static int _spsc_init(void* q)  { return spsc_init((spsc_queue*)q, CAPACITY); }
+static void _spsc_destroy(void* q)  { spsc_destroy((spsc_queue*)q); }
+static int _mpmc_init(void* q)  { return mpmc_init((mpmc_queue*)q, CAPACITY); }
+static void _mpmc_destroy(void* q)  { mpmc_destroy((mpmc_queue*)q); }
+
+static size_t _spsc_push(void* q, void* const* data, size_t n)  {
+    return n == 1? spsc_push((spsc_queue*)q, data[0]) == 0 : spsc_push_batch((spsc_queue*)q, data, n);
+}
+
+static size_t _spsc_pop(void* q, void** data, size_t n) {
+    return n == 1? spsc_pop((spsc_queue*)q, data) == 0 : spsc_pop_batch((spsc_queue*)q, data, n);
+}
+
+static size_t _mpmc_push(void* q, void* const* data, size_t n)  {
+    return n == 1? mpmc_push((mpmc_queue*)q, data[0]) == 0 : mpmc_push_batch((mpmc_queue*)q, data, n);
+}
+
+static size_t _mpmc_pop(void* q, void** data, size_t n) {
+    return n == 1? mpmc_pop((mpmc_queue*)q, data) == 0 : mpmc_pop_batch((mpmc_queue*)q, data, n);
+}
+
+static int _locked_init(void* q)    {
+    pthread_mutex_init(&((locked_list*)q)->lock, 0);
+    list_init(&((locked_list*)q)->l, 0);
+    return 0;
+}
+
+static void _locked_destroy(void* q)    {
+    list_destroy(&((locked_list*)q)->l);
+    pthread_mutex_destroy(&((locked_list*)q)->lock);
+}
+
+static size_t _locked_push(void* q, void* const* data, size_t n)    {
+    locked_list* ll = (locked_list*)q;
+    size_t i;
+
+    pthread_mutex_lock(&ll->lock);
+    for (i = 0; i < n; i++) {
+        list_insert_next(&ll->l, list_tail(&ll->l), data[i]);
+    }
+    pthread_mutex_unlock(&ll->lock);
+    return n;
+}
+
+static size_t _locked_pop(void* q, void** data, size_t n)   {
+    locked_list* ll = (locked_list*)q;
+    size_t i;
+
+    pthread_mutex_lock(&ll->lock);
+    for (i = 0; i < n && list_remove_next(&ll->l, 0, &data[i]) == 0; i++)   {
+    }
+    pthread_mutex_unlock(&ll->lock);
+    return i;
+}
+
+static const queue_impl _impls[] = {
+    { "spsc",           1, _spsc_init,      _spsc_destroy,      _spsc_push,     _spsc_pop },
+    { "mpmc",           0, _mpmc_init,      _mpmc_destroy,      _mpmc_push,     _mpmc_pop },
+    { "mutex + list",   0, _locked_init,    _locked_destroy,    _locked_push,   _locked_pop }
+};
+
+static union    {
+    spsc_queue  spsc;
+    mpmc_queue  mpmc;
+    locked_list locked;
+} _queues[2];
+
+static const queue_impl* _impl;
+static size_t _batch;
+static int _per_producer;
+static atomic_int _remaining;
+
+static double _now()    {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* _producer(void* arg)   {
+    void* batch[QUEUE_BATCH];
+    size_t i, sent;
+    int done;
+
+    for (i = 0; i < QUEUE_BATCH; i++)   {
+        batch[i] = arg;
+    }
+
+    for (done = 0; done < _per_producer; done += (int)_batch)   {
+        for (sent = 0; sent < _batch;)  {
+            if ((i = _impl->push(&_queues[0], batch + sent, _batch - sent)) == 0) {
+                sched_yield();
+            }
+            sent += i;
+        }
+    }
+
+    return 0;
+}
+
+static void* _consumer(void* arg)   {
+    void* batch[QUEUE_BATCH];
+    size_t n;
+
+    (void)arg;
+    while (atomic_load_explicit(&_remaining, memory_order_relaxed) > 0) {
+        if ((n = _impl->pop(&_queues[0], batch, _batch)) == 0)  {
+            sched_yield();
+        } else {
+            atomic_fetch_sub_explicit(&_remaining, (int)n, memory_order_relaxed);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Prints millions of messages a second through the given queue
+ */
+static void _throughput(const queue_impl* impl, int producers, int consumers, size_t batch)  {
+    pthread_t threads[2 * MAX_THREADS];
+    char config[16];
+    double start;
+    int i;
+
+    _impl = impl;
+    _batch = batch;
+    _per_producer = MESSAGES / producers / (int)batch * (int)batch;
+    atomic_store(&_remaining, _per_producer * producers);
+    impl->init(&_queues[0]);
+
+    start = _now();
+    for (i = 0; i < producers; i++) {
+        pthread_create(&threads[i], 0, _producer, (void*)(size_t)(i + 1));
+    }
+    for (i = 0; i < consumers; i++) {
+        pthread_create(&threads[producers + i], 0, _consumer, 0);
+    }
+    for (i = 0; i < producers + consumers; i++) {
+        pthread_join(threads[i], 0);
+    }
+
+    sprintf(config, "%dP%dC", producers, consumers);
+    printf("%-14s %-7s batch %2d  %8.2f M msgs/s\n", impl->name, config, (int)batch,
+        _per_producer * producers / (_now() - start) / 1e6);
+    impl->destroy(&_queues[0]);
+}
+
+/* Bounces every value it gets from queue 0 back through queue 1 */
+static void* _echo(void* arg)   {
+    void* data;
+    int i;
+
+    (void)arg;
+    for (i = 0; i < ROUND_TRIPS; i++)   {
+        while (_impl->pop(&_queues[0], &data, 1) == 0)  {
+            sched_yield();
+        }
+        while (_impl->push(&_queues[1], &data, 1) == 0) {
+            sched_yield();
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Prints the average time for a value to go to another thread and back
+ */
+static void _latency(const queue_impl* impl)    {
+    pthread_t echo;
+    void* data = &echo;
+    double start;
+    int i;
+
+    _impl = impl;
+    impl->init(&_queues[0]);
+    impl->init(&_queues[1]);
+    pthread_create(&echo, 0, _echo, 0);
+
+    start = _now();
+    for (i = 0; i < ROUND_TRIPS; i++)   {
+        impl->push(&_queues[0], &data, 1);
+        while (impl->pop(&_queues[1], &data, 1) == 0)   {
+            sched_yield();
+        }
+    }
+
+    printf("%-14s round trip %8.0f ns\n", impl->name, (_now() - start) * 1e9 / ROUND_TRIPS);
+    pthread_join(echo, 0);
+    impl->destroy(&_queues[0]);
+    impl->destroy(&_queues[1]);
+}
+
+int main(int argc, char** argv) {
+    int n, i;
+
+    n = argc > 1? atoi(argv[1]) : 4;
+    if (n < 1 || n > MAX_THREADS)   {
+        fprintf(stderr, "usage: queue_bench [N]\n");
+        return 1;
+    }
+
+    for (i = 0; i < 3; i++) {
+        _throughput(&_impls[i], 1, 1, 1);
+        _throughput(&_impls[i], 1, 1, QUEUE_BATCH);
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (_impls[i].spsc) {
+            continue;
+        }
+
+        _throughput(&_impls[i], n, 1, 1);
+        _throughput(&_impls[i], n, 1, QUEUE_BATCH);
+        _throughput(&_impls[i], n, n, 1);
+        _throughput(&_impls[i], n, n, QUEUE_BATCH);
+    }
+
+    for (i = 0; i < 3; i++) {
+        _latency(&_impls[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * Time to build a large response out of formatted lines, copied text and big blocks the caller already
+ * has, then write it to /dev/null: with a stringbuilder (growing by realloc, then copied out whole by
+ * sb_make_cstring and written), with a stringbuilder bound to /dev/null as a sink (so it is written as
+ * it is built, in a buffer of SINK_SIZE), with a rope written by writev, and with a rope flattened first
+ *
+ *   rope_bench [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "stringbuilder.h"
+#include "rope.h"
+
+#define DEFAULT_MEGABYTES   8
+#define BLOCK_SIZE          16384
+#define REPEATS             5
+#define SINK_SIZE           65536
+
+static char _block[BLOCK_SIZE];
+static const char* _text = "<tr><td>copied text, as a template would produce</td></tr>\n";
+
+static double _elapsed_ms(clock_t start)    {
+    return (double)(clock() - start) * 1e3 / CLOCKS_PER_SEC / REPEATS;
+}
+
+/**
+ * Returns the number of lines it took to make the response, for _bench_sink to make the same
+ */
+static int _bench_sb(int fd, size_t bytes)  {
+    stringbuilder* sb;
+    clock_t start;
+    size_t size = 0;
+    char* out;
+    int r, i = 0, reallocs = 0;
+
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        sb = sb_new();
+        for (i = 0; sb->pos < bytes; i++)   {
+            sb_append_strf(sb, "<tr><td>%d</td><td>%.2f</td></tr>\n", i, i * 0.25);
+            sb_append_str(sb, _text);
+            if (i % 64 == 0)    {
+                sb_append_strn(sb, _block, BLOCK_SIZE);
+            }
+        }
+
+        out = sb_make_cstring(sb);
+        if (write(fd, out, sb->pos) != (ssize_t)sb->pos) {
+            fprintf(stderr, "write failed\n");
+        }
+        reallocs = sb->stats.reallocs;
+        size = sb->size;
+        free(out);
+        sb_destroy(sb, 1);
+    }
+
+    printf("%-24s %8.2f ms  (%d reallocs, %zu byte buffer)\n", "stringbuilder", _elapsed_ms(start), reallocs,
+        size);
+    return i;
+}
+
+static void _bench_sink(int fd, int lines)  {
+    stringbuilder* sb;
+    clock_t start;
+    size_t size = 0;
+    int r, i;
+
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        sb = sb_new_with_flags(0, SB_LAZY_NUL);
+        sb_bind_fd(sb, fd, SINK_SIZE);
+        for (i = 0; i < lines; i++) {
+            sb_append_strf(sb, "<tr><td>%d</td><td>%.2f</td></tr>\n", i, i * 0.25);
+            sb_append_str(sb, _text);
+            if (i % 64 == 0)    {
+                sb_append_strn(sb, _block, BLOCK_SIZE);
+            }
+        }
+
+        if (sb_flush(sb) != 0)  {
+            fprintf(stderr, "sb_flush failed\n");
+        }
+        size = sb->size;
+        sb_destroy(sb, 1);
+    }
+
+    printf("%-24s %8.2f ms  (%zu byte buffer)\n", "stringbuilder, sink", _elapsed_ms(start), size);
+}
+
+static void _bench_rope(int fd, size_t bytes, int flatten)  {
+    clock_t start;
+    char* out;
+    rope rp;
+    int r, i, segments = 0;
+
+    start = clock();
+    for (r = 0; r < REPEATS; r++)   {
+        rope_init(&rp, 0);
+        for (i = 0; rope_length(&rp) < bytes; i++)  {
+            rope_append_strf(&rp, "<tr><td>%d</td><td>%.2f</td></tr>\n", i, i * 0.25);
+            rope_append_str(&rp, _text);
+            if (i % 64 == 0)    {
+                rope_append_ref(&rp, _block, BLOCK_SIZE);
+            }
+        }
+
+        if (flatten)    {
+            out = rope_flatten(&rp);
+            if (write(fd, out, rope_length(&rp)) != (ssize_t)rope_length(&rp))  {
+                fprintf(stderr, "write failed\n");
+            }
+            free(out);
+        } else if (rope_write(&rp, fd) != 0)  {
+            fprintf(stderr, "rope_write failed\n");
+        }
+
+        segments = rope_segments(&rp);
+        rope_destroy(&rp);
+    }
+
+    printf("%-24s %8.2f ms  (%d segments)\n", flatten? "rope, flattened" : "rope, writev", _elapsed_ms(start),
+        segments);
+}
+
+int main(int argc, char** argv) {
+    int megabytes = argc > 1? atoi(argv[1]) : DEFAULT_MEGABYTES;
+    int fd;
+
+    if (megabytes < 1 || (fd = open("/dev/null", O_WRONLY)) < 0)    {
+        fprintf(stderr, "usage: rope_bench [megabytes]\n");
+        return 1;
+    }
+
+    memset(_block, 'b', BLOCK_SIZE);
+    _bench_sink(fd, _bench_sb(fd, (size_t)megabytes << 20));
+    _bench_rope(fd, (size_t)megabytes << 20, 0);
+    _bench_rope(fd, (size_t)megabytes << 20, 1);
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * Sorting speed on random integer keys: qsort against sort_merge and list_sort on one thread, then
+ * sort_parallel from 1 thread up to the number of online CPUs
+ *
+ *   sort_bench [values] [max threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "list.h"
+#include "sort.h"
+#include "threadpool.h"
+
+#define DEFAULT_VALUES  1000000
+
+static int _compare(const void* key1, const void* key2) {
+    uint32_t a = *(const uint32_t*)key1, b = *(const uint32_t*)key2;
+    return (a > b) - (a < b);
+}
+
+/* qsort is handed the array of pointers, so it needs one more dereference */
+static int _qsort_compare(const void* p1, const void* p2)   {
+    return _compare(*(void* const*)p1, *(void* const*)p2);
+}
+
+/**
+ * Wall clock time, since the parallel sorts keep several CPUs busy
+ */
+static double _now()    {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _report(const char* name, int threads, double start, void** sorted, int n)  {
+    double elapsed = _now() - start;
+    int i;
+
+    for (i = 1; i < n; i++) {
+        if (_compare(sorted[i - 1], sorted[i]) > 0) {
+            printf("%s is not sorted!\n", name);
+            return;
+        }
+    }
+
+    printf("%-16s %3d thread%s %8.1f ms\n", name, threads, threads == 1? " " : "s", elapsed * 1000);
+}
+
+int main(int argc, char** argv) {
+    list_element* e;
+    uint32_t* keys;
+    uint32_t x = 2463534242u;
+    void** ptrs;
+    threadpool tp;
+    double start;
+    list l;
+    int n, max_threads, threads, i;
+
+    n = argc > 1? atoi(argv[1]) : DEFAULT_VALUES;
+    max_threads = argc > 2? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1 || max_threads < 1)   {
+        fprintf(stderr, "usage: sort_bench [values] [max threads]\n");
+        return 1;
+    }
+
+    keys = (uint32_t*)malloc(n * sizeof(uint32_t));
+    ptrs = (void**)malloc(n * sizeof(void*));
+    for (i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        keys[i] = x;
+    }
+
+    printf("%d values\n", n);
+
+    for (i = 0; i < n; i++) {
+        ptrs[i] = &keys[i];
+    }
+    start = _now();
+    qsort(ptrs, n, sizeof(void*), _qsort_compare);
+    _report("qsort", 1, start, ptrs, n);
+
+    for (i = 0; i < n; i++) {
+        ptrs[i] = &keys[i];
+    }
+    start = _now();
+    sort_merge(ptrs, n, _compare);
+    _report("sort_merge", 1, start, ptrs, n);
+
+    list_init(&l, 0);
+    for (i = 0; i < n; i++) {
+        list_insert_next(&l, list_tail(&l), &keys[i]);
+    }
+    start = _now();
+    list_sort(&l, _compare);
+    for (i = 0, e = list_head(&l); e; e = list_next(e)) {
+        ptrs[i++] = list_data(e);
+    }
+    _report("list_sort", 1, start, ptrs, n);
+    list_destroy(&l);
+
+    // The calling thread sorts too, so a pool of threads - 1 uses "threads" threads
+    for (threads = 1; threads <= max_threads; threads *= 2) {
+        threadpool_init(&tp, threads - 1);
+        for (i = 0; i < n; i++) {
+            ptrs[i] = &keys[i];
+        }
+
+        start = _now();
+        sort_parallel(ptrs, n, _compare, &tp);
+        _report("sort_parallel", threads, start, ptrs, n);
+        threadpool_destroy(&tp);
+
+        if (threads < max_threads && threads * 2 > max_threads) {
+            threads = max_threads / 2;
+        }
+    }
+
+    free(keys);
+    free(ptrs);
+    return 0;
+}
@@ -0,0 +1,239 @@
+/**
+ * Time and heap allocations to build log lines with sb_append_strf, against the way it used to work:
+ * format into a temporary string from xp_vasprintf, append that with sb_append_str and free it, and
+ * against the same format compiled once into an sb_template.  The builder is reset every
+ * LINES_PER_BUFFER lines, so after warming up it shouldn't need to grow.  Then
+ * the time to reset a builder that has grown to RESET_SIZE and append one short line, zero-filled and
+ * lazily terminated.  Then the time to create a builder, format one short string and destroy it, with
+ * sb_new (two mallocs) and with sb_init on the stack.  Then the numeric appenders against sb_append_strf
+ * with "%lld", "%llx" and "%.17g".  Last, what it costs to grow a builder to GROWTH_SIZE with each growth
+ * policy, against reserving it all up front
+ *
+ *   stringbuilder_bench [lines]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "platform.h"
+#include "stringbuilder.h"
+#include "sbtemplate.h"
+
+#define DEFAULT_LINES       (1 << 20)
+#define LINES_PER_BUFFER    256
+#define RESET_SIZE          (1 << 20)
+#define RESETS              4096
+#define SHORT_LIVED         (1 << 20)
+#define NUMBERS             (1 << 20)
+#define GROWTH_SIZE         ((size_t)256 << 20)
+#define LOG_FORMAT          "2024-05-%02d 12:%02d:%02d.%03d [%s] conn %d: %s (%d bytes in %.3f ms)\n"
+
+static const char* _levels[] = { "debug", "info", "warn", "error" };
+static long _temporaries;
+static sb_template _log_template;
+
+/* The ways _bench appends each line */
+#define APPEND_STRF         0
+#define APPEND_TEMPORARY    1
+#define APPEND_TEMPLATE     2
+
+/* sb_append_strf as it was, counting its temporary strings */
+static void _append_strf_temporary(stringbuilder* sb, const char* fmt, ...)    {
+    char* str;
+    va_list arglist;
+
+    va_start(arglist, fmt);
+    xp_vasprintf(&str, fmt, arglist);
+    va_end(arglist);
+
+    if (!str)   {
+        return;
+    }
+
+    _temporaries++;
+    sb_append_str(sb, str);
+    free(str);
+}
+
+static void _bench(const char* name, int append, int lines)  {
+    stringbuilder* sb = sb_new();
+    clock_t start;
+    int i;
+
+    _temporaries = 0;
+    start = clock();
+    for (i = 0; i < lines; i++) {
+        if (i % LINES_PER_BUFFER == 0)  {
+            sb_reset(sb);
+        }
+
+        if (append == APPEND_TEMPORARY) {
+            _append_strf_temporary(sb, LOG_FORMAT, i % 28 + 1, i % 60, i % 59, i % 1000, _levels[i & 3], i,
+                "request served", i * 7 % 65536, i % 977 / 7.0);
+        } else if (append == APPEND_TEMPLATE)   {
+            sb_append_template(sb, &_log_template, i % 28 + 1, i % 60, i % 59, i % 1000, _levels[i & 3], i,
+                "request served", i * 7 % 65536, i % 977 / 7.0);
+        } else {
+            sb_append_strf(sb, LOG_FORMAT, i % 28 + 1, i % 60, i % 59, i % 1000, _levels[i & 3], i,
+                "request served", i * 7 % 65536, i % 977 / 7.0);
+        }
+    }
+
+    printf("%-22s %7.1f ns/append  %.4f allocations/append (%ld temporary strings, %d reallocs)\n", name,
+        (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / lines, (double)(_temporaries + sb->stats.reallocs) / lines,
+        _temporaries, sb->stats.reallocs);
+    sb_destroy(sb, 1);
+}
+
+static void _bench_reset(const char* name, int flags)  {
+    stringbuilder* sb = sb_new_with_flags(RESET_SIZE, flags);
+    clock_t start;
+    size_t length = 0;
+    int i;
+
+    start = clock();
+    for (i = 0; i < RESETS; i++)    {
+        sb_reset(sb);
+        sb_append_str(sb, "GET /index.html 200 1043 bytes 0.8 ms\n");
+        length += strlen(sb_cstring(sb));
+    }
+
+    printf("%-22s %9.1f ns/reset + append  (%zu chars)\n", name,
+        (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / RESETS, length);
+    sb_destroy(sb, 1);
+}
+
+static void _bench_short_lived(const char* name, int on_stack)  {
+    stringbuilder stack_sb;
+    stringbuilder* sb;
+    clock_t start;
+    size_t length = 0;
+    int i;
+
+    start = clock();
+    for (i = 0; i < SHORT_LIVED; i++)   {
+        if (on_stack)   {
+            sb = &stack_sb;
+            sb_init(sb, 0, 0, SB_LAZY_NUL);
+        } else {
+            sb = sb_new();
+        }
+
+        sb_append_strf(sb, "session:%08x:user:%d", i * 2654435761u, i % 1000);
+        length += strlen(sb_cstring(sb));
+        sb_destroy(sb, 1);
+    }
+
+    printf("%-22s %7.1f ns/builder  (%zu chars)\n", name,
+        (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / SHORT_LIVED, length);
+}
+
+static void _bench_numbers(const char* name, int kind, int printf_path) {
+    stringbuilder* sb = sb_new_with_flags(4096, SB_LAZY_NUL);
+    uint64_t x = 88172645463325252ULL;
+    size_t length = 0;
+    clock_t start;
+    double value;
+    int i;
+
+    start = clock();
+    for (i = 0; i < NUMBERS; i++)   {
+        if (i % 64 == 0)    {
+            length += sb->pos;
+            sb_reset(sb);
+        }
+
+        // xorshift64, shifted down so the integers have a spread of lengths
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        value = (double)(int64_t)(x >> (x & 63)) / 1024.0;
+
+        switch (kind)   {
+            case 0:
+                if (printf_path)    {
+                    sb_append_strf(sb, "%lld", (long long)(int64_t)(x >> (x & 63)));
+                } else {
+                    sb_append_i64(sb, (int64_t)(x >> (x & 63)));
+                }
+                break;
+            case 1:
+                if (printf_path)    {
+                    sb_append_strf(sb, "%llx", (unsigned long long)x);
+                } else {
+                    sb_append_hex(sb, x, 0);
+                }
+                break;
+            case 2:
+                if (printf_path)    {
+                    sb_append_strf(sb, "%.17g", value);
+                } else {
+                    sb_append_double(sb, value);
+                }
+                break;
+        }
+        sb_append_ch(sb, ' ');
+    }
+
+    printf("%-22s %7.1f ns/number  (%zu chars)\n", name,
+        (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / NUMBERS, length + sb->pos);
+    sb_destroy(sb, 1);
+}
+
+static void _bench_growth(const char* name, sb_growth_fn growth, int reserve)  {
+    stringbuilder* sb = sb_new_with_flags(0, SB_LAZY_NUL);
+    char piece[100];
+    clock_t start;
+    size_t size;
+
+    memset(piece, 'p', sizeof(piece));
+    sb_set_growth(sb, growth);
+
+    start = clock();
+    if (reserve)    {
+        sb_reserve(sb, GROWTH_SIZE);
+    }
+
+    while (sb->pos + sizeof(piece) <= GROWTH_SIZE)  {
+        sb_append_strn(sb, piece, sizeof(piece));
+    }
+
+    size = sb->size;
+    sb_shrink_to_fit(sb);
+    printf("%-22s %7.1f ms  %3d reallocs  %3d moves  %7.1f MB copied  %5.1f%% unused before shrinking\n",
+        name, (double)(clock() - start) * 1e3 / CLOCKS_PER_SEC, sb->stats.reallocs, sb->stats.moves,
+        sb->stats.bytes_copied / 1048576.0, 100.0 * (size - sb->pos) / size);
+    sb_destroy(sb, 1);
+}
+
+int main(int argc, char** argv) {
+    int lines = argc > 1? atoi(argv[1]) : DEFAULT_LINES;
+
+    if (lines < 1 || sb_template_compile(&_log_template, LOG_FORMAT) != 0)   {
+        fprintf(stderr, "usage: stringbuilder_bench [lines]\n");
+        return 1;
+    }
+
+    _bench("vasprintf + append", APPEND_TEMPORARY, lines);
+    _bench("sb_append_strf", APPEND_STRF, lines);
+    _bench("sb_append_template", APPEND_TEMPLATE, lines);
+    _bench_reset("zero-filled", 0);
+    _bench_reset("SB_LAZY_NUL", SB_LAZY_NUL);
+    _bench_short_lived("sb_new", 0);
+    _bench_short_lived("sb_init", 1);
+    _bench_numbers("strf %lld", 0, 1);
+    _bench_numbers("sb_append_i64", 0, 0);
+    _bench_numbers("strf %llx", 1, 1);
+    _bench_numbers("sb_append_hex", 1, 0);
+    _bench_numbers("strf %.17g", 2, 1);
+    _bench_numbers("sb_append_double", 2, 0);
+    _bench_growth("sb_grow_double", sb_grow_double, 0);
+    _bench_growth("sb_grow_by_half", sb_grow_by_half, 0);
+    _bench_growth("sb_grow_pages", sb_grow_pages, 0);
+    _bench_growth("sb_reserve", 0, 1);
+    sb_template_destroy(&_log_template);
+    return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * Idle timeouts for "connections" connections: each tick, ACTIVE_PER_TICK of them see traffic and push
+ * their timeout back, and the ones whose timeouts are due expire and are given a new one.  The
+ * timeouts are kept in a hashtable scanned every tick (the way they were kept before), a heap and a
+ * timer wheel.  The scan is O(connections) per tick, so it only runs for SCAN_TICKS
+ *
+ *   timerwheel_bench [connections]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "hashtable.h"
+#include "heap.h"
+#include "timerwheel.h"
+
+#define DEFAULT_CONNECTIONS (1 << 20)
+#define TIMEOUT             30000   /* Ticks, so 30 s of 1 ms ticks */
+#define TICKS               5000
+#define SCAN_TICKS          50
+#define ACTIVE_PER_TICK     1000
+
+typedef struct  {
+    int         id;
+    uint64_t    deadline;
+    int         handle;         /* In the heap */
+    tw_timer    timer;
+} connection;
+
+static connection* _conns;
+static int _count;
+static uint64_t _now;
+static long _expired;
+static uint32_t _x = 2463534242u;
+
+static uint32_t _random()   {
+    _x ^= _x << 13;
+    _x ^= _x >> 17;
+    _x ^= _x << 5;
+    return _x;
+}
+
+static uint64_t _timeout()  {
+    return _now + 1 + _random() % TIMEOUT;
+}
+
+static double _elapsed_ns(clock_t start, long operations)   {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / operations;
+}
+
+static void _report(const char* name, clock_t start, int ticks) {
+    printf("%-16s %8d connections  %10.0f ns/tick  (%ld expired)\n", name, _count,
+        _elapsed_ns(start, ticks), _expired);
+}
+
+static void _reset()    {
+    int i;
+
+    _now = 0;
+    _expired = 0;
+    _x = 2463534242u;
+    for (i = 0; i < _count; i++)    {
+        _conns[i].id = i;
+        _conns[i].deadline = _timeout();
+    }
+}
+
+static int _hash(const void* key)   {
+    return ((const connection*)key)->id;
+}
+
+static int _match(const void* key1, const void* key2)   {
+    return ((const connection*)key1)->id == ((const connection*)key2)->id;
+}
+
+static void _bench_scan()   {
+    hashtable_cursor cur;
+    connection* c;
+    hashtable ht;
+    clock_t start;
+    int i;
+
+    _reset();
+    ht_init(&ht, _count, _hash, _match, 0);
+    for (i = 0; i < _count; i++)    {
+        ht_insert(&ht, &_conns[i]);
+    }
+
+    start = clock();
+    for (_now = 1; _now <= SCAN_TICKS; _now++)  {
+        for (i = 0; i < ACTIVE_PER_TICK; i++)   {
+            _conns[_random() % _count].deadline = _now + TIMEOUT;
+        }
+
+        HT_FOREACH(&ht, cur, c) {
+            if (c->deadline <= _now)    {
+                c->deadline = _timeout();
+                _expired++;
+            }
+        }
+    }
+
+    _report("hashtable scan", start, SCAN_TICKS);
+    ht_destroy(&ht);
+}
+
+static int _compare(const void* key1, const void* key2) {
+    uint64_t a = ((const connection*)key1)->deadline, b = ((const connection*)key2)->deadline;
+
+    return a < b? -1 : a > b;
+}
+
+static void _bench_heap()   {
+    connection* c;
+    clock_t start;
+    heap h;
+    int i;
+
+    _reset();
+    heap_init(&h, _count, _compare, 0);
+    for (i = 0; i < _count; i++)    {
+        _conns[i].handle = heap_push(&h, &_conns[i]);
+    }
+
+    start = clock();
+    for (_now = 1; _now <= TICKS; _now++)   {
+        for (i = 0; i < ACTIVE_PER_TICK; i++)   {
+            c = &_conns[_random() % _count];
+            c->deadline = _now + TIMEOUT;
+            heap_update(&h, c->handle, c);
+        }
+
+        while ((c = (connection*)heap_peek(&h)) && c->deadline <= _now)  {
+            c->deadline = _timeout();
+            heap_update(&h, c->handle, c);
+            _expired++;
+        }
+    }
+
+    _report("4-ary heap", start, TICKS);
+    heap_destroy(&h);
+}
+
+static void _expire(ilist* expired, void* arg)  {
+    ilist_node *n, *tmp;
+    connection* c;
+
+    ILIST_FOREACH_SAFE(expired, n, tmp) {
+        c = ilist_entry(n, connection, timer.link);
+        c->deadline = _timeout();
+        tw_add((timerwheel*)arg, &c->timer, c->deadline);
+        _expired++;
+    }
+}
+
+static void _bench_wheel()  {
+    timerwheel w;
+    connection* c;
+    clock_t start;
+    int i;
+
+    _reset();
+    tw_init(&w, 1, 0);
+    for (i = 0; i < _count; i++)    {
+        tw_timer_init(&_conns[i].timer);
+        tw_add(&w, &_conns[i].timer, _conns[i].deadline);
+    }
+
+    start = clock();
+    for (_now = 1; _now <= TICKS; _now++)   {
+        for (i = 0; i < ACTIVE_PER_TICK; i++)   {
+            c = &_conns[_random() % _count];
+            c->deadline = _now + TIMEOUT;
+            tw_cancel(&w, &c->timer);
+            tw_add(&w, &c->timer, c->deadline);
+        }
+
+        tw_advance(&w, _now, _expire, &w);
+    }
+
+    _report("timer wheel", start, TICKS);
+    tw_destroy(&w);
+}
+
+int main(int argc, char** argv) {
+    _count = argc > 1? atoi(argv[1]) : DEFAULT_CONNECTIONS;
+    if (_count < 1 || (_conns = (connection*)malloc(_count * sizeof(connection))) == 0)   {
+        fprintf(stderr, "usage: timerwheel_bench [connections]\n");
+        return 1;
+    }
+
+    _bench_scan();
+    _bench_heap();
+    _bench_wheel();
+
+    free(_conns);
+    return 0;
+}
@@ -0,0 +1,289 @@
+/**
+ * Bounded LRU/CLOCK cache
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashtable.h"
+#include "cache.h"
+
+/* The index starts with room for this many values when the capacity is a cost rather than a count */
+#define CACHE_INITIAL_ENTRIES   1024
+
+struct cache_entry_tag  {
+    void*           data;
+    cache*          owner;          /* So the index's hash and match functions can find the user's */
+    size_t          cost;
+    int             referenced;     /* CACHE_CLOCK: set by a hit, cleared as the hand passes */
+
+    ilist_node      link;           /* In the ring, or in the spares */
+};
+
+/**
+ * Index hash function.  The index holds entries, and is searched with a probe entry on the stack
+ */
+static int _hash(const void* key)   {
+    const cache_entry* e = (const cache_entry*)key;
+
+    if (e->owner->h)    {
+        return e->owner->h(e->data);
+    }
+
+    return (int)ht_hash_str((const char*)e->data, e->owner->index.seed);
+}
+
+static int _match(const void* key1, const void* key2)   {
+    const cache_entry* e1 = (const cache_entry*)key1;
+    const cache_entry* e2 = (const cache_entry*)key2;
+
+    if (e1->owner->match)   {
+        return e1->owner->match(e1->data, e2->data);
+    }
+
+    return !strcmp((const char*)e1->data, (const char*)e2->data);
+}
+
+static void _unlink(cache* c, cache_entry* e)   {
+    if (c->hand == &e->link)    {
+        c->hand = e->link.next;
+    }
+
+    ilist_remove(&c->ring, &e->link);
+}
+
+/**
+ * Marks the entry as just used
+ */
+static void _touch(cache* c, cache_entry* e)    {
+    if (c->policy == CACHE_CLOCK)   {
+        e->referenced = 1;
+    } else {
+        ilist_move_front(&c->ring, &e->link);
+    }
+}
+
+/**
+ * Finds the entry holding the value that matches "data"
+ *
+ * Returns the entry, or NULL if there is none
+ */
+static cache_entry* _find(cache* c, const void* data)   {
+    cache_entry probe;
+    void* found;
+
+    probe.data = (void*)data;
+    probe.owner = c;
+    found = &probe;
+    return ht_lookup(&c->index, &found) == 0? (cache_entry*)found : 0;
+}
+
+/**
+ * Takes the entry out of the index and the ring and keeps it for reuse.  Its value is left alone
+ */
+static void _drop(cache* c, cache_entry* e) {
+    void* data;
+
+    data = e;
+    ht_remove(&c->index, &data);
+    _unlink(c, e);
+    c->used -= e->cost;
+
+    ilist_push_front(&c->spare, &e->link);
+}
+
+/**
+ * Evicts one value, chosen by the cache's policy.  The cache must not be empty
+ */
+static void _evict(cache* c)    {
+    cache_entry* victim;
+    void* data;
+
+    if (c->policy == CACHE_CLOCK)   {
+        // Give every referenced value a second chance, the first unreferenced one goes
+        for (;;)    {
+            if (c->hand == &c->ring.head)   {
+                c->hand = c->ring.head.next;
+            }
+
+            victim = ilist_entry(c->hand, cache_entry, link);
+            c->hand = c->hand->next;
+            if (!victim->referenced)    {
+                break;
+            }
+            victim->referenced = 0;
+        }
+    } else {
+        victim = ilist_entry(ilist_last(&c->ring), cache_entry, link);
+    }
+
+    data = victim->data;
+    _drop(c, victim);
+    c->evictions++;
+
+    if (c->destroy) {
+        c->destroy(data);
+    }
+}
+
+/**
+ * Initializes the given cache
+ *
+ * Returns 0 if the cache was initialized successfully, -1 otherwise
+ */
+int cache_init(cache* c, size_t capacity, int policy, int (*h)(const void* key),
+    int (*match)(const void* key1, const void* key2),
+    void (*destroy)(void *data))  {
+    int buckets;
+
+    memset(c, 0, sizeof(cache));
+    if (policy != CACHE_LRU && policy != CACHE_CLOCK)   {
+        return -1;
+    }
+
+    buckets = capacity < CACHE_INITIAL_ENTRIES? (int)capacity + 1 : CACHE_INITIAL_ENTRIES;
+    if (ht_init_engine(&c->index, HT_ENGINE_OPEN, buckets, _hash, _match, 0) != 0)  {
+        return -1;
+    }
+
+    ilist_init(&c->ring);
+    ilist_init(&c->spare);
+    c->hand = &c->ring.head;
+
+    c->policy   = policy;
+    c->h        = h;
+    c->match    = match;
+    c->destroy  = destroy;
+    c->capacity = capacity;
+
+    return 0;
+}
+
+/**
+ * Destroys the given cache, calling the user-supplied "destroy" function on each value in it
+ */
+void cache_destroy(cache* c)    {
+    ilist_node *n, *next;
+    cache_entry* e;
+
+    ILIST_FOREACH_SAFE(&c->ring, n, next)   {
+        e = ilist_entry(n, cache_entry, link);
+        if (c->destroy) {
+            c->destroy(e->data);
+        }
+        free(e);
+    }
+
+    ILIST_FOREACH_SAFE(&c->spare, n, next)  {
+        free(ilist_entry(n, cache_entry, link));
+    }
+
+    ht_destroy(&c->index);
+    memset(c, 0, sizeof(cache));
+}
+
+/**
+ * Looks up the value matching *data, marking it as recently used
+ *
+ * Returns 0 on a hit, -1 on a miss
+ */
+int cache_get(cache* c, void** data)    {
+    cache_entry* e;
+
+    if ((e = _find(c, *data)) == 0) {
+        c->misses++;
+        return -1;
+    }
+
+    c->hits++;
+    _touch(c, e);
+    *data = e->data;
+    return 0;
+}
+
+/**
+ * Adds a value to the cache with a cost of 1
+ */
+int cache_put(cache* c, const void* data)   {
+    return cache_put_cost(c, data, 1);
+}
+
+/**
+ * Adds a value to the cache with the given cost, evicting as needed
+ *
+ * Returns 0 if the value was added, 1 if it replaced a value, -1 if there was a problem
+ */
+int cache_put_cost(cache* c, const void* data, size_t cost) {
+    cache_entry* e;
+    void* old;
+
+    if (cost > c->capacity) {
+        return -1;
+    }
+
+    if ((e = _find(c, data)) != 0)  {
+        old = e->data;
+        e->data = (void*)data;
+
+        // Out of the ring while others are evicted to make room for a larger cost, so neither policy can
+        // choose it, then back in as the most recently used
+        _unlink(c, e);
+        c->used -= e->cost;
+        while (cache_size(c) > 0 && c->used + cost > c->capacity) {
+            _evict(c);
+        }
+
+        e->cost = cost;
+        e->referenced = 1;
+        ilist_insert_after(&c->ring, c->policy == CACHE_CLOCK? c->hand->prev : &c->ring.head, &e->link);
+        c->used += cost;
+
+        if (old != data && c->destroy)  {
+            c->destroy(old);
+        }
+        return 1;
+    }
+
+    while (cache_size(c) > 0 && c->used + cost > c->capacity) {
+        _evict(c);
+    }
+
+    if (ilist_size(&c->spare))  {
+        e = ilist_entry(ilist_first(&c->spare), cache_entry, link);
+        ilist_remove(&c->spare, &e->link);
+    } else if ((e = (cache_entry*)malloc(sizeof(cache_entry))) == 0)    {
+        return -1;
+    }
+
+    e->data = (void*)data;
+    e->owner = c;
+    e->cost = cost;
+    e->referenced = 0;
+    if (ht_insert(&c->index, e) != 0)   {
+        ilist_push_front(&c->spare, &e->link);
+        return -1;
+    }
+
+    // New values go in front for LRU, and just behind the hand (so they are looked at last) for CLOCK
+    ilist_insert_after(&c->ring, c->policy == CACHE_CLOCK? c->hand->prev : &c->ring.head, &e->link);
+    c->used += cost;
+
+    return 0;
+}
+
+/**
+ * Removes the value matching *data without destroying it
+ *
+ * Returns 0 if the value was removed, -1 if it wasn't in the cache
+ */
+int cache_remove(cache* c, void** data) {
+    cache_entry* e;
+
+    if ((e = _find(c, *data)) == 0) {
+        return -1;
+    }
+
+    *data = e->data;
+    _drop(c, e);
+    return 0;
+}
@@ -0,0 +1,718 @@
+/**
+ * Concurrent hashtable with per-segment locks for writers and epoch based reclamation for lock-free
+ * readers
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "platform.h"
+#include "hashtable.h"
+#include "chashtable.h"
+
+#define CHT_SEGMENT_BITS        6       /* log2(CHT_SEGMENTS) */
+#define CHT_MIN_BUCKETS         4       /* Per segment */
+#define CHT_MAX_BUCKETS         (1 << 24)
+#define CHT_CACHE_LINE          64
+
+/* Retirements between attempts to advance the global epoch.  Anything retired is freed two advances
+   later */
+#define CHT_RETIRE_BATCH        64
+
+/* Memory that a writer has unlinked but that a reader may still be looking at.  Embedded as the first
+   member of whatever is retired, and freed by "free" once no reader can see it */
+typedef struct cht_retired_tag  {
+    struct cht_retired_tag* next;
+    void                    (*free)(struct cht_retired_tag* r);
+} cht_retired;
+
+typedef struct cht_node_tag {
+    cht_retired                     retired;
+    void*                           data;
+    unsigned int                    hash;
+    _Atomic(struct cht_node_tag*)   next;
+} cht_node;
+
+/* A segment's bucket array.  Resizing builds a new one and retires the old one whole */
+typedef struct cht_table_tag    {
+    cht_retired         retired;
+    int                 mask;
+    _Atomic(cht_node*)  buckets[];
+} cht_table;
+
+struct chashtable_segment_tag   {
+    _Alignas(CHT_CACHE_LINE) pthread_mutex_t lock;      /* Held by writers */
+    _Atomic(cht_table*)     table;
+    _Atomic int             size;
+    int                     min_buckets;                /* What cht_init gave it, it never shrinks below */
+};
+
+/* What cht_retire wraps the caller's data in */
+typedef struct cht_retired_data_tag {
+    cht_retired retired;
+    void*       data;
+    void        (*fn)(void* data);
+} cht_retired_data;
+
+/* One per thread that has ever looked something up or retired something.  Records are reused once their
+   thread exits, along with anything still waiting in their limbo lists */
+typedef struct cht_record_tag   {
+    _Atomic unsigned long   state;      /* (epoch << 1) | 1 while inside a lookup, 0 otherwise */
+    int                     depth;      /* Lookups can nest, through the hash and match functions */
+    int                     in_use;
+
+    /* Written only by the owning thread (or, once it has exited, with _epoch_lock held) */
+    cht_retired*            limbo[3];   /* Retired during epochs 0, 1 and 2 mod 3 */
+    unsigned long           limbo_epoch[3];
+    int                     retired;    /* Since the last attempt to advance the epoch */
+
+    struct cht_record_tag*  next;       /* Never changes once the record is on the list */
+} cht_record;
+
+/* The epoch state is shared by every chashtable.  Records are only added, and in_use only changed, with
+   _epoch_lock held.  Everything else is lock-free */
+static pthread_mutex_t          _epoch_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic unsigned long    _epoch;
+static _Atomic(cht_record*)     _records;
+
+static pthread_once_t           _key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t            _record_key;
+static _Thread_local cht_record* _self;
+
+static void _free_list(cht_retired* r)  {
+    cht_retired* next;
+
+    for (; r; r = next) {
+        next = r->next;
+        r->free(r);
+    }
+}
+
+/**
+ * Detaches the record's limbo lists that no reader can see anymore (those retired two or more epochs
+ * ago) and links them into one list for the caller to free
+ *
+ * Returns the list of memory to free
+ */
+static cht_retired* _collect(cht_record* rec)   {
+    cht_retired *freed, *last;
+    unsigned long epoch;
+    int i;
+
+    freed = 0;
+    epoch = atomic_load(&_epoch);
+    for (i = 0; i < 3; i++) {
+        if (rec->limbo[i] && rec->limbo_epoch[i] + 2 <= epoch)  {
+            for (last = rec->limbo[i]; last->next; last = last->next)   {
+            }
+            last->next = freed;
+            freed = rec->limbo[i];
+            rec->limbo[i] = 0;
+        }
+    }
+
+    return freed;
+}
+
+/**
+ * Thread exit handler, lets the next thread to register reuse the record
+ */
+static void _release_record(void* data) {
+    cht_record* rec = (cht_record*)data;
+
+    pthread_mutex_lock(&_epoch_lock);
+    atomic_store(&rec->state, 0);
+    rec->depth = 0;
+    rec->in_use = 0;
+    pthread_mutex_unlock(&_epoch_lock);
+}
+
+static void _make_key() {
+    pthread_key_create(&_record_key, _release_record);
+}
+
+/**
+ * Finds or allocates the calling thread's record
+ *
+ * Returns the record, or NULL if there was no memory for one
+ */
+static cht_record* _register()  {
+    cht_record* rec;
+
+    pthread_once(&_key_once, _make_key);
+
+    pthread_mutex_lock(&_epoch_lock);
+    for (rec = atomic_load(&_records); rec && rec->in_use; rec = rec->next) {
+    }
+
+    if (!rec && (rec = (cht_record*)calloc(1, sizeof(cht_record))) != 0)   {
+        rec->next = atomic_load(&_records);
+        atomic_store(&_records, rec);
+    }
+
+    if (rec)    {
+        rec->in_use = 1;
+    }
+    pthread_mutex_unlock(&_epoch_lock);
+
+    if (rec)    {
+        pthread_setspecific(_record_key, rec);
+        _self = rec;
+    }
+
+    return rec;
+}
+
+/**
+ * Enters the current epoch.  Nothing retired from now on will be freed until _leave is called
+ *
+ * Returns the thread's record, or NULL if the thread couldn't be registered (the caller then has to
+ * lock instead)
+ */
+static cht_record* _enter() {
+    cht_record* rec;
+
+    rec = _self? _self : _register();
+    if (rec && rec->depth++ == 0)   {
+        atomic_store_explicit(&rec->state, (atomic_load(&_epoch) << 1) | 1, memory_order_relaxed);
+        // The announcement must be visible before any table pointer is read
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+
+    return rec;
+}
+
+static void _leave(cht_record* rec) {
+    if (rec && --rec->depth == 0)   {
+        atomic_store_explicit(&rec->state, 0, memory_order_release);
+    }
+}
+
+/**
+ * Moves the global epoch forward if every thread inside a lookup has seen the current one.  Once it
+ * has moved from e to e + 1, nothing retired during e - 1 can be seen by anyone
+ *
+ * Returns 0 if the epoch moved forward (whether or not it was this call that moved it), -1 otherwise
+ */
+static int _try_advance()   {
+    unsigned long epoch, state;
+    cht_record* rec;
+
+    epoch = atomic_load(&_epoch);
+    for (rec = atomic_load(&_records); rec; rec = rec->next)    {
+        state = atomic_load(&rec->state);
+        if ((state & 1) && (state >> 1) != epoch)   {
+            return -1;
+        }
+    }
+
+    atomic_compare_exchange_strong(&_epoch, &epoch, epoch + 1);
+    return 0;
+}
+
+/**
+ * Waits until the epoch has moved forward twice, after which nothing retired before the call can be
+ * seen by anyone
+ */
+static void _synchronize()  {
+    unsigned long target;
+
+    target = atomic_load(&_epoch) + 2;
+    while (atomic_load(&_epoch) < target)   {
+        if (_try_advance() != 0)    {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Queues the given memory to be freed once no reader can see it.  Each thread keeps its own limbo lists,
+ * so retiring takes no locks.  Must not be called with a segment lock held, since freeing may call back
+ * into user code
+ */
+static void _retire(cht_retired* r) {
+    cht_retired* freed;
+    cht_record* rec;
+    unsigned long epoch;
+    int i;
+
+    if ((rec = _self? _self : _register()) == 0)    {
+        _synchronize();
+        r->free(r);
+        return;
+    }
+
+    // A list from an older epoch in this slot is at least three epochs old, so it is safe to free
+    freed = 0;
+    epoch = atomic_load(&_epoch);
+    i = epoch % 3;
+    if (rec->limbo[i] && rec->limbo_epoch[i] != epoch)  {
+        freed = rec->limbo[i];
+        rec->limbo[i] = 0;
+    }
+
+    r->next = rec->limbo[i];
+    rec->limbo[i] = r;
+    rec->limbo_epoch[i] = epoch;
+
+    _free_list(freed);
+    if (++rec->retired >= CHT_RETIRE_BATCH) {
+        rec->retired = 0;
+        _try_advance();
+        _free_list(_collect(rec));
+    }
+}
+
+static void _free_node(cht_retired* r)  {
+    free(r);
+}
+
+static void _free_data(cht_retired* r)  {
+    cht_retired_data* rd = (cht_retired_data*)r;
+
+    rd->fn(rd->data);
+    free(rd);
+}
+
+/**
+ * Frees a bucket array along with the entries in its chains
+ */
+static void _free_table(cht_retired* r) {
+    cht_table* t = (cht_table*)r;
+    cht_node *node, *next;
+    int i;
+
+    for (i = 0; i <= t->mask; i++)  {
+        for (node = atomic_load_explicit(&t->buckets[i], memory_order_relaxed); node; node = next)  {
+            next = atomic_load_explicit(&node->next, memory_order_relaxed);
+            free(node);
+        }
+    }
+
+    free(t);
+}
+
+/**
+ * Allocates an empty bucket array with the given number of buckets (a power of 2)
+ */
+static cht_table* _table_new(int buckets)   {
+    cht_table* t;
+    int i;
+
+    if ((t = (cht_table*)malloc(sizeof(cht_table) + buckets * sizeof(_Atomic(cht_node*)))) == 0)    {
+        return 0;
+    }
+
+    t->retired.free = _free_table;
+    t->mask = buckets - 1;
+    for (i = 0; i < buckets; i++)   {
+        atomic_init(&t->buckets[i], 0);
+    }
+
+    return t;
+}
+
+static unsigned int _mix(unsigned int h)    {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+static unsigned int _hash(chashtable* cht, const void* key)    {
+    uint64_t hash;
+
+    if (cht->h) {
+        return _mix((unsigned int)cht->h(key));
+    }
+
+    hash = ht_hash_str((const char*)key, cht->seed);
+    return (unsigned int)(hash ^ (hash >> 32));
+}
+
+static int _matchstr(const void* key1, const void* key2)    {
+    return !strcmp((const char*)key1, (const char*)key2);
+}
+
+/**
+ * Returns the segment a hash belongs to.  Segments use the top bits of the hash, buckets the low ones
+ */
+static chashtable_segment* _segment(chashtable* cht, unsigned int hash) {
+    return &cht->segments[hash >> (32 - CHT_SEGMENT_BITS)];
+}
+
+/**
+ * Finds a matching entry in the given table.  Called by writers, with the segment lock held
+ *
+ * Returns the link pointing to the matching entry, or NULL if there is none
+ */
+static _Atomic(cht_node*)* _find(chashtable* cht, cht_table* t, const void* key, unsigned int hash)  {
+    _Atomic(cht_node*)* link;
+    cht_node* node;
+
+    link = &t->buckets[hash & t->mask];
+    while ((node = atomic_load_explicit(link, memory_order_relaxed)) != 0)   {
+        if (node->hash == hash && cht->match(node->data, key))  {
+            return link;
+        }
+        link = &node->next;
+    }
+
+    return 0;
+}
+
+/**
+ * Replaces the segment's bucket array with one of the given size, to grow or shrink it.  Readers may be
+ * walking the old chains at this very moment, so the entries are copied rather than relinked, and the
+ * old array is left intact for them.  Called with the segment lock held
+ *
+ * Returns the old array, which the caller retires once the lock is released, or NULL on failure
+ */
+static cht_table* _resize(chashtable_segment* seg, int buckets)  {
+    cht_table *old, *t;
+    cht_node *node, *copy;
+    int i;
+
+    old = atomic_load_explicit(&seg->table, memory_order_relaxed);
+    if ((t = _table_new(buckets)) == 0)  {
+        return 0;
+    }
+
+    for (i = 0; i <= old->mask; i++)    {
+        node = atomic_load_explicit(&old->buckets[i], memory_order_relaxed);
+        for (; node; node = atomic_load_explicit(&node->next, memory_order_relaxed))  {
+            if ((copy = (cht_node*)malloc(sizeof(cht_node))) == 0)  {
+                _free_table(&t->retired);
+                return 0;
+            }
+
+            copy->retired.free = _free_node;
+            copy->data = node->data;
+            copy->hash = node->hash;
+            atomic_init(&copy->next, atomic_load_explicit(&t->buckets[copy->hash & t->mask], memory_order_relaxed));
+            atomic_store_explicit(&t->buckets[copy->hash & t->mask], copy, memory_order_relaxed);
+        }
+    }
+
+    // Publishes the new array along with every entry in it
+    atomic_store_explicit(&seg->table, t, memory_order_release);
+    return old;
+}
+
+/**
+ * Initializes the given concurrent hashtable
+ *
+ * Returns 0 if the hashtable was initialized successfully, -1 otherwise
+ */
+int cht_init(chashtable* cht, int buckets, int (*h)(const void* key),
+    int (*match)(const void* key1, const void* key2),
+    void (*destroy)(void *data))   {
+    cht_table* t;
+    int i, per;
+
+    memset(cht, 0, sizeof(chashtable));
+
+    per = CHT_MIN_BUCKETS;
+    while (per < CHT_MAX_BUCKETS && per * CHT_SEGMENTS < buckets)   {
+        per *= 2;
+    }
+
+    cht->segments = (chashtable_segment*)aligned_alloc(CHT_CACHE_LINE, CHT_SEGMENTS * sizeof(chashtable_segment));
+    if (!cht->segments) {
+        return -1;
+    }
+
+    for (i = 0; i < CHT_SEGMENTS; i++)  {
+        if ((t = _table_new(per)) == 0) {
+            while (--i >= 0)    {
+                _free_table((cht_retired*)atomic_load(&cht->segments[i].table));
+                pthread_mutex_destroy(&cht->segments[i].lock);
+            }
+            free(cht->segments);
+            cht->segments = 0;
+            return -1;
+        }
+
+        pthread_mutex_init(&cht->segments[i].lock, 0);
+        atomic_init(&cht->segments[i].table, t);
+        atomic_init(&cht->segments[i].size, 0);
+        cht->segments[i].min_buckets = per;
+    }
+
+    cht->h       = h;
+    cht->match   = match? match : _matchstr;
+    cht->destroy = destroy;
+    cht->seed    = xp_random_seed();
+
+    return 0;
+}
+
+/**
+ * Destroys the given hashtable, calling the user-supplied "destroy" function on each value in the hash
+ */
+void cht_destroy(chashtable* cht)   {
+    cht_table* t;
+    cht_node* node;
+    int i, b;
+
+    for (i = 0; i < CHT_SEGMENTS; i++)  {
+        t = atomic_load(&cht->segments[i].table);
+        if (cht->destroy)   {
+            for (b = 0; b <= t->mask; b++)  {
+                node = atomic_load_explicit(&t->buckets[b], memory_order_relaxed);
+                for (; node; node = atomic_load_explicit(&node->next, memory_order_relaxed))  {
+                    cht->destroy(node->data);
+                }
+            }
+        }
+
+        _free_table(&t->retired);
+        pthread_mutex_destroy(&cht->segments[i].lock);
+    }
+
+    free(cht->segments);
+    memset(cht, 0, sizeof(chashtable));
+
+    // Old bucket arrays and removed entries may still be waiting in limbo
+    cht_quiesce();
+}
+
+/**
+ * Inserts a new value in the given hashtable
+ *
+ * Returns 0 if inserting the element was successful, 1 if the element was already in the table,
+ * -1 if there was a problem
+ */
+int cht_insert(chashtable* cht, const void* data)   {
+    void* temp;
+
+    temp = (void*)data;
+    return cht_insert_or_get(cht, &temp);
+}
+
+/**
+ * Inserts a new value in the given hashtable unless a matching value is already there.  If a match is
+ * found, *data is set to the value already in the table
+ *
+ * Returns 0 if the element was inserted, 1 if the element was already in the table, -1 if there was
+ * a problem
+ */
+int cht_insert_or_get(chashtable* cht, void** data) {
+    chashtable_segment* seg;
+    _Atomic(cht_node*)* link;
+    cht_table *t, *old;
+    cht_node* node;
+    unsigned int hash;
+    int size;
+
+    hash = _hash(cht, *data);
+    seg = _segment(cht, hash);
+    old = 0;
+
+    pthread_mutex_lock(&seg->lock);
+    t = atomic_load_explicit(&seg->table, memory_order_relaxed);
+    if ((link = _find(cht, t, *data, hash)) != 0)   {
+        *data = atomic_load_explicit(link, memory_order_relaxed)->data;
+        pthread_mutex_unlock(&seg->lock);
+        return 1;
+    }
+
+    size = atomic_load_explicit(&seg->size, memory_order_relaxed);
+    if (size > t->mask && t->mask + 1 < CHT_MAX_BUCKETS && (old = _resize(seg, (t->mask + 1) * 2)) != 0)  {
+        t = atomic_load_explicit(&seg->table, memory_order_relaxed);
+    }
+
+    if ((node = (cht_node*)malloc(sizeof(cht_node))) == 0)  {
+        pthread_mutex_unlock(&seg->lock);
+        if (old)    {
+            _retire(&old->retired);
+        }
+        return -1;
+    }
+
+    // Fill the entry in completely before the release store makes it visible to readers
+    node->retired.free = _free_node;
+    node->data = *data;
+    node->hash = hash;
+    link = &t->buckets[hash & t->mask];
+    atomic_init(&node->next, atomic_load_explicit(link, memory_order_relaxed));
+    atomic_store_explicit(link, node, memory_order_release);
+    atomic_store_explicit(&seg->size, size + 1, memory_order_relaxed);
+    pthread_mutex_unlock(&seg->lock);
+
+    if (old)    {
+        _retire(&old->retired);
+    }
+
+    return 0;
+}
+
+/**
+ * Removes an element from the given hashtable.  If successful, data contains a pointer to the data
+ * removed.  The entry itself is retired, not freed, since readers may be passing through it.  A segment
+ * left less than a quarter full is halved, down to the size cht_init gave it
+ *
+ * 0 if removing the element was successful, -1 otherwise
+ */
+int cht_remove(chashtable* cht, void** data)    {
+    chashtable_segment* seg;
+    _Atomic(cht_node*)* link;
+    cht_table *t, *old;
+    cht_node* node;
+    unsigned int hash;
+    int size;
+
+    hash = _hash(cht, *data);
+    seg = _segment(cht, hash);
+    old = 0;
+
+    pthread_mutex_lock(&seg->lock);
+    t = atomic_load_explicit(&seg->table, memory_order_relaxed);
+    link = _find(cht, t, *data, hash);
+    if (!link)  {
+        pthread_mutex_unlock(&seg->lock);
+        return -1;
+    }
+
+    // A reader standing on the entry can still follow its next pointer, which is left as it is
+    node = atomic_load_explicit(link, memory_order_relaxed);
+    atomic_store_explicit(link, atomic_load_explicit(&node->next, memory_order_relaxed), memory_order_release);
+    size = atomic_load_explicit(&seg->size, memory_order_relaxed) - 1;
+    atomic_store_explicit(&seg->size, size, memory_order_relaxed);
+
+    // The entry is already out of the chains, so the copy leaves it behind and it is only retired once
+    if (t->mask + 1 > seg->min_buckets && size < (t->mask + 1) / 4)  {
+        old = _resize(seg, (t->mask + 1) / 2);
+    }
+    pthread_mutex_unlock(&seg->lock);
+
+    *data = node->data;
+    _retire(&node->retired);
+    if (old)    {
+        _retire(&old->retired);
+    }
+    return 0;
+}
+
+/**
+ * Determines whether an element matches the given data in the hashtable, without taking any locks.
+ * If so, data points to the matched value in the hashtable
+ *
+ * Returns 0 if a match was found in the hashtable, -1 otherwise
+ */
+int cht_lookup(chashtable* cht, void** data)    {
+    chashtable_segment* seg;
+    cht_record* rec;
+    cht_table* t;
+    cht_node* node;
+    unsigned int hash;
+    int ret;
+
+    hash = _hash(cht, *data);
+    seg = _segment(cht, hash);
+
+    if ((rec = _enter()) == 0)  {
+        pthread_mutex_lock(&seg->lock);
+    }
+
+    ret = -1;
+    t = atomic_load_explicit(&seg->table, memory_order_acquire);
+    node = atomic_load_explicit(&t->buckets[hash & t->mask], memory_order_acquire);
+    for (; node; node = atomic_load_explicit(&node->next, memory_order_acquire))    {
+        if (node->hash == hash && cht->match(node->data, *data))    {
+            *data = node->data;
+            ret = 0;
+            break;
+        }
+    }
+
+    if (rec)    {
+        _leave(rec);
+    } else {
+        pthread_mutex_unlock(&seg->lock);
+    }
+
+    return ret;
+}
+
+/**
+ * Returns the number of values in the table
+ */
+int cht_size(chashtable* cht)   {
+    int i, size;
+
+    size = 0;
+    for (i = 0; i < CHT_SEGMENTS; i++)  {
+        size += atomic_load_explicit(&cht->segments[i].size, memory_order_relaxed);
+    }
+
+    return size;
+}
+
+/**
+ * Returns the number of buckets in the table
+ */
+int cht_buckets(chashtable* cht)    {
+    int i, buckets;
+
+    buckets = 0;
+    for (i = 0; i < CHT_SEGMENTS; i++)  {
+        buckets += atomic_load_explicit(&cht->segments[i].table, memory_order_acquire)->mask + 1;
+    }
+
+    return buckets;
+}
+
+/**
+ * Calls fn(data) once no lookup that began before this call can still be running
+ */
+void cht_retire(void* data, void (*fn)(void* data))    {
+    cht_retired_data* rd;
+
+    if ((rd = (cht_retired_data*)malloc(sizeof(cht_retired_data))) == 0)   {
+        // Nowhere to keep it, so wait for every reader to move on instead
+        cht_quiesce();
+        fn(data);
+        return;
+    }
+
+    rd->retired.free = _free_data;
+    rd->data = data;
+    rd->fn = fn;
+    _retire(&rd->retired);
+}
+
+/**
+ * Frees what this thread and any exited threads have retired so far.  Lists belonging to exited threads
+ * are collected with the lock held (so that no new thread can claim the record meanwhile) but freed
+ * after it is released
+ */
+void cht_quiesce()  {
+    cht_retired *freed, *orphans, *last;
+    cht_record* rec;
+
+    _synchronize();
+    if (_self)  {
+        _free_list(_collect(_self));
+    }
+
+    orphans = 0;
+    pthread_mutex_lock(&_epoch_lock);
+    for (rec = atomic_load(&_records); rec; rec = rec->next)    {
+        if (!rec->in_use && (freed = _collect(rec)) != 0)   {
+            for (last = freed; last->next; last = last->next)   {
+            }
+            last->next = orphans;
+            orphans = freed;
+        }
+    }
+    pthread_mutex_unlock(&_epoch_lock);
+
+    _free_list(orphans);
+}
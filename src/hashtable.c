@@ -5,24 +5,638 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "platform.h"
 #include "hashtable.h"
 
-typedef struct hashtable_iter_tag   {
-    hashtable* ht;
+/* Open addressing engine parameters.  A control byte is either HT_CTRL_EMPTY or the top 7 bits of the
+   hash of the value stored in that slot.  The first HT_GROUP_WIDTH - 1 control bytes are mirrored past
+   the end of the array so that a group can always be loaded from any slot without wrapping */
+#define HT_CTRL_EMPTY           0x80
+#define HT_GROUP_WIDTH          16
+#define HT_OPEN_MIN_SLOTS       16
+#define HT_OPEN_MAX_LOAD(slots) ((slots) - (slots) / 8)
+
+/* Load factors used until ht_set_load_factors is called */
+#define HT_DEFAULT_MAX_LOAD     1.0f
+#define HT_OPEN_LOAD_LIMIT      0.875f
+#define HT_DEFAULT_MIN_LOAD     0.1f
+
+/* Work done by each insert or remove while a resize is in progress.  The chained engine moves this many
+   non-empty buckets (skipping at most 10 times as many empty ones), the open engine visits this many
+   groups of slots and then finishes the probe run it is in */
+#define HT_REHASH_STEP          4
+
+/* The batch functions hash and prefetch this many keys before resolving any of them */
+#define HT_BATCH                16
 
-    int current_bucket;
-    list_element* current;
+#if defined(__GNUC__)
+#define HT_PREFETCH(addr)       __builtin_prefetch(addr)
+#else
+#define HT_PREFETCH(addr)       ((void)(addr))
+#endif
+
+struct hashtable_entry_tag  {
+    void*                       data;
+    unsigned int                hash;
+    struct hashtable_entry_tag* next;
+};
+
+/* Pools handed to ht_set_pool are checked against the real size, but HT_ENTRY_SIZE has to cover it */
+typedef char _ht_entry_size_check[sizeof(struct hashtable_entry_tag) <= HT_ENTRY_SIZE? 1 : -1];
+
+typedef struct hashtable_iter_tag   {
+    hashtable_cursor cursor;
 } hashtable_iter_impl;
 
 // Prototypes for some default functions if none other are given
 int hashpjw(const void* key);
 int matchstr(const void* key1, const void* key2);
 
+/**
+ * Scrambles a user-supplied hash so that both the low bits (slot index) and high bits (control byte)
+ * are usable.  This is the 32-bit finalizer from MurmurHash3
+ */
+static unsigned int _mix(unsigned int h)    {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+/**
+ * Returns the full hash of the given key.  This is the value stored alongside each entry, computed once
+ * per operation
+ */
+static unsigned int _hash(hashtable* ht, const void* key)   {
+    uint64_t hash;
+
+    if (ht->h)  {
+        return _mix((unsigned int)ht->h(key));
+    }
+
+    hash = ht_hash_str((const char*)key, ht->seed);
+    return (unsigned int)(hash ^ (hash >> 32));
+}
+
+/**
+ * Returns a different random seed for every call.  The system random source is only read once, later
+ * seeds are derived from it with a counter
+ */
+static uint64_t _next_seed()    {
+    static uint64_t base, counter;
+
+    if (!base)  {
+        base = xp_random_seed() | 1;
+    }
+
+    return ht_hash_bytes(&counter, sizeof(counter), base + counter++);
+}
+
+/**
+ * Returns the index of the lowest set bit in the given nonzero mask
+ */
+static int _lowest_bit(unsigned int mask)   {
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int i;
+
+    for (i = 0; !(mask & 1); i++)   {
+        mask >>= 1;
+    }
+
+    return i;
+#endif
+}
+
+/**
+ * Returns the index of the lowest set bit in the given nonzero 64-bit mask
+ */
+static int _lowest_bit64(uint64_t mask) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    int i;
+
+    for (i = 0; !(mask & 1); i++)   {
+        mask >>= 1;
+    }
+
+    return i;
+#endif
+}
+
+/**
+ * Returns the index of the first set bit at or after "from" in a bitmap of "count" bits, or -1
+ */
+static int _bitmap_next(const uint64_t* bits, int count, int from)  {
+    uint64_t word;
+    int i;
+
+    if (from >= count)  {
+        return -1;
+    }
+
+    i = from >> 6;
+    word = bits[i] & (~(uint64_t)0 << (from & 63));
+    while (!word)   {
+        if (++i >= (count + 63) >> 6)   {
+            return -1;
+        }
+        word = bits[i];
+    }
+
+    return (i << 6) + _lowest_bit64(word);
+}
+
+/**
+ * Returns a bitmask with bit i set if control byte i of the group starting at ctrl equals h2
+ */
+static unsigned int _group_match(const unsigned char* ctrl, unsigned char h2)   {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#else
+    unsigned int mask;
+    int i;
+
+    mask = 0;
+    for (i = 0; i < HT_GROUP_WIDTH; i++)    {
+        if (ctrl[i] == h2)  {
+            mask |= 1u << i;
+        }
+    }
+
+    return mask;
+#endif
+}
+
+/**
+ * Returns a bitmask with bit i set if slot i of the group starting at ctrl is empty
+ */
+static unsigned int _group_empty(const unsigned char* ctrl) {
+#if defined(__SSE2__)
+    /* Empty is the only control value with the high bit set */
+    return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    return _group_match(ctrl, HT_CTRL_EMPTY);
+#endif
+}
+
+/**
+ * Sets the control byte for the given slot of a table with "slots" slots, keeping the mirrored group
+ * in sync
+ */
+static void _set_ctrl(unsigned char* ctrl, int slots, int slot, unsigned char value) {
+    ctrl[slot] = value;
+    if (slot < HT_GROUP_WIDTH - 1)  {
+        ctrl[slots + slot] = value;
+    }
+}
+
+/**
+ * Allocates empty control, value and hash arrays with room for the given (power of 2) number of slots
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+static int _open_alloc(unsigned char** ctrl, void*** values, unsigned int** hashes, int slots)    {
+    *ctrl = (unsigned char*)malloc(slots + HT_GROUP_WIDTH - 1);
+    *values = (void**)malloc(slots * sizeof(void*));
+    *hashes = (unsigned int*)malloc(slots * sizeof(unsigned int));
+    if (!*ctrl || !*values || !*hashes)   {
+        free(*ctrl);
+        free(*values);
+        free(*hashes);
+        return -1;
+    }
+
+    memset(*ctrl, HT_CTRL_EMPTY, slots + HT_GROUP_WIDTH - 1);
+
+    return 0;
+}
+
+/**
+ * Finds the slot holding the value matching the given key in the given slot arrays.  Only values with
+ * the same full hash are passed to match
+ *
+ * Returns the slot index, or -1 if no value matches
+ */
+static int _open_find(hashtable* ht, const unsigned char* ctrl, void** values, const unsigned int* hashes,
+    int slots, const void* key, unsigned int hash)   {
+
+    unsigned int empty, match;
+    int mask, pos, slot;
+
+    mask = slots - 1;
+    pos = hash & mask;
+    for (;;)    {
+        empty = _group_empty(ctrl + pos);
+        match = _group_match(ctrl + pos, (unsigned char)(hash >> 25));
+        if (empty)  {
+            // Values are never stored past the first empty slot of their probe run
+            match &= (empty & (~empty + 1)) - 1;
+        }
+
+        while (match)   {
+            slot = (pos + _lowest_bit(match)) & mask;
+            if (hashes[slot] == hash && ht->match(key, values[slot]))    {
+                return slot;
+            }
+            match &= match - 1;
+        }
+
+        if (empty)  {
+            return -1;
+        }
+
+        pos = (pos + HT_GROUP_WIDTH) & mask;
+    }
+}
+
+/**
+ * Stores the given value in the first empty slot of its probe run.  The value must not already be in
+ * the table and there must be room for it
+ */
+static void _open_place(unsigned char* ctrl, void** values, unsigned int* hashes, int slots,
+    const void* data, unsigned int hash) {
+
+    unsigned int empty;
+    int mask, pos, slot;
+
+    mask = slots - 1;
+    pos = hash & mask;
+    while (!(empty = _group_empty(ctrl + pos)))  {
+        pos = (pos + HT_GROUP_WIDTH) & mask;
+    }
+
+    slot = (pos + _lowest_bit(empty)) & mask;
+    _set_ctrl(ctrl, slots, slot, (unsigned char)(hash >> 25));
+    values[slot] = (void*)data;
+    hashes[slot] = hash;
+}
+
+/**
+ * Empties the given slot, then walks the rest of its probe run shifting back every value that is
+ * allowed to move closer to its home slot.  This keeps probe runs free of holes without tombstones
+ */
+static void _open_erase(unsigned char* ctrl, void** values, unsigned int* hashes, int slots, int slot)    {
+    int mask, next, home;
+
+    mask = slots - 1;
+    next = slot;
+    for (;;)    {
+        next = (next + 1) & mask;
+        if (ctrl[next] == HT_CTRL_EMPTY)    {
+            break;
+        }
+
+        // The value at "next" may fill the hole unless its home lies cyclically in (slot, next]
+        home = hashes[next] & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask))   {
+            _set_ctrl(ctrl, slots, slot, ctrl[next]);
+            values[slot] = values[next];
+            hashes[slot] = hashes[next];
+            slot = next;
+        }
+    }
+
+    _set_ctrl(ctrl, slots, slot, HT_CTRL_EMPTY);
+}
+
+/**
+ * Returns the index of the first occupied slot at or after "from", or -1 if there is none.  Checks a
+ * whole group of control bytes at a time
+ */
+static int _open_next_full(const unsigned char* ctrl, int slots, int from) {
+    unsigned int full;
+
+    for (; from < slots; from += HT_GROUP_WIDTH)    {
+        full = ~_group_empty(ctrl + from) & ((1u << HT_GROUP_WIDTH) - 1);
+        if (full)   {
+            // Bits past the end of the slots belong to the mirrored group, which was already visited
+            from += _lowest_bit(full);
+            return from < slots? from : -1;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Allocates an empty chained table and its occupancy bitmap
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+static int _chain_alloc(hashtable_entry*** table, uint64_t** occupied, int buckets)  {
+    *table = (hashtable_entry**)calloc(buckets, sizeof(hashtable_entry*));
+    *occupied = (uint64_t*)calloc((buckets + 63) / 64, sizeof(uint64_t));
+    if (!*table || !*occupied)  {
+        free(*table);
+        free(*occupied);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Searches the chain starting at *link for the value matching the given key.  Only values with the
+ * same full hash are passed to match
+ *
+ * Returns the link pointing at the matching entry, or NULL if no value matches
+ */
+static hashtable_entry** _chain_find(hashtable* ht, hashtable_entry** link, const void* key, unsigned int hash)  {
+    for (; *link != 0; link = &(*link)->next)    {
+        if ((*link)->hash == hash && ht->match(key, (*link)->data))    {
+            return link;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Allocates a chained entry from the table's pool, or with malloc
+ */
+static hashtable_entry* _entry_alloc(hashtable* ht)    {
+    return (hashtable_entry*)(ht->pool? pool_alloc(ht->pool) : malloc(sizeof(hashtable_entry)));
+}
+
+static void _entry_free(hashtable* ht, hashtable_entry* entry)  {
+    if (ht->pool)   {
+        pool_free(ht->pool, entry);
+    } else {
+        free(entry);
+    }
+}
+
+/**
+ * Pushes the given entry onto the front of its bucket in the given chained table
+ */
+static void _chain_place(hashtable_entry** table, uint64_t* occupied, int buckets, hashtable_entry* entry) {
+    int bucket;
+
+    bucket = entry->hash % buckets;
+    entry->next = table[bucket];
+    table[bucket] = entry;
+    occupied[bucket >> 6] |= (uint64_t)1 << (bucket & 63);
+}
+
+/**
+ * Clears the occupancy bit of the given bucket if its chain is now empty
+ */
+static void _chain_vacate(hashtable_entry** table, uint64_t* occupied, int bucket) {
+    if (!table[bucket]) {
+        occupied[bucket >> 6] &= ~((uint64_t)1 << (bucket & 63));
+    }
+}
+
+/**
+ * Frees every entry of the given chained table, passing its value to destroy (if any)
+ */
+static void _chain_destroy(hashtable* ht, hashtable_entry** table, int buckets) {
+    hashtable_entry *entry, *next;
+    int i;
+
+    for (i = 0; i < buckets; i++)   {
+        for (entry = table[i]; entry != 0; entry = next)    {
+            next = entry->next;
+            if (ht->destroy)    {
+                ht->destroy(entry->data);
+            }
+            _entry_free(ht, entry);
+        }
+    }
+}
+
+/**
+ * Looks for the value matching the given key in both the current and (during a resize) old arrays
+ *
+ * Returns 0 and sets *found if a value matches, -1 otherwise
+ */
+static int _find(hashtable* ht, const void* key, unsigned int hash, void** found)  {
+    hashtable_entry** link;
+    int slot;
+
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        if (ht->rehash_index >= 0)  {
+            slot = _open_find(ht, ht->old_ctrl, ht->old_slots, ht->old_hashes, ht->old_buckets, key, hash);
+            if (slot >= 0)  {
+                *found = ht->old_slots[slot];
+                return 0;
+            }
+        }
+
+        slot = _open_find(ht, ht->ctrl, ht->slots, ht->hashes, ht->buckets, key, hash);
+        if (slot >= 0)  {
+            *found = ht->slots[slot];
+            return 0;
+        }
+
+        return -1;
+    }
+
+    if (ht->rehash_index >= 0)  {
+        link = _chain_find(ht, &ht->old_table[hash % ht->old_buckets], key, hash);
+        if (link)   {
+            *found = (*link)->data;
+            return 0;
+        }
+    }
+
+    link = _chain_find(ht, &ht->table[hash % ht->buckets], key, hash);
+    if (link)   {
+        *found = (*link)->data;
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Returns the smallest size in the table's growth sequence that holds "count" values within the
+ * maximum load factor
+ */
+static int _fit_buckets(hashtable* ht, int count)   {
+    int buckets;
+
+    buckets = ht->min_buckets;
+    while (buckets < (1 << 30) && count > ht->max_load * buckets)    {
+        buckets *= 2;
+    }
+
+    return buckets;
+}
+
+/**
+ * Frees the (now empty) old arrays once a resize has moved every value
+ */
+static void _rehash_end(hashtable* ht)  {
+    free(ht->old_table);
+    free(ht->old_occupied);
+    free(ht->old_ctrl);
+    free(ht->old_slots);
+    free(ht->old_hashes);
+
+    ht->old_table = 0;
+    ht->old_occupied = 0;
+    ht->old_ctrl = 0;
+    ht->old_slots = 0;
+    ht->old_hashes = 0;
+    ht->old_buckets = 0;
+    ht->old_size = 0;
+    ht->rehash_index = -1;
+}
+
+/**
+ * Starts resizing the table to the given number of buckets.  The current arrays become the old ones and
+ * are drained by _rehash_step
+ *
+ * Returns 0 if successful, -1 otherwise (in which case the table is left as it was)
+ */
+static int _rehash_begin(hashtable* ht, int buckets) {
+    hashtable_entry** table;
+    uint64_t* occupied;
+    unsigned char* ctrl;
+    void** slots;
+    unsigned int* hashes;
+
+    table = 0;
+    occupied = 0;
+    ctrl = 0;
+    slots = 0;
+    hashes = 0;
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        if (_open_alloc(&ctrl, &slots, &hashes, buckets) != 0)   {
+            return -1;
+        }
+    } else {
+        if (_chain_alloc(&table, &occupied, buckets) != 0)  {
+            return -1;
+        }
+    }
+
+    ht->old_table = ht->table;
+    ht->old_occupied = ht->occupied;
+    ht->old_ctrl = ht->ctrl;
+    ht->old_slots = ht->slots;
+    ht->old_hashes = ht->hashes;
+    ht->old_buckets = ht->buckets;
+    ht->old_size = ht->size;
+
+    ht->table = table;
+    ht->occupied = occupied;
+    ht->ctrl = ctrl;
+    ht->slots = slots;
+    ht->hashes = hashes;
+    ht->buckets = buckets;
+
+    ht->rehash_index = 0;
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        // Start right after an empty slot so that whole probe runs are moved at a time.  Moving part of
+        // a run would leave a hole that hides the values after it from lookups in the old table
+        while (ht->old_ctrl[ht->rehash_index] != HT_CTRL_EMPTY)    {
+            ht->rehash_index++;
+        }
+        ht->rehash_index = (ht->rehash_index + 1) & (ht->old_buckets - 1);
+    }
+
+    if (ht->old_size == 0)  {
+        _rehash_end(ht);
+    }
+
+    return 0;
+}
+
+/**
+ * Moves a bounded number of values from the old arrays into the current ones.  Values are placed with
+ * their stored hash, the hash function is never called
+ */
+static void _rehash_step(hashtable* ht, int steps)  {
+    hashtable_entry** bucket;
+    hashtable_entry* entry;
+    int visits, mask, slot;
+
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        mask = ht->old_buckets - 1;
+        visits = steps * HT_GROUP_WIDTH;
+        while (ht->old_size > 0)    {
+            slot = ht->rehash_index;
+            if (ht->old_ctrl[slot] == HT_CTRL_EMPTY)    {
+                if (visits <= 0)    {
+                    break;
+                }
+            } else {
+                _open_place(ht->ctrl, ht->slots, ht->hashes, ht->buckets, ht->old_slots[slot], ht->old_hashes[slot]);
+                _set_ctrl(ht->old_ctrl, ht->old_buckets, slot, HT_CTRL_EMPTY);
+                ht->old_size--;
+            }
+
+            ht->rehash_index = (slot + 1) & mask;
+            visits--;
+        }
+    } else {
+        visits = steps * 10;
+        while (steps > 0 && ht->old_size > 0)   {
+            bucket = &ht->old_table[ht->rehash_index++];
+            if (*bucket == 0) {
+                if (--visits == 0)  {
+                    break;
+                }
+                continue;
+            }
+
+            while ((entry = *bucket) != 0)  {
+                *bucket = entry->next;
+                _chain_place(ht->table, ht->occupied, ht->buckets, entry);
+                ht->old_size--;
+            }
+            _chain_vacate(ht->old_table, ht->old_occupied, ht->rehash_index - 1);
+            steps--;
+        }
+    }
+
+    if (ht->old_size == 0)  {
+        _rehash_end(ht);
+    }
+}
+
+/**
+ * Moves every remaining value out of the old arrays
+ */
+static void _rehash_finish(hashtable* ht)   {
+    while (ht->rehash_index >= 0)   {
+        _rehash_step(ht, HT_REHASH_STEP);
+    }
+}
+
+/**
+ * Called at the start of every insert and after every successful remove.  Continues a resize in
+ * progress, or starts one if the table would have "count" values outside of its load factors
+ */
+static void _maintain(hashtable* ht, int count) {
+    if (ht->rehash_index >= 0)  {
+        _rehash_step(ht, HT_REHASH_STEP);
+    } else if (count > ht->max_load * ht->buckets)    {
+        _rehash_begin(ht, _fit_buckets(ht, count));
+    } else if (ht->buckets > ht->min_buckets && count < ht->min_load * ht->buckets)  {
+        // Shrink to half of the maximum load so that we don't bounce straight back up
+        _rehash_begin(ht, _fit_buckets(ht, count * 2));
+    }
+}
+
 /**
  * Initializes the given hashtable, with the given number of buckets to hold values.  Takes
  * pointers to functions for:
- *   h: The hash function.  If NULL, P.J. Weinberger's string hash function from the Dragon Book
- *      will be used
+ *   h: The hash function.  If NULL, keys are taken to be strings and hashed with ht_hash_str using a
+ *      seed picked at random for this table
  *   match: The match function.  Used to determine if two keys match.  If NULL, !strcmp will be 
  *      used
  *   destroy: The function to call when the value data of a key needs to be cleaned-up.  Pass in 0
@@ -34,21 +648,56 @@ int ht_init(hashtable* ht, int buckets, int (*h)(const void* key),
     int (*match)(const void* key1, const void* key2), 
     void (*destroy)(void *data))    {
     
-    int i;  
+    return ht_init_engine(ht, HT_ENGINE_CHAINED, buckets, h, match, destroy);
+}
+
+/**
+ * Initializes the given hashtable exactly like ht_init, but using the given storage engine
+ *
+ * Returns 0 if the hashtable was initialized successfully, -1 otherwise
+ */
+int ht_init_engine(hashtable* ht, int engine, int buckets, int (*h)(const void* key), 
+    int (*match)(const void* key1, const void* key2), 
+    void (*destroy)(void *data))    {
+    
+    int slots;
+    
+    memset(ht, 0, sizeof(hashtable));
     
-    if ((ht->table = (list*)malloc(buckets * sizeof(list))) == 0)   {
+    if (engine == HT_ENGINE_OPEN)   {
+        // Round up to a power of 2 with room for "buckets" values under the load limit
+        slots = HT_OPEN_MIN_SLOTS;
+        while (slots > 0 && HT_OPEN_MAX_LOAD(slots) < buckets) {
+            slots *= 2;
+        }
+        
+        if (slots <= 0 || _open_alloc(&ht->ctrl, &ht->slots, &ht->hashes, slots) != 0)  {
+            return -1;
+        }
+
+        ht->buckets = slots;
+        ht->max_load = HT_OPEN_LOAD_LIMIT;
+    } else if (engine == HT_ENGINE_CHAINED) {
+        if (buckets <= 0 || _chain_alloc(&ht->table, &ht->occupied, buckets) != 0)   {
+            return -1;
+        }
+        
+        ht->buckets = buckets;
+        ht->max_load = HT_DEFAULT_MAX_LOAD;
+    } else {
         return -1;
     }
-    
-    ht->buckets = buckets;
-    for (i = 0; i < ht->buckets; i++)   {
-        list_init(&ht->table[i], destroy);
-    }
 
-    ht->h       = h? h : ht_hashpjw;
+    ht->engine  = engine;
+    ht->h       = h;
+    ht->seed    = _next_seed();
     ht->match   = match? match : matchstr;
     ht->destroy = destroy;
     ht->size = 0;
+
+    ht->rehash_index = -1;
+    ht->min_buckets = ht->buckets;
+    ht->min_load = HT_DEFAULT_MIN_LOAD;
     
     return 0;
 }
@@ -59,14 +708,113 @@ int ht_init(hashtable* ht, int buckets, int (*h)(const void* key),
 void ht_destroy(hashtable* ht)  {
     int i;
     
-    for (i = 0; i < ht->buckets; i++)   {
-        list_destroy(&ht->table[i]);
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        if (ht->destroy)    {
+            for (i = 0; i < ht->buckets; i++)   {
+                if (ht->ctrl[i] != HT_CTRL_EMPTY)   {
+                    ht->destroy(ht->slots[i]);
+                }
+            }
+
+            for (i = 0; i < ht->old_buckets; i++)   {
+                if (ht->old_ctrl[i] != HT_CTRL_EMPTY)   {
+                    ht->destroy(ht->old_slots[i]);
+                }
+            }
+        }
+        
+        free(ht->ctrl);
+        free(ht->slots);
+        free(ht->hashes);
+        free(ht->old_ctrl);
+        free(ht->old_slots);
+        free(ht->old_hashes);
+        memset(ht, 0, sizeof(hashtable));
+        return;
     }
     
+    _chain_destroy(ht, ht->table, ht->buckets);
+    _chain_destroy(ht, ht->old_table, ht->old_buckets);
+
     free(ht->table);
+    free(ht->old_table);
+    free(ht->occupied);
+    free(ht->old_occupied);
     memset(ht, 0, sizeof(hashtable));
 }
 
+/**
+ * Replaces the random seed used by the default hash function
+ *
+ * Returns 0 if successful, -1 if the table is not empty
+ */
+int ht_set_seed(hashtable* ht, uint64_t seed)   {
+    if (ht->size > 0)   {
+        return -1;
+    }
+
+    ht->seed = seed;
+    return 0;
+}
+
+/**
+ * Makes the given hashtable draw its entries from a pool
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int ht_set_pool(hashtable* ht, pool* p) {
+    if (ht->size > 0 || ht->engine != HT_ENGINE_CHAINED || p->size < sizeof(hashtable_entry))  {
+        return -1;
+    }
+
+    ht->pool = p;
+    return 0;
+}
+
+/**
+ * Sets the load factors (values per bucket) that trigger a resize of the given hashtable
+ *
+ * Returns 0 if successful, -1 if the load factors are out of range
+ */
+int ht_set_load_factors(hashtable* ht, float max_load, float min_load)    {
+    if (max_load <= 0 || min_load < 0 || min_load * 2 >= max_load)    {
+        return -1;
+    }
+
+    if (ht->engine == HT_ENGINE_OPEN && max_load > HT_OPEN_LOAD_LIMIT)  {
+        return -1;
+    }
+
+    ht->max_load = max_load;
+    ht->min_load = min_load;
+
+    return 0;
+}
+
+/**
+ * Grows the given hashtable so that it can hold at least "count" values without resizing again, and
+ * keeps it from shrinking below that size
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int ht_reserve(hashtable* ht, int count)    {
+    int buckets;
+
+    _rehash_finish(ht);
+
+    buckets = _fit_buckets(ht, count);
+    if (buckets > ht->buckets)  {
+        if (_rehash_begin(ht, buckets) != 0)    {
+            return -1;
+        }
+        _rehash_finish(ht);
+    }
+
+    ht->min_buckets = ht->buckets;
+
+    return 0;
+}
+
 /**
  * Inserts a new value in the given hashtable
  *
@@ -75,21 +823,66 @@ void ht_destroy(hashtable* ht)  {
  */
 int ht_insert(hashtable* ht, const void* data)  {
     void* temp;
-    int bucket, retval;
     
     temp = (void*)data;
-    if (ht_lookup(ht, &temp) == 0)  {
+    return ht_insert_or_get(ht, &temp);
+}
+
+/**
+ * ht_insert_or_get with the hash of *data already computed
+ */
+static int _insert(hashtable* ht, void** data, unsigned int hash)   {
+    hashtable_entry* entry;
+    void* found;
+
+    if (_find(ht, *data, hash, &found) == 0)    {
         // Do nothing, return 1 to signify that the element was already in the table
+        *data = found;
         return 1;
     }
     
-    // Insert the data into the proper bucket
-    bucket = ht->h(data) % ht->buckets;
-    if ((retval = list_insert_next(&ht->table[bucket], NULL, data)) == 0)   {
+    _maintain(ht, ht->size + 1);
+
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        if (ht->size - ht->old_size + 1 > HT_OPEN_MAX_LOAD(ht->buckets)) {
+            // The current slots are full, which only happens if values arrive faster than a shrink
+            // moves them or a resize could not be started.  Finish up and grow right away
+            _rehash_finish(ht);
+            if (ht->size + 1 > HT_OPEN_MAX_LOAD(ht->buckets))    {
+                if (_rehash_begin(ht, ht->buckets * 2) != 0)    {
+                    return -1;
+                }
+                _rehash_finish(ht);
+            }
+        }
+
+        _open_place(ht->ctrl, ht->slots, ht->hashes, ht->buckets, *data, hash);
         ht->size++;
+        return 0;
+    }
+
+    // New values always go into the current table
+    if ((entry = _entry_alloc(ht)) == 0)    {
+        return -1;
     }
     
-    return retval;
+    entry->data = *data;
+    entry->hash = hash;
+    _chain_place(ht->table, ht->occupied, ht->buckets, entry);
+    ht->size++;
+
+    return 0;
+}
+
+/**
+ * Inserts a new value in the given hashtable unless a matching value is already there, hashing the
+ * value only once.  If a match is found, *data is set to the value already in the table
+ *
+ * Returns 0 if the element was inserted, 1 if the element was already in the table, -1 if there was
+ * a problem
+ */
+int ht_insert_or_get(hashtable* ht, void** data)    {
+    return _insert(ht, data, _hash(ht, *data));
 }
 
 /**
@@ -99,27 +892,67 @@ int ht_insert(hashtable* ht, const void* data)  {
  * 0 if removing the element was successful, -1 otherwise
  */
 int ht_remove(hashtable* ht, void** data)   {
-    list_element *element, *prev;
+    hashtable_entry *entry, **link, **table;
+    uint64_t* occupied;
+    unsigned int hash;
+    int slot, bucket;
     
-    int bucket;
-    
-    // Hash the key, then search for the data in the given bucket
-    bucket = ht->h(*data) % ht->buckets;
-    prev = 0;
-    for (element = list_head(&ht->table[bucket]); element != 0; element = list_next(element))   {
-        if (ht->match(*data, list_data(element)))   {
-            // Found it, remove it
-            if (list_remove_next(&ht->table[bucket], prev, data) == 0)  {
+    hash = _hash(ht, *data);
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        if (ht->rehash_index >= 0)  {
+            slot = _open_find(ht, ht->old_ctrl, ht->old_slots, ht->old_hashes, ht->old_buckets, *data, hash);
+            if (slot >= 0)  {
+                *data = ht->old_slots[slot];
+                _open_erase(ht->old_ctrl, ht->old_slots, ht->old_hashes, ht->old_buckets, slot);
+                ht->old_size--;
                 ht->size--;
+                _maintain(ht, ht->size);
                 return 0;
             }
         }
+
+        slot = _open_find(ht, ht->ctrl, ht->slots, ht->hashes, ht->buckets, *data, hash);
+        if (slot < 0)   {
+            return -1;
+        }
         
-        prev = element;
+        *data = ht->slots[slot];
+        _open_erase(ht->ctrl, ht->slots, ht->hashes, ht->buckets, slot);
+        ht->size--;
+        _maintain(ht, ht->size);
+        return 0;
     }
     
-    // Data not found
-    return -1;
+    link = 0;
+    if (ht->rehash_index >= 0)  {
+        if ((link = _chain_find(ht, &ht->old_table[hash % ht->old_buckets], *data, hash)) != 0)   {
+            ht->old_size--;
+        }
+    }
+    
+    if (link)   {
+        table = ht->old_table;
+        occupied = ht->old_occupied;
+        bucket = hash % ht->old_buckets;
+    } else if ((link = _chain_find(ht, &ht->table[hash % ht->buckets], *data, hash)) != 0)  {
+        table = ht->table;
+        occupied = ht->occupied;
+        bucket = hash % ht->buckets;
+    } else {
+        // Data not found
+        return -1;
+    }
+
+    // Found it, unlink it
+    entry = *link;
+    *link = entry->next;
+    *data = entry->data;
+    _entry_free(ht, entry);
+    _chain_vacate(table, occupied, bucket);
+    ht->size--;
+    _maintain(ht, ht->size);
+
+    return 0;
 }
 
 /**
@@ -129,21 +962,257 @@ int ht_remove(hashtable* ht, void** data)   {
  * Returns 0 if a match was found in the hashtable, -1 otherwise
  */
 int ht_lookup(hashtable* ht, void** data)   {
-    list_element *element;
+    return _find(ht, *data, _hash(ht, *data), data);
+}
+
+/**
+ * Prefetches the memory a lookup of the given hash will read first: the home bucket, or the control
+ * bytes and stored hashes around the home slot, in both tables during a resize
+ */
+static void _prefetch_home(hashtable* ht, unsigned int hash)    {
+    int slot;
+
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        slot = hash & (ht->buckets - 1);
+        HT_PREFETCH(ht->ctrl + slot);
+        HT_PREFETCH(ht->hashes + slot);
+        if (ht->rehash_index >= 0)  {
+            slot = hash & (ht->old_buckets - 1);
+            HT_PREFETCH(ht->old_ctrl + slot);
+            HT_PREFETCH(ht->old_hashes + slot);
+        }
+    } else {
+        HT_PREFETCH(ht->table + hash % ht->buckets);
+        if (ht->rehash_index >= 0)  {
+            HT_PREFETCH(ht->old_table + hash % ht->old_buckets);
+        }
+    }
+}
+
+/**
+ * Prefetches what a lookup reads next, once _prefetch_home has had time to land: the first entry of the
+ * chain, or the stored value in the home slot
+ */
+static void _prefetch_next(hashtable* ht, unsigned int hash)    {
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        HT_PREFETCH(ht->slots + (hash & (ht->buckets - 1)));
+    } else {
+        HT_PREFETCH(ht->table[hash % ht->buckets]);
+        if (ht->rehash_index >= 0)  {
+            HT_PREFETCH(ht->old_table[hash % ht->old_buckets]);
+        }
+    }
+}
+
+/**
+ * Prefetches the value match() will be called on first, once _prefetch_next has landed
+ */
+static void _prefetch_value(hashtable* ht, unsigned int hash)   {
+    hashtable_entry* entry;
+    int slot;
+
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        slot = hash & (ht->buckets - 1);
+        if (ht->hashes[slot] == hash)   {
+            HT_PREFETCH(ht->slots[slot]);
+        }
+    } else if ((entry = ht->table[hash % ht->buckets]) != 0 && entry->hash == hash) {
+        HT_PREFETCH(entry->data);
+    }
+}
+
+/**
+ * Looks up "count" keys at once.  Keys are hashed and their buckets prefetched a batch at a time before
+ * any of them are resolved, so the cache misses of different keys overlap instead of following one
+ * another.  Each data[i] and status[i] are set as if by ht_lookup(ht, &data[i])
+ *
+ * Returns the number of keys that were found
+ */
+int ht_lookup_batch(hashtable* ht, void** data, int* status, int count)  {
+    unsigned int hashes[HT_BATCH];
+    int i, n, found;
+
+    found = 0;
+    for (; count > 0; data += n, status += n, count -= n)  {
+        n = count < HT_BATCH? count : HT_BATCH;
+        for (i = 0; i < n; i++) {
+            hashes[i] = _hash(ht, data[i]);
+            _prefetch_home(ht, hashes[i]);
+        }
+
+        for (i = 0; i < n; i++) {
+            _prefetch_next(ht, hashes[i]);
+        }
+
+        for (i = 0; i < n; i++) {
+            _prefetch_value(ht, hashes[i]);
+        }
+
+        for (i = 0; i < n; i++) {
+            if ((status[i] = _find(ht, data[i], hashes[i], &data[i])) == 0)  {
+                found++;
+            }
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Inserts "count" values at once, hashing and prefetching a batch at a time like ht_lookup_batch.  Each
+ * data[i] and status[i] are set as if by ht_insert_or_get(ht, &data[i]).  Values are inserted in order,
+ * so a later duplicate in the same call finds the earlier one
+ *
+ * Returns the number of values that were inserted
+ */
+int ht_insert_batch(hashtable* ht, void** data, int* status, int count)  {
+    unsigned int hashes[HT_BATCH];
+    int i, n, inserted;
+
+    inserted = 0;
+    for (; count > 0; data += n, status += n, count -= n)  {
+        n = count < HT_BATCH? count : HT_BATCH;
+        for (i = 0; i < n; i++) {
+            hashes[i] = _hash(ht, data[i]);
+            _prefetch_home(ht, hashes[i]);
+        }
+
+        for (i = 0; i < n; i++) {
+            _prefetch_next(ht, hashes[i]);
+        }
+
+        for (i = 0; i < n; i++) {
+            _prefetch_value(ht, hashes[i]);
+        }
+
+        // Inserting may start or continue a resize, which only makes some of the prefetches useless
+        for (i = 0; i < n; i++) {
+            if ((status[i] = _insert(ht, &data[i], hashes[i])) == 0)   {
+                inserted++;
+            }
+        }
+    }
+
+    return inserted;
+}
+
+/**
+ * Returns the first nonempty chained bucket at or after the given iteration position, or -1.  Positions
+ * run through the old table (if a resize is in progress) and then the current one
+ */
+static int _iter_next_bucket(hashtable* ht, int pos)    {
     int bucket;
-    
-    // Hash the key, then search for the data in the bucket
-    bucket = ht->h(*data) % ht->buckets;
-    for (element = list_head(&ht->table[bucket]); element != 0; element = list_next(element))   {
-        if (ht->match(*data, list_data(element)))   {
-            // We found it
-            *data = list_data(element);
-            return 0;
+
+    if (pos < ht->old_buckets)  {
+        if ((bucket = _bitmap_next(ht->old_occupied, ht->old_buckets, pos)) >= 0)   {
+            return bucket;
         }
+        pos = ht->old_buckets;
     }
-    
-    // Data not found
-    return -1;
+
+    bucket = _bitmap_next(ht->occupied, ht->buckets, pos - ht->old_buckets);
+    return bucket < 0? -1 : bucket + ht->old_buckets;
+}
+
+/**
+ * Returns the first occupied open addressing slot at or after the given iteration position, or -1
+ */
+static int _iter_next_slot(hashtable* ht, int pos)  {
+    int slot;
+
+    if (pos < ht->old_buckets)  {
+        if ((slot = _open_next_full(ht->old_ctrl, ht->old_buckets, pos)) >= 0)  {
+            return slot;
+        }
+        pos = ht->old_buckets;
+    }
+
+    slot = _open_next_full(ht->ctrl, ht->buckets, pos - ht->old_buckets);
+    return slot < 0? -1 : slot + ht->old_buckets;
+}
+
+/**
+ * Moves the cursor to the first value at or after the given iteration position
+ *
+ * Returns 0 if the cursor is on a value, -1 if there are none left
+ */
+static int _cursor_seek(hashtable_cursor* cursor, int pos)  {
+    hashtable* ht = cursor->ht;
+
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        pos = _iter_next_slot(ht, pos);
+    } else {
+        pos = _iter_next_bucket(ht, pos);
+    }
+
+    if (pos < 0)    {
+        cursor->entry = 0;
+        cursor->value = 0;
+        cursor->end = 1;
+        return -1;
+    }
+
+    cursor->position = pos;
+    if (ht->engine == HT_ENGINE_OPEN)   {
+        cursor->value = pos < ht->old_buckets? ht->old_slots[pos] : ht->slots[pos - ht->old_buckets];
+    } else {
+        cursor->entry = pos < ht->old_buckets? ht->old_table[pos] : ht->table[pos - ht->old_buckets];
+        cursor->value = cursor->entry->data;
+    }
+
+    return 0;
+}
+
+/**
+ * Begin iterating through the given hashtable using the given cursor
+ *
+ * Returns 0 if the cursor is on the first value, -1 if the table is empty
+ */
+int ht_cursor_begin(hashtable* ht, hashtable_cursor* cursor)    {
+    cursor->ht = ht;
+    cursor->position = 0;
+    cursor->entry = 0;
+    cursor->value = 0;
+    cursor->end = 0;
+
+    return _cursor_seek(cursor, 0);
+}
+
+/**
+ * Moves the given cursor to the next value in the hashtable
+ *
+ * Returns 0 if the cursor is on a value, -1 if we have reached the end of the table
+ */
+int ht_cursor_next(hashtable_cursor* cursor)    {
+    if (cursor->end)    {
+        return -1;
+    }
+
+    if (cursor->entry && cursor->entry->next)   {
+        cursor->entry = cursor->entry->next;
+        cursor->value = cursor->entry->data;
+        return 0;
+    }
+
+    return _cursor_seek(cursor, cursor->position + 1);
+}
+
+/**
+ * Calls fn on every value in the hashtable, stopping early if fn returns nonzero
+ *
+ * Returns 0 if every value was visited, otherwise what fn returned when it stopped
+ */
+int ht_foreach(hashtable* ht, int (*fn)(void* data, void* arg), void* arg) {
+    hashtable_cursor cursor;
+    int result;
+
+    for (ht_cursor_begin(ht, &cursor); !cursor.end; ht_cursor_next(&cursor))  {
+        if ((result = fn(cursor.value, arg)) != 0)  {
+            return result;
+        }
+    }
+
+    return 0;
 }
 
 /**
@@ -153,23 +1222,14 @@ int ht_lookup(hashtable* ht, void** data)   {
  */
 hashtable_iter* ht_iter_begin(hashtable* ht)    {
     hashtable_iter_impl* hi;
-    list_element* elem;
-    int i;
+    hashtable_cursor cursor;
     
-    hi = 0;
-    elem = 0;
-    for (i = 0; i < ht->buckets; i++)   {
-        elem = list_head(&ht->table[i]);
-        if (elem)   {
-            break;
-        }
+    if (ht_cursor_begin(ht, &cursor) != 0)  {
+        return 0;
     }
     
-    if (elem)   {
-        hi = (hashtable_iter_impl*)malloc(sizeof(hashtable_iter_impl));
-        hi->ht = ht;
-        hi->current_bucket = i;
-        hi->current = elem;
+    if ((hi = (hashtable_iter_impl*)malloc(sizeof(hashtable_iter_impl))) != 0)  {
+        hi->cursor = cursor;
     }
     
     return hi;
@@ -184,29 +1244,13 @@ hashtable_iter* ht_iter_begin(hashtable* ht)    {
  */
 hashtable_iter* ht_iter_next(hashtable_iter* current)   {
     hashtable_iter_impl* cur;
-    list_element* elem;
-    int i;
     
     if (!current)   {
         return 0;
     }
     
     cur = (hashtable_iter_impl*)current;
-    i = cur->current_bucket;
-    elem = cur->current->next;
-    if (!elem)  {
-        for (i = cur->current_bucket+1; i < cur->ht->buckets; i++)  {
-            elem = list_head(&cur->ht->table[i]);
-            if (elem)   {
-                break;
-            }
-        }
-    }
-    
-    if (elem)   {
-        cur->current_bucket = i;
-        cur->current = elem; 
-    } else {
+    if (ht_cursor_next(&cur->cursor) != 0)  {
         free(cur);
         cur = 0;
     }
@@ -218,12 +1262,131 @@ hashtable_iter* ht_iter_next(hashtable_iter* current)   {
  * Returns the value of the given iterator
  */
 void* ht_value(hashtable_iter* iter)    {
-    return ((hashtable_iter_impl*)iter)->current->data;
+    return ((hashtable_iter_impl*)iter)->cursor.value;
+}
+
+/* Constants and primitives of the default hash */
+#define HT_WY0  0xa0761d6478bd642fULL
+#define HT_WY1  0xe7037ed1a0b428dbULL
+#define HT_WY2  0x8ebc6af09c88c6e3ULL
+#define HT_WY3  0x589965cc75374cc3ULL
+
+/**
+ * Multiplies a and b into a 128 bit product, returning the low half in a and the high half in b
+ */
+static void _wymum(uint64_t* a, uint64_t* b)    {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha, hb, la, lb, rh, rm0, rm1, rl, t, lo;
+    int c;
+
+    ha = *a >> 32;
+    hb = *b >> 32;
+    la = (uint32_t)*a;
+    lb = (uint32_t)*b;
+    rh = ha * hb;
+    rm0 = ha * lb;
+    rm1 = hb * la;
+    rl = la * lb;
+    t = rl + (rm0 << 32);
+    c = t < rl;
+    lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/**
+ * Multiplies a and b and folds the 128 bit product down to 64 bits
+ */
+static uint64_t _wymix(uint64_t a, uint64_t b)  {
+    _wymum(&a, &b);
+    return a ^ b;
+}
+
+static uint64_t _read8(const unsigned char* p)  {
+    uint64_t v;
+
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t _read4(const unsigned char* p)  {
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return v;
+}
+
+/**
+ * The default hashing function.  A seeded 64-bit hash in the style of wyhash
+ */
+uint64_t ht_hash_bytes(const void* data, size_t length, uint64_t seed)  {
+    const unsigned char* p;
+    uint64_t a, b, see1, see2;
+    size_t i;
+
+    p = (const unsigned char*)data;
+    seed ^= _wymix(seed ^ HT_WY0, HT_WY1);
+    if (length <= 16)   {
+        if (length >= 4)    {
+            // Two overlapping pairs of 4 byte reads cover every length from 4 to 16
+            a = (_read4(p) << 32) | _read4(p + ((length >> 3) << 2));
+            b = (_read4(p + length - 4) << 32) | _read4(p + length - 4 - ((length >> 3) << 2));
+        } else if (length > 0)  {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        i = length;
+        if (i > 48) {
+            // Three independent lanes so that the multiplies can overlap
+            see1 = seed;
+            see2 = seed;
+            do {
+                seed = _wymix(_read8(p) ^ HT_WY1, _read8(p + 8) ^ seed);
+                see1 = _wymix(_read8(p + 16) ^ HT_WY2, _read8(p + 24) ^ see1);
+                see2 = _wymix(_read8(p + 32) ^ HT_WY3, _read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16)  {
+            seed = _wymix(_read8(p) ^ HT_WY1, _read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        // The last 16 bytes, which may overlap bytes that were already consumed
+        a = _read8(p + i - 16);
+        b = _read8(p + i - 8);
+    }
+
+    a ^= HT_WY1;
+    b ^= seed;
+    _wymum(&a, &b);
+
+    return _wymix(a ^ HT_WY0 ^ length, b ^ HT_WY1);
+}
+
+/**
+ * Hashes the given NUL terminated string with ht_hash_bytes
+ */
+uint64_t ht_hash_str(const char* key, uint64_t seed)    {
+    return ht_hash_bytes(key, strlen(key), seed);
 }
 
 /**
- * The default hashing function - works great for strings.  This was taken from the venerable
- * Dragon Book and Algorithms With C and was created by P.J. Weinberger
+ * The original default hashing function.  This was taken from the venerable Dragon Book and Algorithms
+ * With C and was created by P.J. Weinberger
  *
  */
 int ht_hashpjw(const void* key) {
@@ -255,4 +1418,4 @@ int ht_hashpjw(const void* key) {
  */ 
 int matchstr(const void* key1, const void* key2)    {
     return !strcmp((const char*)key1, (const char*)key2);
-}
\ No newline at end of file
+}
@@ -0,0 +1,280 @@
+/**
+ * 4-ary heap
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "heap.h"
+
+#define HEAP_MIN_CAPACITY   16
+#define HEAP_PARENT(i)      (((i) - 1) / HEAP_ARITY)
+#define HEAP_CHILD(i)       ((i) * HEAP_ARITY + 1)
+
+/**
+ * Makes room for at least "capacity" values (and handles)
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+static int _reserve(heap* h, int capacity)  {
+    heap_entry* entries;
+    int* positions;
+    int size;
+
+    if (capacity <= h->capacity)    {
+        return 0;
+    }
+
+    for (size = h->capacity? h->capacity : HEAP_MIN_CAPACITY; size < capacity; size *= 2)    {
+        if (size > (1 << 29))   {
+            return -1;
+        }
+    }
+
+    if ((entries = (heap_entry*)realloc(h->entries, size * sizeof(heap_entry))) == 0)   {
+        return -1;
+    }
+    h->entries = entries;
+
+    if ((positions = (int*)realloc(h->positions, size * sizeof(int))) == 0) {
+        return -1;
+    }
+    h->positions = positions;
+
+    h->capacity = size;
+    return 0;
+}
+
+/**
+ * Puts the entry at index i, keeping its handle's position up to date
+ */
+static void _place(heap* h, int i, heap_entry e)    {
+    h->entries[i] = e;
+    h->positions[e.handle] = i;
+}
+
+/**
+ * Moves the entry at index i up until its parent comes out before it
+ *
+ * Returns the entry's new index
+ */
+static int _sift_up(heap* h, int i) {
+    heap_entry e = h->entries[i];
+    int parent;
+
+    while (i > 0)   {
+        parent = HEAP_PARENT(i);
+        if (h->compare(h->entries[parent].data, e.data) <= 0)   {
+            break;
+        }
+        _place(h, i, h->entries[parent]);
+        i = parent;
+    }
+
+    _place(h, i, e);
+    return i;
+}
+
+/**
+ * Moves the entry at index i down until it comes out before all of its children
+ */
+static void _sift_down(heap* h, int i)  {
+    heap_entry e = h->entries[i];
+    int child, best, end;
+
+    while ((child = HEAP_CHILD(i)) < h->size)   {
+        end = child + HEAP_ARITY < h->size? child + HEAP_ARITY : h->size;
+        for (best = child++; child < end; child++)  {
+            if (h->compare(h->entries[child].data, h->entries[best].data) < 0)  {
+                best = child;
+            }
+        }
+
+        if (h->compare(e.data, h->entries[best].data) <= 0) {
+            break;
+        }
+        _place(h, i, h->entries[best]);
+        i = best;
+    }
+
+    _place(h, i, e);
+}
+
+/**
+ * Returns a free handle, which the caller must use
+ */
+static int _take_handle(heap* h)    {
+    int handle = h->free_handle;
+
+    if (handle < 0) {
+        return h->handles++;
+    }
+
+    h->free_handle = -2 - h->positions[handle];
+    return handle;
+}
+
+static void _free_handle(heap* h, int handle)   {
+    h->positions[handle] = -2 - h->free_handle;
+    h->free_handle = handle;
+}
+
+/**
+ * Initializes the given heap
+ *
+ * Returns 0 if the heap was initialized successfully, -1 otherwise
+ */
+int heap_init(heap* h, int capacity, int (*compare)(const void* key1, const void* key2),
+    void (*destroy)(void *data))    {
+    memset(h, 0, sizeof(heap));
+    if (!compare || capacity < 0)   {
+        return -1;
+    }
+
+    h->compare = compare;
+    h->destroy = destroy;
+    h->free_handle = -1;
+
+    if (_reserve(h, capacity) != 0) {
+        heap_destroy(h);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Destroys the given heap, calling the user-supplied "destroy" function on each value in it
+ */
+void heap_destroy(heap* h)  {
+    int i;
+
+    if (h->destroy) {
+        for (i = 0; i < h->size; i++)   {
+            h->destroy(h->entries[i].data);
+        }
+    }
+
+    free(h->entries);
+    free(h->positions);
+    memset(h, 0, sizeof(heap));
+}
+
+/**
+ * Adds a value to the heap
+ *
+ * Returns the value's handle, or -1 if there was a problem
+ */
+int heap_push(heap* h, const void* data)    {
+    heap_entry e;
+
+    // Handles in use never outnumber values, so with room for one more value there is a handle for it
+    if (_reserve(h, h->size + 1) != 0)  {
+        return -1;
+    }
+
+    e.data = (void*)data;
+    e.handle = _take_handle(h);
+    _place(h, h->size++, e);
+    _sift_up(h, h->size - 1);
+
+    return e.handle;
+}
+
+/**
+ * Adds n values to an empty heap at once
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int heap_heapify(heap* h, void* const* data, int n) {
+    heap_entry e;
+    int i;
+
+    if (h->size != 0 || n < 0 || _reserve(h, n) != 0)  {
+        return -1;
+    }
+
+    // Start the handles over, so data[i] can get handle i
+    h->handles = n;
+    h->free_handle = -1;
+    for (i = 0; i < n; i++) {
+        e.data = data[i];
+        e.handle = i;
+        _place(h, i, e);
+    }
+    h->size = n;
+
+    // Every node past the last parent is already a heap of one
+    for (i = n > 1? HEAP_PARENT(n - 1) : -1; i >= 0; i--)   {
+        _sift_down(h, i);
+    }
+
+    return 0;
+}
+
+/**
+ * Removes the entry at index i, which must be in use, and stores its value in "data"
+ */
+static void _remove_at(heap* h, int i, void** data) {
+    heap_entry last;
+
+    *data = h->entries[i].data;
+    _free_handle(h, h->entries[i].handle);
+
+    // Fill the hole with the last entry, which may belong above or below it
+    last = h->entries[--h->size];
+    if (i < h->size)    {
+        _place(h, i, last);
+        if (_sift_up(h, i) == i)    {
+            _sift_down(h, i);
+        }
+    }
+}
+
+/**
+ * Removes the value that comes out first
+ *
+ * Returns 0 if successful, -1 if the heap is empty
+ */
+int heap_pop(heap* h, void** data)  {
+    if (h->size == 0)   {
+        return -1;
+    }
+
+    _remove_at(h, 0, data);
+    return 0;
+}
+
+/**
+ * Replaces the value with the given handle, and moves it to where its new priority puts it
+ *
+ * Returns 0 if successful, -1 if the handle isn't in use
+ */
+int heap_update(heap* h, int handle, const void* data)  {
+    int i;
+
+    if (handle < 0 || handle >= h->handles || (i = h->positions[handle]) < 0)  {
+        return -1;
+    }
+
+    h->entries[i].data = (void*)data;
+    if (_sift_up(h, i) == i)    {
+        _sift_down(h, i);
+    }
+
+    return 0;
+}
+
+/**
+ * Removes the value with the given handle
+ *
+ * Returns 0 if successful, -1 if the handle isn't in use
+ */
+int heap_remove(heap* h, int handle, void** data)   {
+    if (handle < 0 || handle >= h->handles || h->positions[handle] < 0)   {
+        return -1;
+    }
+
+    _remove_at(h, h->positions[handle], data);
+    return 0;
+}
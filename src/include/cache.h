@@ -0,0 +1,90 @@
+/**
+ * Bounded cache.  Values are indexed by a hashtable (so h and match work exactly as for ht_init) and
+ * kept in recency order on an intrusive list, which makes get, put and eviction all O(1)
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+#include "hashtable.h"
+#include "ilist.h"
+
+/* Eviction policies */
+#define CACHE_LRU               0       /* Evict the least recently used value.  Every hit moves a value */
+#define CACHE_CLOCK             1       /* Second chance: a hit only sets a bit, the clock hand clears it */
+
+typedef struct cache_entry_tag cache_entry;
+
+typedef struct cache_tag    {
+    int     policy;
+    int     (*h)(const void* key);
+    int     (*match)(const void* key1, const void* key2);
+    void    (*destroy)(void *data);     /* Called on every value that is evicted, replaced or destroyed */
+
+    hashtable   index;                  /* Holds cache_entry pointers */
+    ilist       ring;                   /* Entries, the first is the most recently added or used value */
+    ilist_node* hand;                   /* CACHE_CLOCK: next entry to consider for eviction, or ring.head */
+    ilist       spare;                  /* Entries kept from evictions, reused by later puts */
+
+    size_t  capacity;                   /* Total cost allowed */
+    size_t  used;                       /* Total cost of the values in the cache */
+
+    unsigned long   hits;
+    unsigned long   misses;
+    unsigned long   evictions;
+} cache;
+
+/**
+ * Initializes the given cache.  "capacity" is the total cost of the values it may hold: with
+ * cache_put every value costs 1, so this is an entry count, with cache_put_cost it can be a size in
+ * bytes.  h, match and destroy are as for ht_init, and destroy doubles as the eviction callback
+ *
+ * Returns 0 if the cache was initialized successfully, -1 otherwise
+ */
+int cache_init(cache* c, size_t capacity, int policy, int (*h)(const void* key),
+    int (*match)(const void* key1, const void* key2),
+    void (*destroy)(void *data));
+
+/**
+ * Destroys the given cache, calling the user-supplied "destroy" function on each value in it
+ */
+void cache_destroy(cache* c);
+
+/**
+ * Looks up the value matching *data.  On a hit, data points to the cached value, which is marked as
+ * recently used.  Never allocates
+ *
+ * Returns 0 on a hit, -1 on a miss
+ */
+int cache_get(cache* c, void** data);
+
+/**
+ * Adds a value to the cache with a cost of 1, see cache_put_cost
+ */
+int cache_put(cache* c, const void* data);
+
+/**
+ * Adds a value to the cache with the given cost, first evicting as many values as needed to make room.
+ * A value matching it that is already cached is replaced (and destroyed, unless it is the same pointer)
+ *
+ * Returns 0 if the value was added, 1 if it replaced a value, -1 if there was a problem or the cost is
+ * larger than the whole capacity
+ */
+int cache_put_cost(cache* c, const void* data, size_t cost);
+
+/**
+ * Removes the value matching *data without destroying it.  If successful, data points to the value
+ * removed and it is up to the caller to further manage it
+ *
+ * Returns 0 if the value was removed, -1 if it wasn't in the cache
+ */
+int cache_remove(cache* c, void** data);
+
+/**
+ * Returns the number of values in the cache
+ */
+#define cache_size(c) ilist_size(&(c)->ring)
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * Concurrent hashtable.  The same shape as the ht_* API, but every function except cht_init and
+ * cht_destroy may be called from any number of threads at once without outside locking
+ *
+ * The table is split into CHT_SEGMENTS segments by the top bits of each hash, and each segment is a
+ * separately resized chained table with its own lock, doubled when it holds more values than buckets and
+ * halved when it falls below a quarter full.  Writers (insert and remove) lock only the
+ * segment they touch.  Readers (lookup) take no locks at all: they walk the chains while inside an
+ * epoch, and anything a writer unlinks (entries, or a whole bucket array replaced by a resize) is only
+ * freed once every thread that could still be looking at it has left its epoch
+ */
+
+#ifndef CHASHTABLE_H
+#define CHASHTABLE_H
+
+#include <stdint.h>
+
+/* Number of independently locked segments, a power of 2 */
+#define CHT_SEGMENTS                64
+
+typedef struct chashtable_segment_tag chashtable_segment;
+
+typedef struct chashtable_tag   {
+    int     (*h)(const void* key);
+    int     (*match)(const void* key1, const void* key2);
+    void    (*destroy)(void *data);
+
+    uint64_t            seed;       /* Used by the default hash function */
+    chashtable_segment* segments;
+} chashtable;
+
+/**
+ * Initializes the given concurrent hashtable with room for about "buckets" values to start with.  h,
+ * match and destroy are exactly as for ht_init (a NULL h hashes keys as strings with a random seed, a
+ * NULL match compares them with strcmp), and must be safe to call from several threads at once
+ * NOTE: Not thread safe, the table must not be used until this returns
+ *
+ * Returns 0 if the hashtable was initialized successfully, -1 otherwise
+ */
+int cht_init(chashtable* cht, int buckets, int (*h)(const void* key),
+    int (*match)(const void* key1, const void* key2),
+    void (*destroy)(void *data));
+
+/**
+ * Destroys the given hashtable, calling the user-supplied "destroy" function on each value in the hash
+ * NOTE: Not thread safe, no other thread may be using the table
+ */
+void cht_destroy(chashtable* cht);
+
+/**
+ * Inserts a new value in the given hashtable
+ *
+ * Returns 0 if inserting the element was successful, 1 if the element was already in the table,
+ * -1 if there was a problem
+ */
+int cht_insert(chashtable* cht, const void* data);
+
+/**
+ * Inserts a new value in the given hashtable unless a matching value is already there.  The check and
+ * the insert happen atomically.  If a match is found, *data is set to the value already in the table
+ *
+ * Returns 0 if the element was inserted, 1 if the element was already in the table (and *data now
+ * points to it), -1 if there was a problem
+ */
+int cht_insert_or_get(chashtable* cht, void** data);
+
+/**
+ * Removes an element from the given hashtable, shrinking its segment if that leaves it mostly empty.
+ * If successful, data contains a pointer to the data removed.  Other threads may have looked the value
+ * up just before it was removed and still be using it, so if it has to be freed, hand it to cht_retire
+ * rather than freeing it directly
+ *
+ * 0 if removing the element was successful, -1 otherwise
+ */
+int cht_remove(chashtable* cht, void** data);
+
+/**
+ * Determines whether an element matches the given data in the hashtable, without taking any locks.
+ * If so, data points to the matched value in the hashtable
+ *
+ * Returns 0 if a match was found in the hashtable, -1 otherwise
+ */
+int cht_lookup(chashtable* cht, void** data);
+
+/**
+ * Returns the number of values in the table.  While other threads are writing this is only a snapshot
+ */
+int cht_size(chashtable* cht);
+
+/**
+ * Returns the number of buckets in the table, across all of its segments.  While other threads are
+ * writing this is only a snapshot
+ */
+int cht_buckets(chashtable* cht);
+
+/**
+ * Calls fn(data) once no thread can still be inside a lookup that began before this call.  Used to free
+ * values removed with cht_remove
+ */
+void cht_retire(void* data, void (*fn)(void* data));
+
+/**
+ * Frees everything retired so far by the calling thread and by threads that have exited, waiting for
+ * other threads' lookups to finish.  Does not need to be called, each thread otherwise frees what it
+ * retired a batch at a time as it keeps retiring more
+ * NOTE: Must not be called from inside a lookup (from a hash or match function)
+ */
+void cht_quiesce();
+
+#endif
@@ -5,7 +5,20 @@
 #ifndef HASHTABLE_H
 #define HASHTABLE_H
 
-#include "list.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pool.h"
+
+/* Storage engines that can be selected with ht_init_engine */
+#define HT_ENGINE_CHAINED           0       /* Array of linked bucket chains (the default) */
+#define HT_ENGINE_OPEN              1       /* Open addressing with a control byte per slot */
+
+/* A value stored by the chained engine, along with its hash */
+typedef struct hashtable_entry_tag  hashtable_entry;
+
+/* The smallest object size of a pool that can be given to ht_set_pool */
+#define HT_ENTRY_SIZE               (3 * sizeof(void*))
 
 typedef struct hashtable_tag    {
     int     buckets;
@@ -14,27 +27,81 @@ typedef struct hashtable_tag    {
     void    (*destroy)(void *data);
     
     int     size;
+    int     engine;
+    
+    hashtable_entry**   table;      /* HT_ENGINE_CHAINED: one chain of entries per bucket */
+    uint64_t*           occupied;   /* HT_ENGINE_CHAINED: one bit per bucket, set if its chain isn't empty */
+    
+    unsigned char*  ctrl;           /* HT_ENGINE_OPEN: control byte per slot, plus a mirrored group */
+    void**          slots;          /* HT_ENGINE_OPEN: the stored values */
+    unsigned int*   hashes;         /* HT_ENGINE_OPEN: the full hash of each stored value */
+    
+    /* While a resize is in progress (rehash_index >= 0), values are moved a few at a time from the
+       old_* arrays into the ones above on every insert and remove */
+    int             rehash_index;
+    int             old_buckets;
+    int             old_size;
+    hashtable_entry**   old_table;
+    uint64_t*           old_occupied;
+    unsigned char*  old_ctrl;
+    void**          old_slots;
+    unsigned int*   old_hashes;
+    
+    uint64_t    seed;               /* Seed for the default hash, random for every table */
+    
+    int     min_buckets;            /* The table never shrinks below this many buckets */
+    float   max_load;
+    float   min_load;
     
-    list*   table;
+    pool*   pool;                   /* HT_ENGINE_CHAINED: where entries come from, or NULL for malloc */
 } hashtable;
 
 typedef struct hashtable_iter_tag hashtable_iter;
 
+/* Iteration state that lives in storage owned by the caller (usually the stack), see ht_cursor_begin */
+typedef struct hashtable_cursor_tag {
+    hashtable*          ht;
+    int                 position;   /* Bucket or slot, counting the old arrays first during a resize */
+    hashtable_entry*    entry;
+    void*               value;      /* The current value */
+    int                 end;        /* Nonzero once every value has been visited */
+} hashtable_cursor;
+
 /**
  * Initializes the given hashtable, with the given number of buckets to hold values.  Takes
  * pointers to functions for:
- *   h: The hash function.  If NULL, P.J. Weinberger's string hash function from the Dragon Book
- *      will be used
+ *   h: The hash function.  If NULL, keys are taken to be strings and hashed with ht_hash_str using a
+ *      seed picked at random for this table, so that colliding keys can't be precomputed
  *   match: The match function.  Used to determine if two keys match.  If NULL, !strcmp will be 
  *      used
  *   destroy: The function to call when the value data of a key needs to be cleaned-up.  Pass in 0
  *      if you wish to take care of this yourself, or you could pass in free() if the objects are simple
  *
+ * The number of buckets is only the starting (and minimum) size, the table grows as values are added,
+ * see ht_set_load_factors
+ *
  * Returns 0 if the hashtable was initialized successfully, -1 otherwise    
  */
 int ht_init(hashtable* ht, int buckets, int (*h)(const void* key), 
     int (*match)(const void* key1, const void* key2), 
     void (*destroy)(void *data));
+
+/**
+ * Initializes the given hashtable exactly like ht_init, but using the given storage engine:
+ *   HT_ENGINE_CHAINED: Each bucket is a linked chain of entries.  This is what ht_init uses
+ *   HT_ENGINE_OPEN: Values are stored in one contiguous array of slots, with a parallel array of control
+ *      bytes holding 7 bits of each value's hash.  Lookups compare a whole group of control bytes at a
+ *      time (with SSE2 where available) and only call match on the slots whose bits agree.  Removal
+ *      shifts the following entries back rather than leaving tombstones.  "buckets" is rounded up to a
+ *      power of 2 with room for that many values
+ *
+ * The rest of the ht_* API behaves identically for both engines
+ *
+ * Returns 0 if the hashtable was initialized successfully, -1 otherwise
+ */
+int ht_init_engine(hashtable* ht, int engine, int buckets, int (*h)(const void* key), 
+    int (*match)(const void* key1, const void* key2), 
+    void (*destroy)(void *data));
     
 /** 
  * Destroys the given hashtable, calling the user-supplied "destroy" function on each value in the hash
@@ -49,6 +116,15 @@ void ht_destroy(hashtable* ht);
  */
 int ht_insert(hashtable* ht, const void* data);
 
+/**
+ * Inserts a new value in the given hashtable unless a matching value is already there, hashing the
+ * value only once.  If a match is found, *data is set to the value already in the table
+ *
+ * Returns 0 if the element was inserted, 1 if the element was already in the table (and *data now
+ * points to it), -1 if there was a problem
+ */
+int ht_insert_or_get(hashtable* ht, void** data);
+
 /**
  * Removes an element from the given hashtable.  If successful, data contains a pointer to the data 
  * removed.  It is up to the caller to further manage this data.
@@ -65,6 +141,64 @@ int ht_remove(hashtable* ht, void** data);
  */
 int ht_lookup(hashtable* ht, void** data);
 
+/**
+ * Looks up "count" keys at once, overlapping their memory accesses.  On return data[i] and status[i]
+ * hold what ht_lookup(ht, &data[i]) would have left in data[i] and returned
+ *
+ * Returns the number of keys that were found
+ */
+int ht_lookup_batch(hashtable* ht, void** data, int* status, int count);
+
+/**
+ * Inserts "count" values at once, overlapping their memory accesses.  On return data[i] and status[i]
+ * hold what ht_insert_or_get(ht, &data[i]) would have left in data[i] and returned
+ *
+ * Returns the number of values that were inserted
+ */
+int ht_insert_batch(hashtable* ht, void** data, int* status, int count);
+
+/**
+ * Replaces the random seed used by the default hash function (for reproducible tests and benchmarks).
+ * Has no effect on tables with a user-supplied hash function
+ *
+ * Returns 0 if successful, -1 if the table is not empty
+ */
+int ht_set_seed(hashtable* ht, uint64_t seed);
+
+/**
+ * Makes the given (chained) hashtable draw its entries from a pool instead of malloc.  The pool's objects
+ * must be at least HT_ENTRY_SIZE bytes, and it can be shared with other hashtables and lists.  Unlike a
+ * list, the table still owns its bucket arrays, so it must be destroyed with ht_destroy (which gives its
+ * entries back to the pool) before the pool is
+ *
+ * Returns 0 if successful, -1 if the table is not empty, uses HT_ENGINE_OPEN or the objects are too small
+ */
+int ht_set_pool(hashtable* ht, pool* p);
+
+/**
+ * Sets the load factors (values per bucket) that trigger a resize of the given hashtable.  Once the
+ * load goes above max_load the table grows, once it drops below min_load it shrinks, never going under
+ * the number of buckets it was initialized (or reserved) with.  Pass 0 for min_load to never shrink.
+ * The defaults are 1.0 and 0.1 for the chained engine, 0.875 and 0.1 for the open engine, which can
+ * not go above 0.875.
+ *
+ * Resizing is incremental: the new table is allocated at once, but values are moved over in small
+ * batches on every insert and remove, so no single call pays for rehashing the whole table
+ *
+ * Returns 0 if successful, -1 if the load factors are out of range (min_load must be less than half
+ * of max_load)
+ */
+int ht_set_load_factors(hashtable* ht, float max_load, float min_load);
+
+/**
+ * Grows the given hashtable so that it can hold at least "count" values without resizing again, and
+ * keeps it from shrinking below that size.  Unlike automatic resizes this rehashes everything before
+ * returning, so it is best called on a new or small table
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int ht_reserve(hashtable* ht, int count);
+
 /**
  * Begin iterating through the given hashtable
  *
@@ -87,8 +221,66 @@ hashtable_iter* ht_iter_next(hashtable_iter* current);
 void* ht_value(hashtable_iter* iter);
 
 /**
- * The default hashing function - works great for strings.  This was taken from the venerable
- * Dragon Book and Algorithms With C and was created by P.J. Weinberger
+ * Begin iterating through the given hashtable using the given cursor, which the caller owns.  Unlike
+ * ht_iter_begin nothing is allocated, so it is fine to stop iterating at any point.  Empty buckets are
+ * skipped a word of the occupancy bitmap (chained) or a group of control bytes (open) at a time
+ * NOTE: The table must not be modified while iterating
+ *
+ * Returns 0 if the cursor is on the first value (ht_cursor_value), -1 if the table is empty
+ */
+int ht_cursor_begin(hashtable* ht, hashtable_cursor* cursor);
+
+/**
+ * Moves the given cursor to the next value in the hashtable
+ *
+ * Returns 0 if the cursor is on a value, -1 if we have reached the end of the table
+ */
+int ht_cursor_next(hashtable_cursor* cursor);
+
+/**
+ * Returns the value the given cursor is on
+ */
+#define ht_cursor_value(cursor) ((cursor)->value)
+
+/**
+ * Calls fn on every value in the hashtable, passing "arg" along.  Iteration stops early if fn returns
+ * nonzero
+ *
+ * Returns 0 if every value was visited, otherwise what fn returned when it stopped
+ */
+int ht_foreach(hashtable* ht, int (*fn)(void* data, void* arg), void* arg);
+
+/**
+ * Loops over every value in the hashtable, assigning each to "var" in turn.  "cur" must be a
+ * hashtable_cursor variable.  It is fine to break out of the loop
+ *
+ *   hashtable_cursor c;
+ *   char* str;
+ *   HT_FOREACH(ht, c, str) {
+ *       puts(str);
+ *   }
+ */
+#define HT_FOREACH(table, cur, var) \
+    for (ht_cursor_begin((table), &(cur)); !(cur).end && (((var) = (cur).value), 1); \
+         ht_cursor_next(&(cur)))
+
+/**
+ * The default hashing function.  A seeded 64-bit hash in the style of wyhash: keys are consumed 16 bytes
+ * per step (48 bytes, in three independent lanes, for longer keys) and every step is a full 64x64->128
+ * bit multiply, so similar keys end up with unrelated hashes.  Takes the length explicitly, so keys need
+ * not be NUL terminated
+ */
+uint64_t ht_hash_bytes(const void* data, size_t length, uint64_t seed);
+
+/**
+ * Hashes the given NUL terminated string with ht_hash_bytes
+ */
+uint64_t ht_hash_str(const char* key, uint64_t seed);
+
+/**
+ * The original default hashing function.  This was taken from the venerable Dragon Book and Algorithms
+ * With C and was created by P.J. Weinberger.  It is slow (one byte per step) and mixes poorly, prefer
+ * ht_hash_str
  *
  */
 int ht_hashpjw(const void* key);
@@ -0,0 +1,243 @@
+/**
+ * Type-specialized hashtables.  HT_DECLARE generates a table for one key type and one value type, with
+ * keys and values stored by value and the hash and equality functions called directly, so the compiler
+ * can inline them.  Use this instead of hashtable when the types are known and the table is hot
+ *
+ *   HT_DECLARE(counts, uint64_t, int, ht_gen_hash_u64, ht_gen_eq_u64)
+ *
+ *   counts c;
+ *   int* n;
+ *   counts_init(&c, 100);
+ *   counts_put(&c, 42, 1);
+ *   if ((n = counts_get(&c, 42)) != 0) {
+ *       (*n)++;
+ *   }
+ *   counts_destroy(&c);
+ *
+ * The tables use open addressing with linear probing and backward shift deletion, like HT_ENGINE_OPEN,
+ * but grow all at once (there is no incremental resize) and never shrink
+ */
+#ifndef HASHTABLE_GEN_H
+#define HASHTABLE_GEN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashtable.h"
+
+#define HT_GEN_MIN_SLOTS        16
+#define HT_GEN_MAX_LOAD(slots)  ((slots) - (slots) / 8)
+
+/* A slot's control byte is 0 if it is empty, otherwise the top 7 bits of the key's hash with the high
+   bit set.  Comparing it first means eq_fn is almost only ever called on the matching key */
+#define HT_GEN_TAG(hash)        ((unsigned char)(0x80 | ((uint32_t)(hash) >> 25)))
+
+/**
+ * Hash and equality functions for uint64_t keys
+ */
+static inline uint32_t ht_gen_hash_u64(uint64_t key)   {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+static inline int ht_gen_eq_u64(uint64_t key1, uint64_t key2)  {
+    return key1 == key2;
+}
+
+/**
+ * Hash and equality functions for NUL terminated string keys.  The table stores the pointer only, the
+ * caller keeps the string alive for as long as it is in the table.  Unlike hashtable's default hash
+ * this one is unseeded (ht_hash_str with a seed of 0), so colliding keys can be precomputed: don't use it
+ * for keys an attacker chooses
+ */
+static inline uint32_t ht_gen_hash_str(const char* key)    {
+    uint64_t hash = ht_hash_str(key, 0);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static inline int ht_gen_eq_str(const char* key1, const char* key2)    {
+    return key1 == key2 || !strcmp(key1, key2);
+}
+
+/**
+ * Declares the type "name" and the functions below for a hashtable mapping key_t to val_t.  hash_fn
+ * takes a key_t and returns an unsigned integer, eq_fn takes two key_t and returns nonzero if they are
+ * equal.  Both may be functions or macros
+ *
+ *   int name_init(name* t, int capacity)
+ *       Initializes an empty table with room for "capacity" values.  Returns 0 if successful, -1 otherwise
+ *   void name_destroy(name* t)
+ *       Frees the table's storage.  Keys and values are not touched
+ *   int name_put(name* t, key_t key, val_t val)
+ *       Returns 0 if the key was added, 1 if it was already there (its value is replaced), -1 on error
+ *   val_t* name_get(name* t, key_t key)
+ *       Returns a pointer to the key's value, valid until the next put or remove, or NULL
+ *   int name_remove(name* t, key_t key, val_t* val)
+ *       Removes the key, storing its value in "val" if it isn't NULL.  Returns 0 if found, -1 otherwise
+ *   int name_next(const name* t, int slot)
+ *       Returns the first occupied slot at or after "slot", or -1.  t->keys[slot] and t->vals[slot] hold
+ *       the entry, so a table is walked with for (i = name_next(t, 0); i >= 0; i = name_next(t, i + 1))
+ */
+#define HT_DECLARE(name, key_t, val_t, hash_fn, eq_fn)                                                    \
+                                                                                                          \
+typedef struct name##_tag   {                                                                             \
+    unsigned char*  ctrl;                                                                                 \
+    key_t*          keys;                                                                                 \
+    val_t*          vals;                                                                                 \
+    int             slots;      /* Always a power of 2 */                                                 \
+    int             size;                                                                                 \
+} name;                                                                                                   \
+                                                                                                          \
+static inline int name##_alloc(name* t, int slots)  {                                                     \
+    t->ctrl = (unsigned char*)calloc(slots, 1);                                                           \
+    t->keys = (key_t*)malloc(slots * sizeof(key_t));                                                      \
+    t->vals = (val_t*)malloc(slots * sizeof(val_t));                                                      \
+    if (!t->ctrl || !t->keys || !t->vals)   {                                                             \
+        free(t->ctrl);                                                                                    \
+        free(t->keys);                                                                                    \
+        free(t->vals);                                                                                    \
+        t->ctrl = 0;                                                                                      \
+        t->keys = 0;                                                                                      \
+        t->vals = 0;                                                                                      \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    t->slots = slots;                                                                                     \
+    t->size = 0;                                                                                          \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_init(name* t, int capacity)    {                                                 \
+    int slots = HT_GEN_MIN_SLOTS;                                                                         \
+                                                                                                          \
+    while (slots > 0 && HT_GEN_MAX_LOAD(slots) < capacity)  {                                             \
+        slots *= 2;                                                                                       \
+    }                                                                                                     \
+                                                                                                          \
+    memset(t, 0, sizeof(name));                                                                           \
+    return slots > 0? name##_alloc(t, slots) : -1;                                                        \
+}                                                                                                         \
+                                                                                                          \
+static inline void name##_destroy(name* t)  {                                                             \
+    free(t->ctrl);                                                                                        \
+    free(t->keys);                                                                                        \
+    free(t->vals);                                                                                        \
+    memset(t, 0, sizeof(name));                                                                           \
+}                                                                                                         \
+                                                                                                          \
+/* Returns the slot holding the key, or -1 - (the empty slot that ends its probe run) */                 \
+static inline int name##_probe(const name* t, key_t key, uint32_t hash) {                                 \
+    unsigned char tag = HT_GEN_TAG(hash);                                                                 \
+    int mask = t->slots - 1;                                                                              \
+    int slot = hash & mask;                                                                               \
+                                                                                                          \
+    while (t->ctrl[slot])   {                                                                             \
+        if (t->ctrl[slot] == tag && eq_fn(t->keys[slot], key))  {                                         \
+            return slot;                                                                                  \
+        }                                                                                                 \
+        slot = (slot + 1) & mask;                                                                         \
+    }                                                                                                     \
+                                                                                                          \
+    return -1 - slot;                                                                                     \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_grow(name* t)  {                                                                 \
+    name old = *t;                                                                                        \
+    int i, slot;                                                                                          \
+                                                                                                          \
+    if (t->slots >= (1 << 30) || name##_alloc(t, t->slots * 2) != 0)   {                                  \
+        *t = old;                                                                                         \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    for (i = 0; i < old.slots; i++) {                                                                     \
+        if (old.ctrl[i])    {                                                                             \
+            slot = hash_fn(old.keys[i]) & (t->slots - 1);                                                 \
+            while (t->ctrl[slot])   {                                                                     \
+                slot = (slot + 1) & (t->slots - 1);                                                       \
+            }                                                                                             \
+            t->ctrl[slot] = old.ctrl[i];                                                                  \
+            t->keys[slot] = old.keys[i];                                                                  \
+            t->vals[slot] = old.vals[i];                                                                  \
+        }                                                                                                 \
+    }                                                                                                     \
+                                                                                                          \
+    t->size = old.size;                                                                                   \
+    name##_destroy(&old);                                                                                 \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_put(name* t, key_t key, val_t val) {                                             \
+    uint32_t hash = hash_fn(key);                                                                         \
+    int slot = name##_probe(t, key, hash);                                                                \
+                                                                                                          \
+    if (slot >= 0)  {                                                                                     \
+        t->vals[slot] = val;                                                                              \
+        return 1;                                                                                         \
+    }                                                                                                     \
+                                                                                                          \
+    if (t->size >= HT_GEN_MAX_LOAD(t->slots))   {                                                         \
+        if (name##_grow(t) != 0)    {                                                                     \
+            return -1;                                                                                    \
+        }                                                                                                 \
+        slot = name##_probe(t, key, hash);                                                                \
+    }                                                                                                     \
+                                                                                                          \
+    slot = -1 - slot;                                                                                     \
+    t->ctrl[slot] = HT_GEN_TAG(hash);                                                                     \
+    t->keys[slot] = key;                                                                                  \
+    t->vals[slot] = val;                                                                                  \
+    t->size++;                                                                                            \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline val_t* name##_get(name* t, key_t key) {                                                     \
+    int slot = name##_probe(t, key, hash_fn(key));                                                        \
+    return slot >= 0? &t->vals[slot] : 0;                                                                 \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_remove(name* t, key_t key, val_t* val) {                                         \
+    int mask = t->slots - 1;                                                                              \
+    int slot = name##_probe(t, key, hash_fn(key));                                                        \
+    int next, home;                                                                                       \
+                                                                                                          \
+    if (slot < 0)   {                                                                                     \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    if (val)    {                                                                                         \
+        *val = t->vals[slot];                                                                             \
+    }                                                                                                     \
+                                                                                                          \
+    /* Shift later members of the probe run back unless their home lies in (slot, next] */               \
+    for (next = (slot + 1) & mask; t->ctrl[next]; next = (next + 1) & mask) {                             \
+        home = hash_fn(t->keys[next]) & mask;                                                             \
+        if (((next - home) & mask) >= ((next - slot) & mask))   {                                         \
+            t->ctrl[slot] = t->ctrl[next];                                                                \
+            t->keys[slot] = t->keys[next];                                                                \
+            t->vals[slot] = t->vals[next];                                                                \
+            slot = next;                                                                                  \
+        }                                                                                                 \
+    }                                                                                                     \
+                                                                                                          \
+    t->ctrl[slot] = 0;                                                                                    \
+    t->size--;                                                                                            \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_next(const name* t, int slot)  {                                                 \
+    for (; slot < t->slots; slot++) {                                                                     \
+        if (t->ctrl[slot])  {                                                                             \
+            return slot;                                                                                  \
+        }                                                                                                 \
+    }                                                                                                     \
+                                                                                                          \
+    return -1;                                                                                            \
+}
+
+#endif
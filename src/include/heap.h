@@ -0,0 +1,101 @@
+/**
+ * Priority queue, as a 4-ary heap in one contiguous array.  A 4-ary heap is half as deep as a binary
+ * one and a node's children share a cache line, so pushes and pops touch fewer lines
+ *
+ * The value that compares lowest comes out first.  Every push returns a handle that stays valid until
+ * the value is popped or removed, so a value's priority can be changed (or the value removed) in
+ * O(log n) without searching for it.  Handles are small integers and are reused once freed
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+/* Children per node */
+#define HEAP_ARITY          4
+
+typedef struct heap_entry_tag   {
+    void*   data;
+    int     handle;
+} heap_entry;
+
+typedef struct heap_tag {
+    int     (*compare)(const void* key1, const void* key2);
+    void    (*destroy)(void *data);
+
+    heap_entry* entries;
+    int         size;
+    int         capacity;
+
+    int*        positions;      /* By handle: where its value is in entries, or -2 - the next free handle */
+    int         handles;        /* Handles given out so far, free or not */
+    int         free_handle;    /* First free handle, or -1 */
+} heap;
+
+/**
+ * Initializes the given heap with room for "capacity" values to start with.  compare takes two values
+ * and returns less than, equal to or greater than 0 if the first should come out before, together with
+ * or after the second.  destroy is called on each value left when the heap is destroyed, and can be NULL
+ *
+ * Returns 0 if the heap was initialized successfully, -1 otherwise
+ */
+int heap_init(heap* h, int capacity, int (*compare)(const void* key1, const void* key2),
+    void (*destroy)(void *data));
+
+/**
+ * Destroys the given heap, calling the user-supplied "destroy" function on each value in it
+ */
+void heap_destroy(heap* h);
+
+/**
+ * Adds a value to the heap
+ *
+ * Returns the value's handle, or -1 if there was a problem
+ */
+int heap_push(heap* h, const void* data);
+
+/**
+ * Adds n values to an empty heap at once, in O(n).  The value data[i] gets handle i
+ *
+ * Returns 0 if successful, -1 if the heap wasn't empty or there was a problem
+ */
+int heap_heapify(heap* h, void* const* data, int n);
+
+/**
+ * Removes the value that comes out first and stores it in "data"
+ *
+ * Returns 0 if successful, -1 if the heap is empty
+ */
+int heap_pop(heap* h, void** data);
+
+/**
+ * Replaces the value with the given handle by "data", and moves it to where its new priority puts it.
+ * data may be the same value, after whatever it is compared on has changed (a decrease-key).  The old
+ * value is not destroyed
+ *
+ * Returns 0 if successful, -1 if the handle isn't in use
+ */
+int heap_update(heap* h, int handle, const void* data);
+
+/**
+ * Removes the value with the given handle and stores it in "data"
+ *
+ * Returns 0 if successful, -1 if the handle isn't in use
+ */
+int heap_remove(heap* h, int handle, void** data);
+
+/**
+ * Returns the value that comes out first, without removing it, or NULL if the heap is empty
+ */
+#define heap_peek(h) ((h)->size? (h)->entries[0].data : 0)
+
+/**
+ * Returns the value with the given handle, which must be in use
+ */
+#define heap_data(h, handle) ((h)->entries[(h)->positions[handle]].data)
+
+/**
+ * Returns the number of values in the heap
+ */
+#define heap_size(h) ((h)->size)
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * Intrusive doubly linked list.  Instead of the list allocating a node per value, the value embeds an
+ * ilist_node and the list links those together, so inserting never allocates and any node can be
+ * unlinked in O(1) without knowing the one before it.  ilist_entry gets back from a node to the struct
+ * it is embedded in:
+ *
+ *   typedef struct {
+ *       int         id;
+ *       ilist_node  link;
+ *   } job;
+ *
+ *   ilist queue;
+ *   ilist_node* n;
+ *   ilist_init(&queue);
+ *   ilist_push_back(&queue, &some_job->link);
+ *   ILIST_FOREACH(&queue, n) {
+ *       run(ilist_entry(n, job, link));
+ *   }
+ *   ilist_remove(&queue, &some_job->link);
+ *
+ * The list never owns its values, so there is nothing to destroy.  A value can be on as many lists at
+ * once as it has ilist_node members
+ */
+#ifndef ILIST_H
+#define ILIST_H
+
+#include <stddef.h>
+
+typedef struct ilist_node_tag   {
+    struct ilist_node_tag*  prev;
+    struct ilist_node_tag*  next;
+} ilist_node;
+
+/* The list is a ring through a sentinel node, so no operation has to check for the ends */
+typedef struct ilist_tag    {
+    ilist_node  head;
+    int         size;
+} ilist;
+
+/**
+ * Returns a pointer to the struct of the given type that "node" is the "member" field of
+ */
+#define ilist_entry(node, type, member) ((type*)((char*)(node) - offsetof(type, member)))
+
+/**
+ * Initializes the given list as empty
+ */
+static inline void ilist_init(ilist* l) {
+    l->head.prev = l->head.next = &l->head;
+    l->size = 0;
+}
+
+/**
+ * Links "node" into the list right after "pos", which is a node in the list or the list's head
+ */
+static inline void ilist_insert_after(ilist* l, ilist_node* pos, ilist_node* node)  {
+    node->prev = pos;
+    node->next = pos->next;
+    pos->next->prev = node;
+    pos->next = node;
+    l->size++;
+}
+
+/**
+ * Unlinks "node", which must be in the list
+ */
+static inline void ilist_remove(ilist* l, ilist_node* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = 0;
+    l->size--;
+}
+
+/**
+ * Adds "node" at the front or back of the list
+ */
+#define ilist_push_front(l, node) ilist_insert_after((l), &(l)->head, (node))
+#define ilist_push_back(l, node) ilist_insert_after((l), (l)->head.prev, (node))
+
+/**
+ * Moves "node", which must be in the list, to its front
+ */
+static inline void ilist_move_front(ilist* l, ilist_node* node) {
+    if (l->head.next != node)   {
+        ilist_remove(l, node);
+        ilist_push_front(l, node);
+    }
+}
+
+/**
+ * Returns the number of nodes in the list
+ */
+#define ilist_size(l) ((l)->size)
+
+/**
+ * Returns the first or last node of the list, or NULL if it is empty
+ */
+#define ilist_first(l) ((l)->size? (l)->head.next : 0)
+#define ilist_last(l) ((l)->size? (l)->head.prev : 0)
+
+/**
+ * Returns the node after or before "node", or NULL if it is the last or first one
+ */
+#define ilist_next(l, node) ((node)->next == &(l)->head? 0 : (node)->next)
+#define ilist_prev(l, node) ((node)->prev == &(l)->head? 0 : (node)->prev)
+
+/**
+ * Walks the list from front to back, with "node" set to each node in turn.  The current node must not
+ * be removed, see ILIST_FOREACH_SAFE
+ */
+#define ILIST_FOREACH(l, node) \
+    for ((node) = (l)->head.next; (node) != &(l)->head; (node) = (node)->next)
+
+/**
+ * Walks the list like ILIST_FOREACH, but allows the current node to be removed.  "tmp" is another
+ * ilist_node* that holds the next node
+ */
+#define ILIST_FOREACH_SAFE(l, node, tmp) \
+    for ((node) = (l)->head.next, (tmp) = (node)->next; (node) != &(l)->head; \
+         (node) = (tmp), (tmp) = (node)->next)
+
+#endif // ILIST_H
@@ -4,6 +4,11 @@
 #ifndef LIST_H
 #define LIST_H
 
+#include "pool.h"
+
+/* list_sort keeps one sorted run per power of 2 up to this, enough for any list an int can count */
+#define LIST_SORT_BINS  32
+
 typedef struct list_element_tag {
     void*                       data;
     struct list_element_tag*    next;
@@ -16,6 +21,8 @@ typedef struct list_tag {
     
     list_element* head;
     list_element* tail;
+    
+    pool* pool;                             /* Where elements come from, or NULL for malloc */
 } list;
 
 /**
@@ -25,6 +32,13 @@ typedef struct list_tag {
  */
 void list_init(list* l, void (*destroy)(void* data));
 
+/**
+ * Initializes the list pointed to by "l" like list_init, but with its elements drawn from the given pool
+ * instead of malloc.  The pool's objects must be at least sizeof(list_element), and it can be shared by
+ * any number of lists.  If the pool is destroyed, lists using it need not (and must not) be destroyed
+ */
+void list_init_pool(list* l, void (*destroy)(void* data), pool* p);
+
 /**
  * Destroys the entire list pointed to be "l"
  */
@@ -47,6 +61,15 @@ int list_insert_next(list* l, list_element* after, const void* data);
  */
 int list_remove_next(list *l, list_element* after, void **data);
 
+/**
+ * Sorts the list in place.  compare takes two values like a match function, and returns less than, equal
+ * to or greater than 0 if the first is less than, equal to or greater than the second.  The sort is
+ * stable and O(n log n), and only relinks elements, so it never allocates and elements stay valid
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int list_sort(list* l, int (*compare)(const void* key1, const void* key2));
+
 /**
  * Returns the number of elements in the list
  */
@@ -2,6 +2,8 @@
 #define PLATFORM_H
 
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /** 
  * Routines that may not be present or uniform across all platforms
@@ -37,4 +39,23 @@ int xp_vasprintf(char** ret, const char* format, va_list ap);
  */
 int xp_asprintf(char** ret, const char* format, ...);
 
+/**
+ * Writes length bytes of data to the file descriptor fd, carrying on after short writes and interrupted
+ * ones
+ *
+ * Returns the number of bytes written, less than length only if a write failed
+ *
+ * NOTE: Included because write and its header are POSIX, Windows has _write in io.h instead
+ */
+size_t xp_write(int fd, const void* data, size_t length);
+
+/**
+ * Returns 64 random bits suitable for seeding hash functions.  Uses the operating system's random source
+ * (BCryptGenRandom on Windows, /dev/urandom elsewhere) where there is one, falling back to mixing the
+ * time and some addresses otherwise.  This is NOT meant for cryptographic use
+ *
+ * NOTE: Included because there is no portable way to get an unpredictable value in C
+ */
+uint64_t xp_random_seed();
+
 #endif
\ No newline at end of file
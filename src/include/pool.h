@@ -0,0 +1,62 @@
+/**
+ * Fixed size object pool.  Objects are carved out of large slabs and recycled through a free list, so
+ * allocating and freeing one is a couple of pointer moves, and destroying the pool releases every object
+ * at once with one free per slab.  One pool can be shared by any number of lists and hashtables, as long
+ * as its objects are large enough for all of them (see list_init_pool and ht_set_pool)
+ * NOTE: Pools are not thread safe
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/* Objects in the first slab when pool_init is given 0 */
+#define POOL_DEFAULT_SLAB   64
+
+/* Later slabs double in size up to this many objects, so there are only ever a few of them */
+#define POOL_MAX_SLAB       65536
+
+typedef struct pool_slab_tag pool_slab;
+
+typedef struct pool_tag {
+    size_t      size;           /* Object size, rounded up to keep objects pointer aligned */
+    int         next_slab;      /* Objects in the next slab allocated */
+    int         used;           /* Objects handed out and not yet freed */
+
+    void*       free_list;      /* Freed objects, linked through their first word */
+    char*       bump;           /* Objects in the newest slab that were never handed out */
+    char*       bump_end;
+    pool_slab*  slabs;
+} pool;
+
+/**
+ * Initializes the given pool for objects of "size" bytes.  The first slab holds "per_slab" objects (or
+ * POOL_DEFAULT_SLAB if 0).  No memory is allocated until the first pool_alloc
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int pool_init(pool* p, size_t size, int per_slab);
+
+/**
+ * Frees every slab, and with them every object allocated from the pool whether or not it was freed.
+ * Takes one free per slab, never one per object
+ */
+void pool_destroy(pool* p);
+
+/**
+ * Returns a new object from the pool, or NULL if a slab couldn't be allocated
+ */
+void* pool_alloc(pool* p);
+
+/**
+ * Returns the given object, which must have come from this pool, to the pool
+ */
+void pool_free(pool* p, void* obj);
+
+/**
+ * Returns the number of objects allocated and not yet freed
+ */
+#define pool_used(p) ((p)->used)
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * Bounded lock-free queues of pointers, for handing work between threads without a lock or an
+ * allocation per message
+ *
+ * spsc_queue is a ring for exactly one producer thread and one consumer thread.  Every operation is
+ * wait-free: a push or a pop is a couple of loads and one release store, and each side keeps a cached
+ * copy of the other side's index so it only touches the other side's cache line when the ring looks
+ * full (or empty).
+ *
+ * mpmc_queue is Dmitry Vyukov's bounded queue, for any number of producers and consumers.  Each cell
+ * carries a sequence number saying whose turn it is, so producers and consumers only contend on the
+ * index they share with their own kind, through one compare and swap per operation (or per batch).
+ * It is lock-free but not wait-free
+ *
+ * The head and tail indices of both are on separate cache lines, so producers and consumers don't
+ * invalidate each other's lines on every operation
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define QUEUE_CACHE_LINE    64
+
+typedef struct spsc_queue_tag   {
+    _Alignas(QUEUE_CACHE_LINE) _Atomic size_t head;     /* Next slot to pop, written by the consumer */
+    size_t                  cached_tail;                /* The consumer's last look at tail */
+
+    _Alignas(QUEUE_CACHE_LINE) _Atomic size_t tail;     /* Next slot to push, written by the producer */
+    size_t                  cached_head;                /* The producer's last look at head */
+
+    _Alignas(QUEUE_CACHE_LINE) void** slots;
+    size_t                  mask;
+} spsc_queue;
+
+typedef struct mpmc_cell_tag    {
+    _Atomic size_t  seq;        /* The position that may use the cell next: pos to push, pos + 1 to pop */
+    void*           data;
+} mpmc_cell;
+
+typedef struct mpmc_queue_tag   {
+    _Alignas(QUEUE_CACHE_LINE) _Atomic size_t head;     /* Next position to pop */
+    _Alignas(QUEUE_CACHE_LINE) _Atomic size_t tail;     /* Next position to push */
+
+    _Alignas(QUEUE_CACHE_LINE) mpmc_cell* cells;
+    size_t                  mask;
+} mpmc_queue;
+
+/**
+ * Initializes the given queue with room for at least "capacity" values (rounded up to a power of 2)
+ * NOTE: Not thread safe, the queue must not be used until this returns
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int spsc_init(spsc_queue* q, size_t capacity);
+
+/**
+ * Frees the queue.  Values still in it are not touched
+ * NOTE: Not thread safe
+ */
+void spsc_destroy(spsc_queue* q);
+
+/**
+ * Adds a value.  Only one thread at a time may push
+ *
+ * Returns 0 if successful, -1 if the queue is full
+ */
+int spsc_push(spsc_queue* q, const void* data);
+
+/**
+ * Takes the oldest value and stores it in "data".  Only one thread at a time may pop
+ *
+ * Returns 0 if successful, -1 if the queue is empty
+ */
+int spsc_pop(spsc_queue* q, void** data);
+
+/**
+ * Adds up to n values from "data", in order, publishing them all at once
+ *
+ * Returns the number of values added, which is less than n if the queue filled up
+ */
+size_t spsc_push_batch(spsc_queue* q, void* const* data, size_t n);
+
+/**
+ * Takes up to n of the oldest values and stores them in "data", in order
+ *
+ * Returns the number of values taken
+ */
+size_t spsc_pop_batch(spsc_queue* q, void** data, size_t n);
+
+/**
+ * Initializes the given queue with room for at least "capacity" values (rounded up to a power of 2)
+ * NOTE: Not thread safe, the queue must not be used until this returns
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int mpmc_init(mpmc_queue* q, size_t capacity);
+
+/**
+ * Frees the queue.  Values still in it are not touched
+ * NOTE: Not thread safe
+ */
+void mpmc_destroy(mpmc_queue* q);
+
+/**
+ * Adds a value
+ *
+ * Returns 0 if successful, -1 if the queue is full
+ */
+int mpmc_push(mpmc_queue* q, const void* data);
+
+/**
+ * Takes the oldest value and stores it in "data"
+ *
+ * Returns 0 if successful, -1 if the queue is empty
+ */
+int mpmc_pop(mpmc_queue* q, void** data);
+
+/**
+ * Adds up to n values from "data", claiming their cells with one compare and swap.  Values from one
+ * batch are popped in order, but other producers' values may be popped between them
+ *
+ * Returns the number of values added, which is less than n if the queue filled up
+ */
+size_t mpmc_push_batch(mpmc_queue* q, void* const* data, size_t n);
+
+/**
+ * Takes up to n of the oldest values and stores them in "data", claiming their cells with one compare
+ * and swap
+ *
+ * Returns the number of values taken
+ */
+size_t mpmc_pop_batch(mpmc_queue* q, void** data, size_t n);
+
+#endif
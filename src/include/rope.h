@@ -0,0 +1,122 @@
+/**
+ * Rope - a segmented string builder.  Text is appended into a chain of fixed-size chunks, so growing it
+ * never reallocates or moves the bytes already written, and buffers the caller already has can be
+ * spliced in by reference without copying them at all.  The rope is written out with writev, one
+ * iovec per segment, and only flattened into one contiguous string when something needs a char*:
+ *
+ *   rope r;
+ *   rope_init(&r, 0);
+ *   rope_append_strf(&r, "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", body_length);
+ *   rope_append_ref(&r, body, body_length);             // body must live until the rope is written
+ *   rope_write(&r, client_fd);
+ *   rope_destroy(&r);
+ */
+
+#ifndef ROPE_H
+#define ROPE_H
+
+#include <stddef.h>
+#include <stdarg.h>
+
+/* Default payload bytes per chunk */
+#define ROPE_CHUNK_SIZE     4096
+
+/* Borrowed buffers up to this long are copied instead, since a segment of their own costs more */
+#define ROPE_COPY_MAX       64
+
+typedef struct rope_segment_tag {
+    struct rope_segment_tag*    next;
+    const char*                 data;       /* The chunk's own storage, or a borrowed buffer */
+    size_t                      length;
+    size_t                      capacity;   /* Size of storage, 0 for a borrowed buffer */
+    char                        storage[];
+} rope_segment;
+
+typedef struct rope_tag {
+    rope_segment*   head;
+    rope_segment*   tail;
+    size_t          length;
+    int             segments;
+    size_t          chunk_size;
+} rope;
+
+/**
+ * Initializes the given rope as empty, to allocate chunks of "chunk_size" bytes (or ROPE_CHUNK_SIZE if
+ * chunk_size is 0)
+ */
+void rope_init(rope* r, size_t chunk_size);
+
+/**
+ * Destroys the given rope, freeing its chunks.  Borrowed buffers are left alone
+ */
+void rope_destroy(rope* r);
+
+/**
+ * Empties the rope, freeing its chunks
+ */
+void rope_reset(rope* r);
+
+/**
+ * Appends "length" bytes from "data", copying them into the rope
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append(rope* r, const char* data, size_t length);
+
+/**
+ * Appends the given string, copying it into the rope
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append_str(rope* r, const char* src);
+
+/**
+ * Appends the formatted string, formatted straight into the rope's last chunk if it fits there or into a
+ * new chunk otherwise.  A formatted string is never split between chunks
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append_strf(rope* r, const char* fmt, ...);
+
+/**
+ * Appends the formatted string, like rope_append_strf but with a va_list
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append_vstrf(rope* r, const char* fmt, va_list ap);
+
+/**
+ * Appends "length" bytes from "data" by reference, without copying them.  The buffer must not change or
+ * be freed until the rope is done with (buffers up to ROPE_COPY_MAX bytes are copied, though)
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append_ref(rope* r, const char* data, size_t length);
+
+/**
+ * Writes the whole rope to the file descriptor "fd" with writev, carrying on after partial writes and
+ * interruptions.  The rope is left as it was
+ *
+ * Returns 0 if successful, -1 if a write failed
+ */
+int rope_write(const rope* r, int fd);
+
+/**
+ * Allocates and copies a new null terminated cstring of the rope's contents.  It is the caller's
+ * responsibility to free it
+ *
+ * Returns the string, or NULL if it couldn't be allocated
+ */
+char* rope_flatten(const rope* r);
+
+/**
+ * Returns the number of bytes in the rope
+ */
+#define rope_length(r) ((r)->length)
+
+/**
+ * Returns the number of segments (chunks and borrowed buffers) in the rope
+ */
+#define rope_segments(r) ((r)->segments)
+
+#endif
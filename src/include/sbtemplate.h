@@ -0,0 +1,97 @@
+/**
+ * Format templates - printf-style format strings compiled once, so appending them to a stringbuilder
+ * doesn't parse the format again each time.  A template is the format's literal text plus a typed slot
+ * for each conversion, and appending it copies the literals and converts the arguments straight into
+ * the builder, allocating nothing but the builder's own growth:
+ *
+ *   static sb_template access_log;
+ *   sb_template_compile(&access_log, "%s - [%s] \"%s %s\" %d %zu %.3f ms\n");
+ *   ...
+ *   sb_append_template(sb, &access_log, client, when, method, path, status, bytes, elapsed_ms);
+ *
+ * Only this subset of printf is supported, and sb_template_compile fails on anything else:
+ *
+ *   %d %i %u %x %X %c %s %f %%
+ *   flags '-' (left justify), '0' (pad numbers with zeros) and '+' (always show the sign)
+ *   a width given as digits (up to 9999), not '*'
+ *   a precision given as digits, for %s (most characters copied) and %f (digits after the point, 6 if
+ *   not given), not '*'
+ *   the length modifiers hh, h, l, ll, z, j and t on the integer conversions
+ *
+ * Output is the same as printf's for all of it.  %f values whose rounding is too close to call in double
+ * precision, or too big to round as a 64-bit integer, go through libc for that one conversion
+ */
+
+#ifndef SBTEMPLATE_H
+#define SBTEMPLATE_H
+
+#include <stdarg.h>
+
+#include "stringbuilder.h"
+
+/* Slot flags, from the conversion's printf flags */
+#define SB_SLOT_LEFT        0x1     /* '-' */
+#define SB_SLOT_ZERO        0x2     /* '0' */
+#define SB_SLOT_PLUS        0x4     /* '+' */
+
+/* Argument types, from the conversion's length modifier */
+typedef enum    {
+    SB_ARG_NONE = 0,        /* The trailing literal, with no conversion after it */
+    SB_ARG_INT,
+    SB_ARG_CHAR,            /* hh */
+    SB_ARG_SHORT,           /* h */
+    SB_ARG_LONG,            /* l */
+    SB_ARG_LONG_LONG,       /* ll */
+    SB_ARG_SIZE,            /* z */
+    SB_ARG_INTMAX,          /* j */
+    SB_ARG_PTRDIFF,         /* t */
+    SB_ARG_DOUBLE,
+    SB_ARG_STRING
+} sb_arg_type;
+
+typedef struct sb_template_slot_tag {
+    int         literal;            /* Offset of the literal text before the conversion in the template's text */
+    int         literal_length;
+    char        conversion;         /* 'd', 'u', 'x', 'X', 'c', 's' or 'f' ('i' is compiled to 'd') */
+    char        type;               /* An sb_arg_type */
+    char        flags;
+    int         width;
+    int         precision;          /* -1 if not given */
+} sb_template_slot;
+
+typedef struct sb_template_tag {
+    char*               text;       /* The literal segments, one after another, with "%%" as "%" */
+    sb_template_slot*   slots;      /* One per conversion, and one more for the trailing literal */
+    int                 count;
+} sb_template;
+
+/**
+ * Compiles the printf-style format string "fmt" into the given template.  The template keeps its own
+ * copy of the text, so fmt needn't outlive it
+ *
+ * Returns 0 if successful, -1 if fmt uses something outside the supported subset or out of memory
+ */
+int sb_template_compile(sb_template* t, const char* fmt);
+
+/**
+ * Destroys the given template, freeing its text and slots
+ */
+void sb_template_destroy(sb_template* t);
+
+/**
+ * Appends the template to the stringbuilder, converting the arguments as printf would convert them for
+ * the format it was compiled from
+ */
+void sb_append_template(stringbuilder* sb, const sb_template* t, ...);
+
+/**
+ * Appends the template to the stringbuilder, like sb_append_template but with a va_list
+ */
+void sb_append_vtemplate(stringbuilder* sb, const sb_template* t, va_list ap);
+
+/**
+ * Returns the number of arguments the template takes
+ */
+#define sb_template_args(t) ((t)->count - 1)
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * Sorting for arrays of pointers, like the values stored in list and hashtable.  The comparison takes
+ * two values the same way a match function does, and returns less than, equal to or greater than 0 if
+ * the first is less than, equal to or greater than the second.  Both sorts are stable
+ */
+
+#ifndef SORT_H
+#define SORT_H
+
+#include <stddef.h>
+
+#include "threadpool.h"
+
+/* Runs this short are insertion sorted before merging starts */
+#define SORT_ISORT_MAX      24
+
+/* Arrays shorter than this are sorted on the calling thread even when a pool is given */
+#define SORT_PARALLEL_MIN   16384
+
+/**
+ * Sorts the n values in "data" with a bottom-up merge sort, which needs n pointers of scratch space
+ *
+ * Returns 0 if successful, -1 if the scratch space couldn't be allocated
+ */
+int sort_merge(void** data, size_t n, int (*compare)(const void* key1, const void* key2));
+
+/**
+ * Sorts the n values in "data" with a parallel merge sort on the given pool (or on the calling thread
+ * if it is NULL).  Each of the pool's threads and the calling thread sort a slice of the array, then the
+ * slices are merged in rounds, with every merge split at the matching points of its two runs so each
+ * round keeps all the threads busy.  compare must be safe to call from several threads at once, and
+ * the pool should not be running anything else
+ *
+ * Returns 0 if successful, -1 if the scratch space couldn't be allocated
+ */
+int sort_parallel(void** data, size_t n, int (*compare)(const void* key1, const void* key2), threadpool* tp);
+
+#endif
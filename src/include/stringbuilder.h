@@ -1,11 +1,55 @@
 #ifndef STRINGBUILDER_H
 #define STRINGBUILDER_H
 
+#include <stdio.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+/* Flags for sb_new_with_flags and sb_init */
+#define SB_LAZY_NUL         0x1     /* Never zero-fill the buffer, only terminate it in sb_cstring */
+
+/* Set by sb_init, for storage the stringbuilder mustn't free */
+#define SB_STATIC_BUFFER    0x100   /* cstr is the inline buffer or the caller's, not from malloc */
+#define SB_STATIC_STRUCT    0x200   /* The struct itself is the caller's */
+
+/* Set by sb_bind_fd and sb_bind_file */
+#define SB_SINK             0x400   /* Flushes to sink_fd or sink_file when full, rather than growing */
+
+/* High-water mark for a sink bound without one */
+#define SB_SINK_SIZE        65536
+
+/* Bytes of string held in the struct itself, before a builder from sb_init needs the heap */
+#define SB_INLINE_SIZE      40
+
+/* The page size sb_grow_pages rounds to */
+#define SB_PAGE_SIZE        4096
+
+/**
+ * A growth policy, for when the buffer is full: given its current size and the size it must at least
+ * have now, returns the size to grow it to
+ */
+typedef size_t (*sb_growth_fn)(size_t size, size_t required);
+
+/* Performance metrics, recording what growing the buffer has cost */
+typedef struct sb_stats_tag {
+    int     reallocs;       /* Times the buffer was resized */
+    int     moves;          /* Resizes that left the string at a different address */
+    size_t  bytes_copied;   /* Bytes those moves carried over.  An upper bound, as realloc can move a huge
+                               buffer by remapping its pages without copying them */
+} sb_stats;
+
 typedef struct stringbuilder_tag    {
-    char* cstr;             /* Must be first member in the struct! */
-    int   pos;
-    int   size;
-    int   reallocs;         /* Performance metric to record the number of string reallocations */
+    char*           cstr;           /* Must be first member in the struct! */
+    size_t          pos;
+    size_t          size;
+    int             flags;
+    sb_growth_fn    growth;         /* NULL for sb_grow_double */
+    sb_stats        stats;
+    FILE*           sink_file;      /* Where a sink flushes to, or NULL for sink_fd */
+    int             sink_fd;
+    size_t          high_water;     /* A sink flushes before an append would take it past this many characters */
+    char            small[SB_INLINE_SIZE];
 } stringbuilder;
 
 /**
@@ -15,20 +59,120 @@ typedef struct stringbuilder_tag    {
 stringbuilder* sb_new();
 
 /**
- * Destroys the given stringbuilder.  Pass 1 to free_string if the underlying c string should also be freed
+ * Initializes a stringbuilder in storage the caller owns, such as a local variable or a member of
+ * another struct, so creating it doesn't touch the heap.  The string starts in "buffer" (of "size"
+ * bytes), or in the builder's own SB_INLINE_SIZE byte buffer if buffer is NULL, and only moves to the
+ * heap once it outgrows that.  flags are as for sb_new_with_flags.  The builder mustn't be copied, as
+ * cstr may point into it
+ *
+ *   stringbuilder sb;
+ *   sb_init(&sb, 0, 0, SB_LAZY_NUL);
+ *   sb_append_strf(&sb, "%s:%d", host, port);
+ *   connect_to(sb_cstring(&sb));
+ *   sb_destroy(&sb, 1);
+ */
+void sb_init(stringbuilder* sb, char* buffer, size_t size, int flags);
+
+/**
+ * Destroys the given stringbuilder.  Pass 1 to free_string if the underlying c string should also be freed.
+ * Only what the stringbuilder allocated is freed: not a struct or buffer passed to sb_init
  */
 void sb_destroy(stringbuilder* sb, int free_string);
 
 /**
  * Creates a new stringbuilder with initial size at least the given size
  */
-stringbuilder* sb_new_with_size(int size);
+stringbuilder* sb_new_with_size(size_t size);
+
+/**
+ * Creates a new stringbuilder with initial size at least the given size and the given SB_* flags.  By
+ * default the whole buffer is kept zero-filled, so cstr is always terminated and everything past pos
+ * is 0.  With SB_LAZY_NUL the buffer is never zero-filled (so sb_reset is O(1) however big the buffer
+ * has grown), and the string is only terminated when sb_cstring or sb_make_cstring is called
+ */
+stringbuilder* sb_new_with_flags(size_t size, int flags);
 
 /**
  * Resets the stringbuilder to empty
  */
 void sb_reset(stringbuilder* sb);
 
+/**
+ * Grows the buffer, if need be, so it holds a string of at least "length" characters without growing
+ * again.  It is resized to exactly that, whatever the growth policy
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_reserve(stringbuilder* sb, size_t length);
+
+/**
+ * Shrinks the buffer to just fit the current string and its terminator.  A buffer passed to sb_init is
+ * left as it is
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_shrink_to_fit(stringbuilder* sb);
+
+/**
+ * Growth policies.  sb_grow_double, the default, doubles the buffer until it is big enough.
+ * sb_grow_by_half grows it by half at a time instead, wasting less of a large buffer at the cost of more
+ * resizes.  sb_grow_pages grows it by half and rounds up to whole SB_PAGE_SIZE pages, for huge buffers:
+ * malloc gives those their own mappings, which realloc can then move by remapping rather than copying
+ */
+size_t sb_grow_double(size_t size, size_t required);
+size_t sb_grow_by_half(size_t size, size_t required);
+size_t sb_grow_pages(size_t size, size_t required);
+
+/**
+ * Sets the stringbuilder's growth policy, one of the sb_grow_* functions or the caller's own
+ */
+#define sb_set_growth(sb, fn) ((sb)->growth = (fn))
+
+/**
+ * Binds the stringbuilder to the file descriptor "fd" as a sink: from then on, whenever an append would
+ * take it past the high-water mark (or SB_SINK_SIZE if high_water is 0), what the builder holds is written
+ * to fd and the builder emptied first, so memory stays bounded at the mark whatever the output's length.
+ * The buffer only grows past it to hold a single append longer than that, and shrinks back to it once that
+ * has been flushed.  All the sb_append_* functions work as before, but sb_cstring only sees what hasn't
+ * been flushed yet.  Call sb_flush to write out the rest before destroying the builder.  If a write fails
+ * the builder keeps what it couldn't write, growing if it must, and tries again at the next flush
+ *
+ *   stringbuilder* sb = sb_new_with_flags(0, SB_LAZY_NUL);
+ *   sb_bind_fd(sb, out_fd, 0);
+ *   for (row = rows; row; row = row->next)   {
+ *       sb_append_strf(sb, "%s,%d,%.2f\n", row->name, row->count, row->mean);
+ *   }
+ *   sb_flush(sb);
+ *   sb_destroy(sb, 1);
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_bind_fd(stringbuilder* sb, int fd, size_t high_water);
+
+/**
+ * Binds the stringbuilder to "file" as a sink, like sb_bind_fd but writing with fwrite.  The FILE's
+ * own buffer isn't flushed
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_bind_file(stringbuilder* sb, FILE* file, size_t high_water);
+
+/**
+ * Writes what a sink holds to its file descriptor or FILE, and empties it.  Does nothing if the
+ * stringbuilder isn't a sink
+ *
+ * Returns 0 if successful, -1 if a write failed, leaving what wasn't written in the builder
+ */
+int sb_flush(stringbuilder* sb);
+
+/**
+ * Makes room for at least "length" more characters, growing the buffer (or flushing a sink) now, so
+ * that many can then be appended without either happening
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_make_room(stringbuilder* sb, size_t length);
+
 /**
  * Appends the given character to the string builder
  */
@@ -37,7 +181,7 @@ void sb_append_ch(stringbuilder* sb, const char ch);
 /**
  * Appends at most length of the given src string to the string buffer
  */
-void sb_append_strn(stringbuilder* sb, const char* src, int length);
+void sb_append_strn(stringbuilder* sb, const char* src, size_t length);
 
 /**
  * Appends the given src string to the string builder
@@ -45,18 +189,45 @@ void sb_append_strn(stringbuilder* sb, const char* src, int length);
 void sb_append_str(stringbuilder* sb, const char* src);
 
 /**
- * Appends the formatted string to the given string builder
+ * Appends the formatted string to the given string builder.  The string is formatted straight into the
+ * builder's spare room, which only grows (and the string is formatted again) when it doesn't fit
  */
 void sb_append_strf(stringbuilder* sb, const char* fmt, ...);
 
+/**
+ * Appends the formatted string to the given string builder, like sb_append_strf but with a va_list
+ */
+void sb_append_vstrf(stringbuilder* sb, const char* fmt, va_list ap);
+
+/**
+ * Appends the decimal digits of the given integer, with a '-' if it's negative.  These and the other
+ * numeric appenders write straight into the buffer, without going through printf
+ */
+void sb_append_i64(stringbuilder* sb, int64_t value);
+void sb_append_u64(stringbuilder* sb, uint64_t value);
+
+/**
+ * Appends value in lowercase hexadecimal, without a prefix, padded with zeros to at least min_digits
+ */
+void sb_append_hex(stringbuilder* sb, uint64_t value, int min_digits);
+
+/**
+ * Appends the shortest decimal string that reads back (with strtod) as exactly the same double, or in a
+ * small fraction of cases (where the shorter string lies right at the edge of what reads back) a
+ * longer one, of at most 17 significant digits.  Uses plain notation from 1e-6 up to 1e21 and exponent
+ * notation ("1.5e-7", "2e+21") outside that, like JavaScript.  NaN and infinities come out as "nan",
+ * "inf" and "-inf"
+ */
+void sb_append_double(stringbuilder* sb, double value);
+
 /**
  * Allocates and copies a new cstring based on the current stringbuilder contents 
  */
 char* sb_make_cstring(stringbuilder* sb);
 
 /**
- * Returns the stringbuilder as a regular C String
+ * Returns the stringbuilder as a regular C String, writing its terminator first
  */
-#define sb_cstring(sb) ((sb)->cstr)
+#define sb_cstring(sb) ((sb)->cstr[(sb)->pos] = '\0', (sb)->cstr)
                                                             
 #endif // STRINGBUILDER_H
@@ -0,0 +1,64 @@
+/**
+ * Fixed size thread pool.  Jobs are queued with threadpool_submit and run by the pool's threads in the
+ * order they were submitted.  threadpool_wait blocks until every queued job has finished, running queued
+ * jobs on the calling thread while it waits, so a pool of N threads runs jobs N + 1 at a time during a
+ * wait, and a pool of 0 threads runs everything inside threadpool_wait
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+
+typedef struct threadpool_job_tag   {
+    void    (*fn)(void* arg);
+    void*   arg;
+} threadpool_job;
+
+typedef struct threadpool_tag   {
+    pthread_t*      threads;
+    int             count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  work;           /* Signalled when a job is queued, or the pool is stopping */
+    pthread_cond_t  idle;           /* Signalled when a job is queued or the last running one finishes */
+
+    threadpool_job* jobs;           /* Ring of queued jobs */
+    int             capacity;
+    int             first;
+    int             queued;
+    int             running;
+    int             stop;
+} threadpool;
+
+/**
+ * Initializes the given pool and starts "threads" threads (which may be 0)
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int threadpool_init(threadpool* tp, int threads);
+
+/**
+ * Waits for every queued job to finish, then stops the threads and frees the pool
+ */
+void threadpool_destroy(threadpool* tp);
+
+/**
+ * Queues fn(arg) to be run by the pool.  Jobs may submit more jobs
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int threadpool_submit(threadpool* tp, void (*fn)(void* arg), void* arg);
+
+/**
+ * Runs queued jobs on the calling thread until the queue is empty, then waits for the pool's threads to
+ * finish the jobs they are running.  Must not be called from a job
+ */
+void threadpool_wait(threadpool* tp);
+
+/**
+ * Returns the number of threads in the pool
+ */
+#define threadpool_size(tp) ((tp)->count)
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * Hierarchical hashed timer wheel.  Timers are kept in TWHEEL_LEVELS wheels of TWHEEL_SLOTS slots each:
+ * the first has a slot per tick, and each slot of the next covers a whole turn of the one below.  As
+ * time reaches a slot of a coarser wheel, its timers are cascaded down into finer slots, so adding,
+ * cancelling and expiring a timer are all O(1) however many are pending, and a tick only touches the
+ * timers that are due (or cascaded) on it
+ *
+ * Timers are intrusive, like ilist: the caller embeds a tw_timer in its own struct and gets back to the
+ * struct with ilist_entry(node, type, member.link).  The wheel never allocates per timer
+ *
+ *   typedef struct {
+ *       int         fd;
+ *       tw_timer    timeout;
+ *   } connection;
+ *
+ *   static void expire(ilist* expired, void* arg)  {
+ *       ilist_node *n, *tmp;
+ *       ILIST_FOREACH_SAFE(expired, n, tmp) {
+ *           close_connection(ilist_entry(n, connection, timeout.link));
+ *       }
+ *   }
+ *
+ *   tw_init(&wheel, 1000000, now_ns);                        // 1 ms ticks, in nanoseconds
+ *   tw_add(&wheel, &conn->timeout, now_ns + 30000000000);   // 30 s from now
+ *   tw_cancel(&wheel, &conn->timeout);                      // the connection did something
+ *   tw_advance(&wheel, now_ns, expire, 0);                  // from the event loop
+ *
+ * Times are in whatever unit the caller likes, as long as it is the same everywhere
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+
+#include "ilist.h"
+
+#define TWHEEL_LEVELS       4
+#define TWHEEL_SLOT_BITS    8
+#define TWHEEL_SLOTS        (1 << TWHEEL_SLOT_BITS)
+
+/* Timers further off than this many ticks wait in the last wheel, and are cascaded back into it until
+   they come in range */
+#define TWHEEL_RANGE        ((uint64_t)1 << (TWHEEL_LEVELS * TWHEEL_SLOT_BITS))
+
+typedef struct tw_timer_tag {
+    ilist_node  link;
+    uint64_t    tick;       /* Tick it is due on */
+    ilist*      slot;       /* Slot it is waiting in, or NULL if it isn't pending */
+} tw_timer;
+
+typedef struct timerwheel_tag   {
+    ilist*      slots;      /* TWHEEL_LEVELS wheels of TWHEEL_SLOTS, finest first */
+    uint64_t    origin;     /* Time of tick 0 */
+    uint64_t    resolution; /* Time per tick */
+    uint64_t    tick;       /* Next tick to expire */
+    int         size;
+    int         near;       /* Timers in the first wheel */
+} timerwheel;
+
+/**
+ * Initializes the given wheel, with ticks "resolution" time units long starting at time "now"
+ *
+ * Returns 0 if the wheel was initialized successfully, -1 otherwise
+ */
+int tw_init(timerwheel* w, uint64_t resolution, uint64_t now);
+
+/**
+ * Destroys the given wheel.  Timers still pending are forgotten, and must be initialized again before
+ * they are used with another wheel
+ */
+void tw_destroy(timerwheel* w);
+
+/**
+ * Schedules the timer, which must not be pending, to expire at time "expires".  Timers expire on the
+ * first tick at or after their time, so never early and at most a tick late.  A time that has already
+ * passed expires on the next call to tw_advance
+ *
+ * Returns 0 if successful, -1 if the timer is already pending
+ */
+int tw_add(timerwheel* w, tw_timer* t, uint64_t expires);
+
+/**
+ * Unschedules the timer
+ *
+ * Returns 0 if successful, -1 if the timer wasn't pending
+ */
+int tw_cancel(timerwheel* w, tw_timer* t);
+
+/**
+ * Runs the wheel forward to time "now".  For each tick that has timers due, they are unscheduled and
+ * handed to "expire" as one list, oldest tick first.  expire may free the timers or add them again as
+ * it walks the list with ILIST_FOREACH_SAFE, and the list is discarded once it returns.  Timers added
+ * again for a time up to "now" expire within this same call
+ *
+ * Returns the number of timers expired
+ */
+int tw_advance(timerwheel* w, uint64_t now, void (*expire)(ilist* expired, void* arg), void* arg);
+
+/**
+ * Initializes a timer as not pending, before its first tw_add
+ */
+#define tw_timer_init(t) ((t)->slot = 0)
+
+/**
+ * Returns nonzero if the timer is scheduled and hasn't expired yet
+ */
+#define tw_pending(t) ((t)->slot != 0)
+
+/**
+ * Returns the number of pending timers
+ */
+#define tw_size(w) ((w)->size)
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * Unrolled list.  Instead of one heap node per value, values are stored ULIST_CHUNK_SLOTS at a time in
+ * chunks that are exactly one ULIST_CHUNK_BYTES aligned block, so walking the list touches one chunk (four
+ * cache lines) per ULIST_CHUNK_SLOTS values instead of chasing a pointer per value.  Use it instead of list
+ * for long lists that are mostly appended to and walked from front to back
+ *
+ * Elements are pointers to the slots holding the values, and are walked like list elements:
+ *
+ *   void** e;
+ *   for (e = ulist_head(&l); e; e = ulist_next(e)) {
+ *       use(ulist_data(e));
+ *   }
+ *
+ * Appending or prepending never moves other values, so elements stay valid until their value is removed
+ */
+#ifndef ULIST_H
+#define ULIST_H
+
+#include <stdint.h>
+
+/* Chunks are this size and aligned to it, so the chunk holding a slot is found by masking its address.
+   Smaller chunks leave the walk waiting on the load of each next chunk */
+#define ULIST_CHUNK_BYTES   256
+
+#define ULIST_CHUNK_SLOTS   ((ULIST_CHUNK_BYTES - sizeof(void*) - 2 * sizeof(unsigned int)) / sizeof(void*))
+
+typedef struct ulist_chunk_tag  {
+    struct ulist_chunk_tag*     next;
+    unsigned int                first;      /* Slots first to end - 1 are in use */
+    unsigned int                end;
+
+    void*                       items[ULIST_CHUNK_SLOTS];
+} ulist_chunk;
+
+typedef struct ulist_tag    {
+    int size;
+
+    void (*destroy)(void *data);
+
+    ulist_chunk* head;
+    ulist_chunk* tail;
+} ulist;
+
+/**
+ * Initializes the unrolled list pointed to by "l".  destroy is called on each value when the list is
+ * destroyed, and can be NULL
+ */
+void ulist_init(ulist* l, void (*destroy)(void* data));
+
+/**
+ * Destroys the entire list pointed to by "l", calling destroy on each value
+ */
+void ulist_destroy(ulist* l);
+
+/**
+ * Adds data at the end of the list
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int ulist_append(ulist* l, const void* data);
+
+/**
+ * Adds data at the front of the list
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int ulist_prepend(ulist* l, const void* data);
+
+/**
+ * Removes the first value in the list and stores it in "data".  list->destroy will NOT be called on it
+ *
+ * Returns 0 if successful, -1 if the list is empty
+ */
+int ulist_remove_head(ulist* l, void** data);
+
+/**
+ * Returns the chunk the given element is in
+ */
+#define ulist_chunk_of(element) ((ulist_chunk*)((uintptr_t)(element) & ~(uintptr_t)(ULIST_CHUNK_BYTES - 1)))
+
+/**
+ * Returns the element after the given one, or NULL if it is the last one
+ */
+static inline void** ulist_next(void** element)    {
+    ulist_chunk* c = ulist_chunk_of(element);
+
+    if (++element < c->items + c->end)  {
+        return element;
+    }
+
+    return c->next? c->next->items + c->next->first : 0;
+}
+
+/**
+ * Returns the number of values in the list
+ */
+#define ulist_size(l) ((l)->size)
+
+/**
+ * Returns the head element of a list, or NULL if it is empty
+ */
+#define ulist_head(l) ((l)->head? (l)->head->items + (l)->head->first : 0)
+
+/**
+ * Returns the tail (last) element of a list, or NULL if it is empty
+ */
+#define ulist_tail(l) ((l)->tail? (l)->tail->items + (l)->tail->end - 1 : 0)
+
+/**
+ * Returns the value in the given element
+ */
+#define ulist_data(element) (*(element))
+
+#endif // ULIST_H
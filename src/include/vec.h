@@ -0,0 +1,322 @@
+/**
+ * Growable arrays.  VEC_DECLARE generates a contiguous array of one element type, stored by value, that
+ * grows geometrically so appending is amortized O(1).  Use it instead of list for ordered collections
+ * that are mostly appended to and walked or searched, where a list costs a pointer chase per element
+ *
+ *   VEC_DECLARE(ints, int, vec_cmp_num)
+ *
+ *   ints v;
+ *   size_t i;
+ *   ints_init(&v, 0);
+ *   ints_push(&v, 42);
+ *   ints_push(&v, 7);
+ *   ints_sort(&v);
+ *   for (i = 0; i < vec_size(&v); i++) {
+ *       printf("%d\n", v.data[i]);
+ *   }
+ *   ints_destroy(&v);
+ *
+ * Pointers into data are invalidated by anything that can grow or shrink the array
+ */
+#ifndef VEC_H
+#define VEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The first allocation holds at least this many elements */
+#define VEC_MIN_CAPACITY    8
+
+/* Sorts fall back to insertion sort for runs this short */
+#define VEC_ISORT_MAX       16
+
+/**
+ * Comparison functions for numbers (of any type) and NUL terminated strings.  Return less than, equal
+ * to or greater than 0 if the first value is less than, equal to or greater than the second
+ */
+#define vec_cmp_num(a, b) (((a) > (b)) - ((a) < (b)))
+#define vec_cmp_str(a, b) strcmp((a), (b))
+
+/**
+ * Returns the number of elements in the array
+ */
+#define vec_size(v) ((v)->size)
+
+/**
+ * Returns the number of elements the array can hold before it has to grow
+ */
+#define vec_capacity(v) ((v)->capacity)
+
+/**
+ * Declares the type "name" and the functions below for an array of type_t.  cmp_fn takes two type_t and
+ * returns less than, equal to or greater than 0, and may be a function or a macro.  It is only used by
+ * the sort and search functions
+ *
+ *   int name_init(name* v, size_t capacity)
+ *       Initializes an empty array with room for "capacity" elements.  Returns 0 if successful, -1 otherwise
+ *   void name_destroy(name* v)
+ *       Frees the array's storage.  Elements are not touched
+ *   int name_reserve(name* v, size_t capacity)
+ *       Makes room for at least "capacity" elements.  Returns 0 if successful, -1 otherwise
+ *   int name_shrink_to_fit(name* v)
+ *       Frees the room beyond the current size.  Returns 0 if successful, -1 otherwise
+ *   int name_push(name* v, type_t val)
+ *       Adds val at the end.  Returns 0 if successful, -1 otherwise
+ *   int name_pop(name* v, type_t* val)
+ *       Removes the last element, storing it in "val" if it isn't NULL.  Returns 0 if successful, -1 if empty
+ *   int name_append(name* v, const type_t* src, size_t n)
+ *       Adds the n elements at src at the end.  Returns 0 if successful, -1 otherwise
+ *   int name_insert(name* v, size_t index, const type_t* src, size_t n)
+ *       Inserts the n elements at src before element "index" (which may be the size).  src must not point
+ *       into the array.  Returns 0 if successful, -1 otherwise
+ *   int name_erase(name* v, size_t index, size_t n)
+ *       Removes n elements starting at "index".  Returns 0 if successful, -1 if they aren't all in the array
+ *   void name_sort(name* v)
+ *       Sorts the array in place in O(n log n), not stably
+ *   size_t name_lower_bound(const name* v, type_t key)
+ *       Returns the index of the first element not less than key in a sorted array, or the size if none is
+ *   type_t* name_search(name* v, type_t key)
+ *       Returns a pointer to an element equal to key in a sorted array, or NULL
+ */
+#define VEC_DECLARE(name, type_t, cmp_fn)                                                                 \
+                                                                                                          \
+typedef struct name##_tag   {                                                                             \
+    type_t*     data;                                                                                     \
+    size_t      size;                                                                                     \
+    size_t      capacity;                                                                                 \
+} name;                                                                                                   \
+                                                                                                          \
+static inline int name##_reserve(name* v, size_t capacity)  {                                             \
+    type_t* data;                                                                                         \
+                                                                                                          \
+    if (capacity <= v->capacity)    {                                                                     \
+        return 0;                                                                                         \
+    }                                                                                                     \
+                                                                                                          \
+    if (capacity > SIZE_MAX / sizeof(type_t) ||                                                           \
+        (data = (type_t*)realloc(v->data, capacity * sizeof(type_t))) == 0)    {                          \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    v->data = data;                                                                                       \
+    v->capacity = capacity;                                                                               \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+/* Makes room for "extra" more elements, at least doubling the capacity when it has to grow */            \
+static inline int name##_grow(name* v, size_t extra)    {                                                 \
+    size_t capacity = v->capacity < VEC_MIN_CAPACITY / 2? VEC_MIN_CAPACITY : v->capacity * 2;             \
+                                                                                                          \
+    if (extra > SIZE_MAX - v->size) {                                                                     \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    if (v->size + extra <= v->capacity) {                                                                 \
+        return 0;                                                                                         \
+    }                                                                                                     \
+                                                                                                          \
+    return name##_reserve(v, capacity > v->size + extra? capacity : v->size + extra);                     \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_init(name* v, size_t capacity) {                                                 \
+    memset(v, 0, sizeof(name));                                                                           \
+    return name##_reserve(v, capacity);                                                                   \
+}                                                                                                         \
+                                                                                                          \
+static inline void name##_destroy(name* v)  {                                                             \
+    free(v->data);                                                                                        \
+    memset(v, 0, sizeof(name));                                                                           \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_shrink_to_fit(name* v) {                                                         \
+    type_t* data;                                                                                         \
+                                                                                                          \
+    if (v->size == 0)   {                                                                                 \
+        free(v->data);                                                                                    \
+        v->data = 0;                                                                                      \
+        v->capacity = 0;                                                                                  \
+    } else if (v->size < v->capacity)   {                                                                 \
+        if ((data = (type_t*)realloc(v->data, v->size * sizeof(type_t))) == 0)  {                         \
+            return -1;                                                                                    \
+        }                                                                                                 \
+        v->data = data;                                                                                   \
+        v->capacity = v->size;                                                                            \
+    }                                                                                                     \
+                                                                                                          \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_push(name* v, type_t val)  {                                                     \
+    if (v->size == v->capacity && name##_grow(v, 1) != 0)   {                                             \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    v->data[v->size++] = val;                                                                             \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_pop(name* v, type_t* val)  {                                                     \
+    if (v->size == 0)   {                                                                                 \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    v->size--;                                                                                            \
+    if (val)    {                                                                                         \
+        *val = v->data[v->size];                                                                          \
+    }                                                                                                     \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_insert(name* v, size_t index, const type_t* src, size_t n) {                     \
+    if (index > v->size || name##_grow(v, n) != 0)  {                                                     \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    if (n)  {                                                                                             \
+        memmove(v->data + index + n, v->data + index, (v->size - index) * sizeof(type_t));                \
+        memcpy(v->data + index, src, n * sizeof(type_t));                                                 \
+        v->size += n;                                                                                     \
+    }                                                                                                     \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_append(name* v, const type_t* src, size_t n)   {                                 \
+    return name##_insert(v, v->size, src, n);                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline int name##_erase(name* v, size_t index, size_t n) {                                         \
+    if (index > v->size || n > v->size - index) {                                                         \
+        return -1;                                                                                        \
+    }                                                                                                     \
+                                                                                                          \
+    memmove(v->data + index, v->data + index + n, (v->size - index - n) * sizeof(type_t));                \
+    v->size -= n;                                                                                         \
+    return 0;                                                                                             \
+}                                                                                                         \
+                                                                                                          \
+static inline void name##_isort(type_t* a, size_t n)    {                                                 \
+    size_t i, j;                                                                                          \
+    type_t t;                                                                                             \
+                                                                                                          \
+    for (i = 1; i < n; i++) {                                                                             \
+        t = a[i];                                                                                         \
+        for (j = i; j > 0 && cmp_fn(t, a[j - 1]) < 0; j--)  {                                             \
+            a[j] = a[j - 1];                                                                              \
+        }                                                                                                 \
+        a[j] = t;                                                                                         \
+    }                                                                                                     \
+}                                                                                                         \
+                                                                                                          \
+static inline void name##_sift(type_t* a, size_t root, size_t n)    {                                     \
+    type_t t = a[root];                                                                                   \
+    size_t child;                                                                                         \
+                                                                                                          \
+    while ((child = 2 * root + 1) < n)  {                                                                 \
+        if (child + 1 < n && cmp_fn(a[child], a[child + 1]) < 0)    {                                     \
+            child++;                                                                                      \
+        }                                                                                                 \
+        if (cmp_fn(t, a[child]) >= 0)   {                                                                 \
+            break;                                                                                        \
+        }                                                                                                 \
+        a[root] = a[child];                                                                               \
+        root = child;                                                                                     \
+    }                                                                                                     \
+    a[root] = t;                                                                                          \
+}                                                                                                         \
+                                                                                                          \
+/* Quicksort with a median of three pivot, handing a range over to heapsort once it has been split        \
+   "depth" times, so no input can make it quadratic */                                                    \
+static inline void name##_qsort(type_t* a, size_t n, int depth) {                                         \
+    size_t i, j;                                                                                          \
+    type_t pivot;                                                                                         \
+    type_t t;                                                                                             \
+                                                                                                          \
+    while (n > VEC_ISORT_MAX)   {                                                                         \
+        if (depth-- == 0)   {                                                                             \
+            for (i = n / 2; i-- > 0;)   {                                                                 \
+                name##_sift(a, i, n);                                                                     \
+            }                                                                                             \
+            for (i = n; i-- > 1;)   {                                                                     \
+                t = a[0]; a[0] = a[i]; a[i] = t;                                                          \
+                name##_sift(a, 0, i);                                                                     \
+            }                                                                                             \
+            return;                                                                                       \
+        }                                                                                                 \
+                                                                                                          \
+        i = n / 2;                                                                                        \
+        if (cmp_fn(a[i], a[0]) < 0) {                                                                     \
+            t = a[i]; a[i] = a[0]; a[0] = t;                                                              \
+        }                                                                                                 \
+        if (cmp_fn(a[n - 1], a[i]) < 0) {                                                                 \
+            t = a[i]; a[i] = a[n - 1]; a[n - 1] = t;                                                      \
+            if (cmp_fn(a[i], a[0]) < 0) {                                                                 \
+                t = a[i]; a[i] = a[0]; a[0] = t;                                                          \
+            }                                                                                             \
+        }                                                                                                 \
+                                                                                                          \
+        /* Hoare partition: a[0..j] <= pivot <= a[j + 1..n - 1], and neither side is empty */             \
+        pivot = a[i];                                                                                     \
+        i = 0;                                                                                            \
+        j = n - 1;                                                                                        \
+        for (;;)    {                                                                                     \
+            while (cmp_fn(a[i], pivot) < 0) {                                                             \
+                i++;                                                                                      \
+            }                                                                                             \
+            while (cmp_fn(pivot, a[j]) < 0) {                                                             \
+                j--;                                                                                      \
+            }                                                                                             \
+            if (i >= j) {                                                                                 \
+                break;                                                                                    \
+            }                                                                                             \
+            t = a[i]; a[i] = a[j]; a[j] = t;                                                              \
+            i++;                                                                                          \
+            j--;                                                                                          \
+        }                                                                                                 \
+                                                                                                          \
+        /* Recurse into the smaller side, so the stack stays O(log n) deep */                             \
+        j++;                                                                                              \
+        if (j < n - j)  {                                                                                 \
+            name##_qsort(a, j, depth);                                                                    \
+            a += j;                                                                                       \
+            n -= j;                                                                                       \
+        } else {                                                                                          \
+            name##_qsort(a + j, n - j, depth);                                                            \
+            n = j;                                                                                        \
+        }                                                                                                 \
+    }                                                                                                     \
+                                                                                                          \
+    name##_isort(a, n);                                                                                   \
+}                                                                                                         \
+                                                                                                          \
+static inline void name##_sort(name* v) {                                                                 \
+    size_t n;                                                                                             \
+    int depth = 0;                                                                                        \
+                                                                                                          \
+    for (n = v->size; n > 1; n >>= 1)   {                                                                 \
+        depth += 2;                                                                                       \
+    }                                                                                                     \
+    name##_qsort(v->data, v->size, depth);                                                                \
+}                                                                                                         \
+                                                                                                          \
+static inline size_t name##_lower_bound(const name* v, type_t key)  {                                     \
+    size_t lo = 0, hi = v->size, mid;                                                                     \
+                                                                                                          \
+    while (lo < hi) {                                                                                     \
+        mid = lo + (hi - lo) / 2;                                                                         \
+        if (cmp_fn(v->data[mid], key) < 0)  {                                                             \
+            lo = mid + 1;                                                                                 \
+        } else {                                                                                          \
+            hi = mid;                                                                                     \
+        }                                                                                                 \
+    }                                                                                                     \
+    return lo;                                                                                            \
+}                                                                                                         \
+                                                                                                          \
+static inline type_t* name##_search(name* v, type_t key)    {                                             \
+    size_t i = name##_lower_bound(v, key);                                                                \
+    return i < v->size && cmp_fn(v->data[i], key) == 0? &v->data[i] : 0;                                  \
+}
+
+#endif // VEC_H
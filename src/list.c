@@ -18,6 +18,15 @@ void list_init(list* l, void (*destroy)(void* data))    {
     
     l->head = 0;
     l->tail = 0;
+    l->pool = 0;
+}
+
+/**
+ * Initializes the list pointed to by "l", with its elements drawn from the given pool
+ */
+void list_init_pool(list* l, void (*destroy)(void* data), pool* p)  {
+    list_init(l, destroy);
+    l->pool = p;
 }
 
 /**
@@ -45,7 +54,11 @@ void list_destroy(list* l)  {
 int list_insert_next(list* l, list_element* after, const void* data)    {
     list_element* new;
     
-    new = (list_element*)malloc(sizeof(list_element));
+    new = (list_element*)(l->pool? pool_alloc(l->pool) : malloc(sizeof(list_element)));
+    if (!new)   {
+        return -1;
+    }
+    
     new->data = (void*)data;
     
     if (after == 0) {
@@ -105,8 +118,91 @@ int list_remove_next(list *l, list_element* after, void **data) {
         }
     }
     
-    free(old);
+    if (l->pool)    {
+        pool_free(l->pool, old);
+    } else {
+        free(old);
+    }
     
     l->size--;
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * Merges the sorted, NULL terminated chains a and b, with ties going to a.  Stores the last element of
+ * the result in "tail"
+ *
+ * Returns the first element of the result
+ */
+static list_element* _merge(list_element* a, list_element* b, int (*compare)(const void* key1, const void* key2),
+    list_element** tail)  {
+    list_element head, *t = &head;
+
+    while (a && b) {
+        if (compare(b->data, a->data) < 0)  {
+            t->next = b;
+            b = b->next;
+        } else {
+            t->next = a;
+            a = a->next;
+        }
+        t = t->next;
+    }
+
+    t->next = a? a : b;
+    while (t->next) {
+        t = t->next;
+    }
+
+    *tail = t;
+    return head.next;
+}
+
+/**
+ * Sorts the list in place with a stable merge sort.  Elements are relinked, never allocated or copied
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int list_sort(list* l, int (*compare)(const void* key1, const void* key2))  {
+    list_element *bins[LIST_SORT_BINS], *carry, *next, *tail;
+    int i, top;
+
+    if (!compare)   {
+        return -1;
+    }
+
+    if (list_size(l) < 2)   {
+        return 0;
+    }
+
+    // Set by every merge, and there is always at least one with two or more elements
+    tail = 0;
+
+    // bins[i] is empty or a sorted run of 2^i elements, all from earlier in the list than bins[i - 1]
+    top = 0;
+    for (carry = l->head; carry; carry = next)  {
+        next = carry->next;
+        carry->next = 0;
+
+        for (i = 0; i < top && bins[i]; i++)    {
+            carry = _merge(bins[i], carry, compare, &tail);
+            bins[i] = 0;
+        }
+
+        bins[i] = carry;
+        if (i == top)   {
+            top++;
+        }
+    }
+
+    carry = 0;
+    for (i = 0; i < top; i++)   {
+        if (bins[i])    {
+            carry = _merge(bins[i], carry, compare, &tail);
+        }
+    }
+
+    l->head = carry;
+    l->tail = tail;
+    return 0;
+}
@@ -44,6 +44,7 @@ typedef struct _option_tag {
 typedef struct _option_wrapper_tag  {
     char* key;
     int alias;                  /* Only one of the wrappers "owns" the option and can clean it up */
+    hashtable* options;         /* The dictionary it is keyed in, for the dictionary's hash seed */
     
     _option* o;
 } _option_wrapper;
@@ -62,7 +63,9 @@ struct optin_tag    {
  * The hash function we will use for the option dictionary
  */
 static int _option_wrapper_hash(const void* key)  {
-    return ht_hashpjw(((_option_wrapper*)key)->key);
+    _option_wrapper* w = (_option_wrapper*)key;
+
+    return (int)ht_hash_str(w->key, w->options->seed);
 }
 
 /**
@@ -102,6 +105,7 @@ static _option* _query(hashtable* options, const char* name)    {
     query_wrapper = (_option_wrapper*)malloc(sizeof(_option_wrapper));
     memset(query_wrapper, 0, sizeof(_option_wrapper));
     query_wrapper->key = (char*)name;
+    query_wrapper->options = options;
 
     wrapper = query_wrapper;
 
@@ -149,6 +153,7 @@ void _set_shortname(hashtable* options, const char* name, char shortname)    {
     wrapper = (_option_wrapper*)malloc(sizeof(_option_wrapper));
     wrapper->key = str_shortname;
     wrapper->alias = 1;             /* We don't own the option */
+    wrapper->options = options;
     query_wrapper = wrapper;
     if (ht_lookup(options, (void*)&wrapper) != 0)    {
         /* It's not in there, just add it */
@@ -183,6 +188,7 @@ static _option* _query_or_new(hashtable* options, const char* name)   {
         memset(option_wrapper, 0, sizeof(_option_wrapper));
         option_wrapper->key = xp_strdup(name);
         option_wrapper->alias = 0;              /* We own the option */
+        option_wrapper->options = options;
         option_wrapper->o = option;
         ht_insert(options, (void*)option_wrapper);
         
@@ -538,7 +544,7 @@ int optin_process(optin* o, int* argc, char** argv) {
     char* arg, *opt, *value;
     _option* option;
     _option_wrapper* wrapper;
-    hashtable_iter* opt_iter;
+    hashtable_cursor opt_cursor;
     
     enum { STATE_NORMAL, STATE_IN_OPTION} state;
     
@@ -638,10 +644,7 @@ int optin_process(optin* o, int* argc, char** argv) {
     }
 done:
     /* Analyze required options */
-    opt_iter = ht_iter_begin(o->options);
-    while (opt_iter)    {
-        
-        wrapper = ht_value(opt_iter);
+    HT_FOREACH(o->options, opt_cursor, wrapper)  {
         
         /* Only consider the real options, ignore aliases so we don't check the same option twice */
         if (wrapper && !wrapper->alias)   {
@@ -652,8 +655,6 @@ done:
                 break;
             }
         }
-        
-        opt_iter = ht_iter_next(opt_iter);
     }
     
     /* Reorder any args after the options in the caller's argv array */
@@ -2,8 +2,20 @@
  * Cross platform versions of functions that are not available or inconsistent on some platforms
  */
  
+ #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
+ #include <time.h>
+ 
+ #ifdef _WIN32
+ #include <windows.h>
+ #include <bcrypt.h>
+ #include <io.h>
+ #else
+ #include <errno.h>
+ #include <unistd.h>
+ #endif
+ 
  #include "platform.h"
  
  /**
@@ -35,9 +47,13 @@
  int xp_vasprintf(char** ret, const char* format, va_list ap)   {
      char* str;
      int length;
+     va_list ap2;
      
-      // First determine the length by doing a "fake printf"
-      length = xp_vsnprintf(0, 0, format, ap);
+      // First determine the length by doing a "fake printf".  The va_list is consumed by each pass, so
+      // the counting pass works on a copy
+      va_copy(ap2, ap);
+      length = xp_vsnprintf(0, 0, format, ap2);
+      va_end(ap2);
       
       if (length <= 0)    {
           // Could not determine the space needed for the string
@@ -71,4 +87,70 @@
      va_end(arglist);
      
      return retval;
+ }
+ 
+ /**
+  * Writes length bytes of data to fd, carrying on after short and interrupted writes
+  *
+  * NOTE: Included because write is POSIX, and Windows' _write takes an unsigned int length
+  */
+ size_t xp_write(int fd, const void* data, size_t length)  {
+     size_t written = 0;
+ #ifdef _WIN32
+     unsigned int chunk;
+     int n;
+     
+     while (written < length)    {
+         chunk = length - written > 0x40000000? 0x40000000 : (unsigned int)(length - written);
+         if ((n = _write(fd, (const char*)data + written, chunk)) <= 0)   {
+             break;
+         }
+         written += n;
+     }
+ #else
+     ssize_t n;
+     
+     while (written < length)    {
+         if ((n = write(fd, (const char*)data + written, length - written)) <= 0)   {
+             if (n < 0 && errno == EINTR)    {
+                 continue;
+             }
+             break;
+         }
+         written += n;
+     }
+ #endif
+     
+     return written;
+ }
+ 
+ /**
+  * Returns 64 random bits suitable for seeding hash functions
+  *
+  * NOTE: Included because there is no portable way to get an unpredictable value in C
+  */
+ uint64_t xp_random_seed()  {
+     uint64_t seed;
+ #ifdef _WIN32
+     if (BCryptGenRandom(NULL, (PUCHAR)&seed, sizeof(seed), BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0)    {
+         return seed;
+     }
+ #else
+     FILE* f;
+     
+     f = fopen("/dev/urandom", "rb");
+     if (f)  {
+         if (fread(&seed, sizeof(seed), 1, f) == 1) {
+             fclose(f);
+             return seed;
+         }
+         fclose(f);
+     }
+ #endif
+     
+     /* No random source, mix whatever varies between runs (splitmix64 finalizer) */
+     seed = (uint64_t)time(0) ^ ((uint64_t)clock() << 32) ^ (uint64_t)(uintptr_t)&seed ^ (uint64_t)(uintptr_t)&xp_random_seed;
+     seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+     seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebULL;
+     return seed ^ (seed >> 31);
  }
\ No newline at end of file
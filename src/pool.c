@@ -0,0 +1,92 @@
+/**
+ * Fixed size object pool
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+/* Slabs are linked through a header, padded so the objects after it stay aligned */
+struct pool_slab_tag    {
+    pool_slab*  next;
+    double      align;
+};
+
+/**
+ * Initializes the given pool for objects of "size" bytes
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int pool_init(pool* p, size_t size, int per_slab)   {
+    memset(p, 0, sizeof(pool));
+    if (size == 0 || per_slab < 0)  {
+        return -1;
+    }
+
+    // Every object has to be able to hold the free list link
+    if (size < sizeof(void*))   {
+        size = sizeof(void*);
+    }
+
+    p->size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    p->next_slab = per_slab? per_slab : POOL_DEFAULT_SLAB;
+    return 0;
+}
+
+/**
+ * Frees every slab
+ */
+void pool_destroy(pool* p)  {
+    pool_slab* next;
+
+    while (p->slabs)    {
+        next = p->slabs->next;
+        free(p->slabs);
+        p->slabs = next;
+    }
+
+    memset(p, 0, sizeof(pool));
+}
+
+/**
+ * Returns a new object from the pool, or NULL if a slab couldn't be allocated
+ */
+void* pool_alloc(pool* p)   {
+    pool_slab* slab;
+    void* obj;
+
+    if (p->free_list)   {
+        obj = p->free_list;
+        p->free_list = *(void**)obj;
+    } else {
+        if (p->bump == p->bump_end) {
+            if ((slab = (pool_slab*)malloc(sizeof(pool_slab) + p->next_slab * p->size)) == 0)  {
+                return 0;
+            }
+
+            slab->next = p->slabs;
+            p->slabs = slab;
+            p->bump = (char*)(slab + 1);
+            p->bump_end = p->bump + p->next_slab * p->size;
+            if (p->next_slab < POOL_MAX_SLAB)   {
+                p->next_slab *= 2;
+            }
+        }
+
+        obj = p->bump;
+        p->bump += p->size;
+    }
+
+    p->used++;
+    return obj;
+}
+
+/**
+ * Returns the given object to the pool
+ */
+void pool_free(pool* p, void* obj)  {
+    *(void**)obj = p->free_list;
+    p->free_list = obj;
+    p->used--;
+}
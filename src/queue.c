@@ -0,0 +1,325 @@
+/**
+ * Bounded lock-free queues
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "queue.h"
+
+/**
+ * Returns the smallest power of 2 that is at least "capacity" (and at least 2), or 0 if there is none
+ */
+static size_t _round_up(size_t capacity)    {
+    size_t size = 2;
+
+    while (size < capacity) {
+        if (size > ((size_t)-1 >> 1))   {
+            return 0;
+        }
+        size <<= 1;
+    }
+
+    return size;
+}
+
+/**
+ * Initializes the given queue
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int spsc_init(spsc_queue* q, size_t capacity)   {
+    size_t size = _round_up(capacity);
+
+    memset(q, 0, sizeof(spsc_queue));
+    if (size == 0 || size > (size_t)-1 / sizeof(void*) ||
+        (q->slots = (void**)malloc(size * sizeof(void*))) == 0) {
+        return -1;
+    }
+
+    q->mask = size - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return 0;
+}
+
+/**
+ * Frees the queue
+ */
+void spsc_destroy(spsc_queue* q)    {
+    free(q->slots);
+    memset(q, 0, sizeof(spsc_queue));
+}
+
+/**
+ * Adds a value
+ *
+ * Returns 0 if successful, -1 if the queue is full
+ */
+int spsc_push(spsc_queue* q, const void* data)  {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    if (tail - q->cached_head > q->mask)    {
+        q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail - q->cached_head > q->mask)    {
+            return -1;
+        }
+    }
+
+    q->slots[tail & q->mask] = (void*)data;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Takes the oldest value
+ *
+ * Returns 0 if successful, -1 if the queue is empty
+ */
+int spsc_pop(spsc_queue* q, void** data)    {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    if (head == q->cached_tail) {
+        q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head == q->cached_tail) {
+            return -1;
+        }
+    }
+
+    *data = q->slots[head & q->mask];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Copies n values between the ring, starting at position "pos", and "data".  "to_ring" says which way
+ */
+static void _ring_copy(void** slots, size_t mask, size_t pos, void** data, size_t n, int to_ring) {
+    size_t start = pos & mask;
+    size_t first = n < mask + 1 - start? n : mask + 1 - start;
+
+    if (to_ring)    {
+        memcpy(slots + start, data, first * sizeof(void*));
+        memcpy(slots, data + first, (n - first) * sizeof(void*));
+    } else {
+        memcpy(data, slots + start, first * sizeof(void*));
+        memcpy(data + first, slots, (n - first) * sizeof(void*));
+    }
+}
+
+/**
+ * Adds up to n values, publishing them all at once
+ *
+ * Returns the number of values added
+ */
+size_t spsc_push_batch(spsc_queue* q, void* const* data, size_t n)  {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t room = q->mask + 1 - (tail - q->cached_head);
+
+    if (room < n)   {
+        q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+        room = q->mask + 1 - (tail - q->cached_head);
+    }
+
+    if (n > room)   {
+        n = room;
+    }
+
+    _ring_copy(q->slots, q->mask, tail, (void**)data, n, 1);
+    atomic_store_explicit(&q->tail, tail + n, memory_order_release);
+    return n;
+}
+
+/**
+ * Takes up to n of the oldest values
+ *
+ * Returns the number of values taken
+ */
+size_t spsc_pop_batch(spsc_queue* q, void** data, size_t n) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    if (q->cached_tail - head < n)  {
+        q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    }
+
+    if (n > q->cached_tail - head)  {
+        n = q->cached_tail - head;
+    }
+
+    _ring_copy(q->slots, q->mask, head, data, n, 0);
+    atomic_store_explicit(&q->head, head + n, memory_order_release);
+    return n;
+}
+
+/**
+ * Initializes the given queue
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int mpmc_init(mpmc_queue* q, size_t capacity)   {
+    size_t size = _round_up(capacity), i;
+
+    memset(q, 0, sizeof(mpmc_queue));
+    if (size == 0 || size > (size_t)-1 / sizeof(mpmc_cell) ||
+        (q->cells = (mpmc_cell*)malloc(size * sizeof(mpmc_cell))) == 0) {
+        return -1;
+    }
+
+    for (i = 0; i < size; i++)  {
+        atomic_init(&q->cells[i].seq, i);
+    }
+
+    q->mask = size - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return 0;
+}
+
+/**
+ * Frees the queue
+ */
+void mpmc_destroy(mpmc_queue* q)    {
+    free(q->cells);
+    memset(q, 0, sizeof(mpmc_queue));
+}
+
+/**
+ * Adds a value
+ *
+ * Returns 0 if successful, -1 if the queue is full
+ */
+int mpmc_push(mpmc_queue* q, const void* data)  {
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    mpmc_cell* cell;
+    ptrdiff_t diff;
+
+    for (;;)    {
+        cell = &q->cells[pos & q->mask];
+        diff = (ptrdiff_t)(atomic_load_explicit(&cell->seq, memory_order_acquire) - pos);
+
+        if (diff == 0)  {
+            // The cell is free for this lap, claim the position (a failed claim reloads pos)
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed))    {
+                break;
+            }
+        } else if (diff < 0)    {
+            // Still holding the value from the last lap, which hasn't been popped
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+
+    cell->data = (void*)data;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Takes the oldest value
+ *
+ * Returns 0 if successful, -1 if the queue is empty
+ */
+int mpmc_pop(mpmc_queue* q, void** data)    {
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    mpmc_cell* cell;
+    ptrdiff_t diff;
+
+    for (;;)    {
+        cell = &q->cells[pos & q->mask];
+        diff = (ptrdiff_t)(atomic_load_explicit(&cell->seq, memory_order_acquire) - (pos + 1));
+
+        if (diff == 0)  {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed))    {
+                break;
+            }
+        } else if (diff < 0)    {
+            // Nothing pushed at this position yet
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+
+    *data = cell->data;
+    atomic_store_explicit(&cell->seq, pos + q->mask + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Claims up to n positions starting at *pos on the index "index", where the cell for position pos + i
+ * is ready when its sequence number is pos + i + offset
+ *
+ * Returns the number of positions claimed, starting at *pos
+ */
+static size_t _claim(mpmc_queue* q, _Atomic size_t* index, size_t* pos, size_t n, size_t offset)  {
+    size_t ready;
+    ptrdiff_t diff = 0;
+
+    *pos = atomic_load_explicit(index, memory_order_relaxed);
+    if (n == 0) {
+        return 0;
+    }
+
+    for (;;)    {
+        // Count the cells in a row that are ready.  Nobody else can change them until they are claimed
+        for (ready = 0; ready < n && ready <= q->mask; ready++) {
+            diff = (ptrdiff_t)(atomic_load_explicit(&q->cells[(*pos + ready) & q->mask].seq,
+                memory_order_acquire) - (*pos + ready + offset));
+            if (diff != 0)  {
+                break;
+            }
+        }
+
+        if (ready == 0 && diff < 0) {
+            return 0;
+        }
+
+        if (ready > 0 && atomic_compare_exchange_weak_explicit(index, pos, *pos + ready,
+                memory_order_relaxed, memory_order_relaxed))    {
+            return ready;
+        }
+
+        // Another thread got there first (and a failed compare and swap reloaded *pos)
+        if (ready == 0) {
+            *pos = atomic_load_explicit(index, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Adds up to n values, claiming their cells with one compare and swap
+ *
+ * Returns the number of values added
+ */
+size_t mpmc_push_batch(mpmc_queue* q, void* const* data, size_t n)  {
+    size_t pos, i;
+
+    n = _claim(q, &q->tail, &pos, n, 0);
+    for (i = 0; i < n; i++) {
+        q->cells[(pos + i) & q->mask].data = data[i];
+        atomic_store_explicit(&q->cells[(pos + i) & q->mask].seq, pos + i + 1, memory_order_release);
+    }
+
+    return n;
+}
+
+/**
+ * Takes up to n of the oldest values, claiming their cells with one compare and swap
+ *
+ * Returns the number of values taken
+ */
+size_t mpmc_pop_batch(mpmc_queue* q, void** data, size_t n) {
+    size_t pos, i;
+
+    n = _claim(q, &q->head, &pos, n, 1);
+    for (i = 0; i < n; i++) {
+        data[i] = q->cells[(pos + i) & q->mask].data;
+        atomic_store_explicit(&q->cells[(pos + i) & q->mask].seq, pos + i + q->mask + 1, memory_order_release);
+    }
+
+    return n;
+}
@@ -0,0 +1,259 @@
+/**
+ * Rope - a segmented string builder
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "platform.h"
+#include "rope.h"
+
+/* iovecs handed to each writev call, well under any system's IOV_MAX */
+#define ROPE_IOV_BATCH      64
+
+/**
+ * Links a new segment onto the end of the rope
+ */
+static void _link(rope* r, rope_segment* s)    {
+    s->next = 0;
+    if (r->tail)    {
+        r->tail->next = s;
+    } else {
+        r->head = s;
+    }
+
+    r->tail = s;
+    r->segments++;
+}
+
+/**
+ * Adds a new chunk with room for at least "room" bytes
+ *
+ * Returns the chunk, or NULL if it couldn't be allocated
+ */
+static rope_segment* _add_chunk(rope* r, size_t room)  {
+    size_t capacity = room > r->chunk_size? room : r->chunk_size;
+    rope_segment* s;
+
+    if ((s = (rope_segment*)malloc(sizeof(rope_segment) + capacity)) == 0)  {
+        return 0;
+    }
+
+    s->data = s->storage;
+    s->length = 0;
+    s->capacity = capacity;
+    _link(r, s);
+    return s;
+}
+
+/**
+ * Returns the room left in the rope's last chunk, or 0 if the last segment is borrowed
+ */
+static size_t _room(const rope* r)  {
+    return r->tail && r->tail->capacity? r->tail->capacity - r->tail->length : 0;
+}
+
+/**
+ * Initializes the given rope as empty
+ */
+void rope_init(rope* r, size_t chunk_size)  {
+    memset(r, 0, sizeof(rope));
+    r->chunk_size = chunk_size? chunk_size : ROPE_CHUNK_SIZE;
+}
+
+/**
+ * Destroys the given rope, freeing its chunks
+ */
+void rope_destroy(rope* r)  {
+    rope_segment* s;
+    rope_segment* next;
+
+    for (s = r->head; s; s = next)  {
+        next = s->next;
+        free(s);
+    }
+
+    memset(r, 0, sizeof(rope));
+}
+
+/**
+ * Empties the rope, freeing its chunks
+ */
+void rope_reset(rope* r)    {
+    size_t chunk_size = r->chunk_size;
+
+    rope_destroy(r);
+    rope_init(r, chunk_size);
+}
+
+/**
+ * Appends "length" bytes from "data", copying them into the rope
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append(rope* r, const char* data, size_t length)   {
+    size_t n;
+
+    while (length > 0)  {
+        if (_room(r) == 0 && _add_chunk(r, 0) == 0)    {
+            return -1;
+        }
+
+        // Fill what is left of the last chunk, and carry on in a new one
+        n = _room(r) < length? _room(r) : length;
+        memcpy(r->tail->storage + r->tail->length, data, n);
+        r->tail->length += n;
+        r->length += n;
+        data += n;
+        length -= n;
+    }
+
+    return 0;
+}
+
+/**
+ * Appends the given string, copying it into the rope
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append_str(rope* r, const char* src)  {
+    return rope_append(r, src, strlen(src));
+}
+
+/**
+ * Appends the formatted string
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append_strf(rope* r, const char* fmt, ...) {
+    va_list arglist;
+    int result;
+
+    va_start(arglist, fmt);
+    result = rope_append_vstrf(r, fmt, arglist);
+    va_end(arglist);
+
+    return result;
+}
+
+/**
+ * Appends the formatted string, like rope_append_strf but with a va_list
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append_vstrf(rope* r, const char* fmt, va_list ap) {
+    size_t room = _room(r);
+    int length;
+    va_list ap2;
+
+    // Try the room left in the last chunk first.  vsnprintf always writes a terminator, which is fine as
+    // long as there is room for it: it just isn't counted in the chunk's length
+    va_copy(ap2, ap);
+    length = xp_vsnprintf(room? r->tail->storage + r->tail->length : 0, room, fmt, ap2);
+    va_end(ap2);
+
+    if (length < 0) {
+        return -1;
+    }
+
+    if ((size_t)length >= room) {
+        if (_add_chunk(r, (size_t)length + 1) == 0)    {
+            return -1;
+        }
+
+        length = xp_vsnprintf(r->tail->storage, r->tail->capacity, fmt, ap);
+    }
+
+    r->tail->length += length;
+    r->length += length;
+    return 0;
+}
+
+/**
+ * Appends "length" bytes from "data" by reference, without copying them
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int rope_append_ref(rope* r, const char* data, size_t length)   {
+    rope_segment* s;
+
+    if (length <= ROPE_COPY_MAX)    {
+        return rope_append(r, data, length);
+    }
+
+    if ((s = (rope_segment*)malloc(sizeof(rope_segment))) == 0) {
+        return -1;
+    }
+
+    s->data = data;
+    s->length = length;
+    s->capacity = 0;
+    _link(r, s);
+    r->length += length;
+    return 0;
+}
+
+/**
+ * Writes the whole rope to the file descriptor "fd" with writev
+ *
+ * Returns 0 if successful, -1 if a write failed
+ */
+int rope_write(const rope* r, int fd)  {
+    struct iovec iov[ROPE_IOV_BATCH];
+    const rope_segment* s = r->head;
+    const rope_segment* t;
+    size_t skip = 0;
+    ssize_t written;
+    int count;
+
+    while (s)   {
+        // Gather the next batch of segments, the first starting past whatever of it is already written
+        for (t = s, count = 0; t && count < ROPE_IOV_BATCH; t = t->next, count++)  {
+            iov[count].iov_base = (void*)(t->data + (t == s? skip : 0));
+            iov[count].iov_len = t->length - (t == s? skip : 0);
+        }
+
+        if ((written = writev(fd, iov, count)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        // Step past the segments that went out completely, and into the one that went out partly
+        while (s && (size_t)written >= s->length - skip)    {
+            written -= s->length - skip;
+            skip = 0;
+            s = s->next;
+        }
+        skip += written;
+    }
+
+    return 0;
+}
+
+/**
+ * Allocates and copies a new null terminated cstring of the rope's contents
+ *
+ * Returns the string, or NULL if it couldn't be allocated
+ */
+char* rope_flatten(const rope* r)   {
+    const rope_segment* s;
+    char* out;
+    char* p;
+
+    if ((out = (char*)malloc(r->length + 1)) == 0)  {
+        return 0;
+    }
+
+    for (s = r->head, p = out; s; s = s->next)  {
+        memcpy(p, s->data, s->length);
+        p += s->length;
+    }
+
+    *p = '\0';
+    return out;
+}
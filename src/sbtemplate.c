@@ -0,0 +1,402 @@
+/**
+ * Format templates - printf-style format strings compiled once for stringbuilders
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+
+#include "sbtemplate.h"
+
+/* Widths and precisions past this are refused, rather than overflowing */
+#define SB_TEMPLATE_MAX_WIDTH       9999
+
+/* %f precisions up to this are converted here, past it they go through libc */
+#define SB_FIXED_MAX_PRECISION      15
+
+/* The most a conversion writes before padding: a sign and 20 digits for integers, and for %f a sign, the
+   point and up to 17 digits (or 309 for the biggest doubles), plus the precision */
+#define SB_INTEGER_ROOM             21
+#define SB_FIXED_ROOM               19
+#define SB_FIXED_ROOM_MAX           311
+
+static const uint64_t _pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL
+};
+
+/**
+ * Reads a width or precision, leaving *p past it
+ *
+ * Returns 0 if successful, -1 if it is too big
+ */
+static int _parse_number(const char** p, int* value)    {
+    *value = 0;
+    while (**p >= '0' && **p <= '9')    {
+        *value = *value * 10 + (*(*p)++ - '0');
+        if (*value > SB_TEMPLATE_MAX_WIDTH) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Parses the conversion following a '%' into the given slot, leaving *format past it
+ *
+ * Returns 0 if successful, -1 if it isn't in the supported subset
+ */
+static int _parse_conversion(sb_template_slot* slot, const char** format)  {
+    const char* p = *format;
+
+    slot->flags = 0;
+    slot->precision = -1;
+    slot->type = SB_ARG_INT;
+
+    for (;; p++)    {
+        if (*p == '-')  {
+            slot->flags |= SB_SLOT_LEFT;
+        } else if (*p == '0')   {
+            slot->flags |= SB_SLOT_ZERO;
+        } else if (*p == '+')   {
+            slot->flags |= SB_SLOT_PLUS;
+        } else {
+            break;
+        }
+    }
+
+    if (_parse_number(&p, &slot->width) != 0)   {
+        return -1;
+    }
+
+    if (*p == '.')  {
+        p++;
+        if (_parse_number(&p, &slot->precision) != 0)   {
+            return -1;
+        }
+    }
+
+    if (p[0] == 'h' && p[1] == 'h') {
+        slot->type = SB_ARG_CHAR;
+        p += 2;
+    } else if (p[0] == 'l' && p[1] == 'l')  {
+        slot->type = SB_ARG_LONG_LONG;
+        p += 2;
+    } else if (*p == 'h' || *p == 'l' || *p == 'z' || *p == 'j' || *p == 't') {
+        slot->type = *p == 'h'? SB_ARG_SHORT : *p == 'l'? SB_ARG_LONG : *p == 'z'? SB_ARG_SIZE :
+            *p == 'j'? SB_ARG_INTMAX : SB_ARG_PTRDIFF;
+        p++;
+    }
+
+    switch (*p) {
+        case 'd':
+        case 'i':
+            slot->conversion = 'd';
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+            slot->conversion = *p;
+            slot->flags &= ~SB_SLOT_PLUS;
+            break;
+        case 'c':
+        case 's':
+            // '0' with these is undefined in C, so it isn't supported
+            if (slot->type != SB_ARG_INT || (slot->flags & SB_SLOT_ZERO))  {
+                return -1;
+            }
+            slot->conversion = *p;
+            slot->type = *p == 's'? SB_ARG_STRING : SB_ARG_INT;
+            slot->flags &= ~SB_SLOT_PLUS;
+            break;
+        case 'f':
+            // "%lf" is allowed, and the same as "%f"
+            if (slot->type != SB_ARG_INT && slot->type != SB_ARG_LONG)   {
+                return -1;
+            }
+            slot->conversion = 'f';
+            slot->type = SB_ARG_DOUBLE;
+            break;
+        default:
+            return -1;
+    }
+
+    if (slot->precision >= 0 && slot->conversion != 's' && slot->conversion != 'f')  {
+        return -1;
+    }
+
+    *format = p + 1;
+    return 0;
+}
+
+/**
+ * Compiles the printf-style format string "fmt" into the given template
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_template_compile(sb_template* t, const char* fmt)    {
+    sb_template_slot* slot;
+    const char* p;
+    int length = 0;
+    int count = 1;
+
+    memset(t, 0, sizeof(sb_template));
+
+    // Every '%' starts at most one conversion, so that bounds the slots
+    for (p = fmt; *p; p++)  {
+        count += *p == '%';
+    }
+
+    t->text = (char*)malloc(strlen(fmt) + 1);
+    t->slots = (sb_template_slot*)malloc(count * sizeof(sb_template_slot));
+    if (!t->text || !t->slots)  {
+        sb_template_destroy(t);
+        return -1;
+    }
+
+    slot = t->slots;
+    slot->literal = 0;
+    for (p = fmt; *p; ) {
+        if (*p != '%')  {
+            t->text[length++] = *p++;
+        } else if (p[1] == '%') {
+            t->text[length++] = '%';
+            p += 2;
+        } else {
+            p++;
+            if (_parse_conversion(slot, &p) != 0)   {
+                sb_template_destroy(t);
+                return -1;
+            }
+
+            slot->literal_length = length - slot->literal;
+            slot++;
+            slot->literal = length;
+        }
+    }
+
+    slot->literal_length = length - slot->literal;
+    slot->conversion = 0;
+    slot->type = SB_ARG_NONE;
+    slot->flags = 0;
+    slot->width = 0;
+    slot->precision = -1;
+
+    t->text[length] = '\0';
+    t->count = (int)(slot - t->slots) + 1;
+    return 0;
+}
+
+/**
+ * Destroys the given template, freeing its text and slots
+ */
+void sb_template_destroy(sb_template* t)    {
+    free(t->text);
+    free(t->slots);
+    memset(t, 0, sizeof(sb_template));
+}
+
+/**
+ * Appends value as printf's "%.*f" would, converting it here when the digits can be rounded exactly as a
+ * 64-bit integer and leaving it to libc otherwise
+ */
+static void _append_fixed(stringbuilder* sb, double value, int precision, int plus)    {
+    double scaled, whole;
+    uint64_t digits;
+    size_t point;
+
+    if (precision <= SB_FIXED_MAX_PRECISION)    {
+        // NaN and the infinities fail the comparison and go to libc too
+        scaled = fabs(value) * (double)_pow10[precision];
+        if (scaled < 4503599627370496.0)    {
+            whole = floor(scaled);
+
+            // scaled is within half an ulp of the exact product, so unless it is that close to halfway
+            // it rounds the same way the exact value does
+            if (fabs(scaled - whole - 0.5) > scaled * DBL_EPSILON)  {
+                digits = (uint64_t)whole + (scaled - whole > 0.5);
+                if (signbit(value)) {
+                    sb_append_ch(sb, '-');
+                } else if (plus)    {
+                    sb_append_ch(sb, '+');
+                }
+
+                if (precision == 0) {
+                    sb_append_u64(sb, digits);
+                    return;
+                }
+
+                // The fraction is written with a leading 1 to keep its leading zeros, then the 1 becomes
+                // the point
+                sb_append_u64(sb, digits / _pow10[precision]);
+                point = sb->pos;
+                sb_append_u64(sb, digits % _pow10[precision] + _pow10[precision]);
+                if (sb->pos > point)    {
+                    sb->cstr[point] = '.';
+                }
+                return;
+            }
+        }
+    }
+
+    sb_append_strf(sb, plus? "%+.*f" : "%.*f", precision, value);
+}
+
+/**
+ * Pads what the slot's conversion wrote from "start" out to the slot's width: with spaces after it if
+ * left justified, with zeros after any sign if "zero", and with spaces before it otherwise
+ */
+static void _pad(stringbuilder* sb, const sb_template_slot* slot, size_t start, int zero)   {
+    int length = (int)(sb->pos - start);
+    int count = slot->width - length;
+    int skip = 0;
+    char fill = ' ';
+    int i;
+
+    for (i = 0; i < count; i++) {
+        sb_append_ch(sb, ' ');
+    }
+
+    if (sb->pos != start + slot->width || (slot->flags & SB_SLOT_LEFT)) {
+        return;
+    }
+
+    if (zero)   {
+        fill = '0';
+        skip = sb->cstr[start] == '-' || sb->cstr[start] == '+';
+    }
+
+    memmove(sb->cstr + start + skip + count, sb->cstr + start + skip, length - skip);
+    memset(sb->cstr + start + skip, fill, count);
+}
+
+/**
+ * Appends the template to the stringbuilder
+ */
+void sb_append_template(stringbuilder* sb, const sb_template* t, ...)   {
+    va_list arglist;
+
+    va_start(arglist, t);
+    sb_append_vtemplate(sb, t, arglist);
+    va_end(arglist);
+}
+
+/**
+ * Appends the template to the stringbuilder, like sb_append_template but with a va_list
+ */
+void sb_append_vtemplate(stringbuilder* sb, const sb_template* t, va_list ap)  {
+    const sb_template_slot* slot;
+    const char* str = 0;
+    uint64_t value = 0;
+    double number = 0;
+    size_t length = 0;
+    size_t start;
+    size_t i;
+    int is_signed;
+    int zero;
+
+    for (slot = t->slots; ; slot++) {
+        if (slot->literal_length)   {
+            sb_append_strn(sb, t->text + slot->literal, slot->literal_length);
+        }
+
+        if (slot->type == SB_ARG_NONE)  {
+            return;
+        }
+
+        zero = (slot->flags & SB_SLOT_ZERO) != 0;
+        is_signed = slot->conversion == 'd';
+
+        // Fetch integers as the type the length modifier says was passed, sign extended if they're signed
+        switch (slot->type) {
+            case SB_ARG_INT:
+            case SB_ARG_CHAR:
+            case SB_ARG_SHORT:
+                value = is_signed? (uint64_t)(int64_t)va_arg(ap, int) : va_arg(ap, unsigned int);
+                if (slot->type == SB_ARG_CHAR)  {
+                    value = is_signed? (uint64_t)(int64_t)(signed char)value : (unsigned char)value;
+                } else if (slot->type == SB_ARG_SHORT)  {
+                    value = is_signed? (uint64_t)(int64_t)(short)value : (unsigned short)value;
+                }
+                break;
+            case SB_ARG_LONG:
+                value = is_signed? (uint64_t)(int64_t)va_arg(ap, long) : va_arg(ap, unsigned long);
+                break;
+            case SB_ARG_LONG_LONG:
+                value = is_signed? (uint64_t)(int64_t)va_arg(ap, long long) : va_arg(ap, unsigned long long);
+                break;
+            case SB_ARG_SIZE:
+            case SB_ARG_PTRDIFF:
+                value = is_signed? (uint64_t)(int64_t)va_arg(ap, ptrdiff_t) : va_arg(ap, size_t);
+                break;
+            case SB_ARG_INTMAX:
+                value = is_signed? (uint64_t)(int64_t)va_arg(ap, intmax_t) : va_arg(ap, uintmax_t);
+                break;
+            case SB_ARG_DOUBLE:
+                number = va_arg(ap, double);
+                break;
+            case SB_ARG_STRING:
+                if ((str = va_arg(ap, const char*)) == 0)   {
+                    str = "(null)";
+                }
+                length = slot->precision >= 0? strnlen(str, slot->precision) : strlen(str);
+                break;
+            default:
+                break;
+        }
+
+        // Make room for the whole field first, so a sink can't flush part of it before it is padded
+        if (slot->type == SB_ARG_DOUBLE)    {
+            length = (fabs(number) < 1e17? SB_FIXED_ROOM : SB_FIXED_ROOM_MAX) +
+                (slot->precision >= 0? slot->precision : 6);
+        } else if (slot->type != SB_ARG_STRING) {
+            length = SB_INTEGER_ROOM;
+        }
+        sb_make_room(sb, slot->width + length);
+        start = sb->pos;
+
+        switch (slot->conversion)   {
+            case 'd':
+                if ((slot->flags & SB_SLOT_PLUS) && (int64_t)value >= 0)   {
+                    sb_append_ch(sb, '+');
+                }
+                sb_append_i64(sb, (int64_t)value);
+                break;
+            case 'u':
+                sb_append_u64(sb, value);
+                break;
+            case 'x':
+            case 'X':
+                sb_append_hex(sb, value, 1);
+                if (slot->conversion == 'X')    {
+                    for (i = start; i < sb->pos; i++)   {
+                        if (sb->cstr[i] >= 'a') {
+                            sb->cstr[i] -= 'a' - 'A';
+                        }
+                    }
+                }
+                break;
+            case 'c':
+                sb_append_ch(sb, (char)value);
+                break;
+            case 's':
+                sb_append_strn(sb, str, length);
+                break;
+            case 'f':
+                _append_fixed(sb, number, slot->precision >= 0? slot->precision : 6, slot->flags & SB_SLOT_PLUS);
+
+                // printf pads "inf" and "nan" with spaces even with '0'
+                zero = zero && sb->pos > start && sb->cstr[sb->pos - 1] >= '0' && sb->cstr[sb->pos - 1] <= '9';
+                break;
+        }
+
+        if (sb->pos - start < (size_t)slot->width)  {
+            _pad(sb, slot, start, zero);
+        }
+    }
+}
@@ -0,0 +1,241 @@
+/**
+ * Merge sorts for arrays of pointers
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort.h"
+
+typedef int (*sort_compare)(const void* key1, const void* key2);
+
+/* One job of a parallel sort: either sort a slice, or produce outputs d0 to d1 of merging runs a and b */
+typedef struct sort_task_tag    {
+    sort_compare    compare;
+
+    void**          a;
+    size_t          na;
+    void**          b;
+    size_t          nb;
+    void**          dst;
+    size_t          d0;
+    size_t          d1;
+} sort_task;
+
+/**
+ * Merges the sorted runs a and b into dst.  Ties go to a, which keeps the sort stable
+ */
+static void _merge(void** dst, void** a, size_t na, void** b, size_t nb, sort_compare compare)  {
+    while (na && nb)    {
+        if (compare(*b, *a) < 0)    {
+            *dst++ = *b++;
+            nb--;
+        } else {
+            *dst++ = *a++;
+            na--;
+        }
+    }
+
+    memcpy(dst, a, na * sizeof(void*));
+    memcpy(dst + na, b, nb * sizeof(void*));
+}
+
+static void _isort(void** data, size_t n, sort_compare compare) {
+    size_t i, j;
+    void* t;
+
+    for (i = 1; i < n; i++) {
+        t = data[i];
+        for (j = i; j > 0 && compare(t, data[j - 1]) < 0; j--)  {
+            data[j] = data[j - 1];
+        }
+        data[j] = t;
+    }
+}
+
+/**
+ * Sorts data, using tmp (which is just as long) as scratch space
+ *
+ * Returns whichever of data and tmp holds the sorted values
+ */
+static void** _merge_sort(void** data, void** tmp, size_t n, sort_compare compare)  {
+    void **src, **dst, **swap;
+    size_t i, width, mid, end;
+
+    for (i = 0; i < n; i += SORT_ISORT_MAX) {
+        _isort(data + i, n - i < SORT_ISORT_MAX? n - i : SORT_ISORT_MAX, compare);
+    }
+
+    src = data;
+    dst = tmp;
+    for (width = SORT_ISORT_MAX; width < n; width *= 2)    {
+        for (i = 0; i < n; i += 2 * width)  {
+            mid = n - i < width? n : i + width;
+            end = n - mid < width? n : mid + width;
+            _merge(dst + i, src + i, mid - i, src + mid, end - mid, compare);
+        }
+
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    return src;
+}
+
+/**
+ * Returns how many values of a come before output d of merging a and b (ties going to a)
+ */
+static size_t _split(void** a, size_t na, void** b, size_t nb, size_t d, sort_compare compare)  {
+    size_t lo = d > nb? d - nb : 0;
+    size_t hi = d < na? d : na;
+    size_t i;
+
+    while (lo < hi) {
+        i = lo + (hi - lo) / 2;
+        if (compare(a[i], b[d - i - 1]) <= 0)   {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+
+    return lo;
+}
+
+static void _merge_task(void* arg)  {
+    sort_task* t = (sort_task*)arg;
+    size_t i0 = _split(t->a, t->na, t->b, t->nb, t->d0, t->compare);
+    size_t i1 = _split(t->a, t->na, t->b, t->nb, t->d1, t->compare);
+
+    _merge(t->dst + t->d0, t->a + i0, i1 - i0, t->b + (t->d0 - i0), (t->d1 - i1) - (t->d0 - i0), t->compare);
+}
+
+/* Sorts the slice a, na long, into dst, using b as scratch.  dst is either a or b */
+static void _sort_task(void* arg)   {
+    sort_task* t = (sort_task*)arg;
+    void** sorted = _merge_sort(t->a, t->b, t->na, t->compare);
+
+    if (sorted != t->dst)   {
+        memcpy(t->dst, sorted, t->na * sizeof(void*));
+    }
+}
+
+/**
+ * Sorts the n values in "data" with a bottom-up merge sort
+ *
+ * Returns 0 if successful, -1 if the scratch space couldn't be allocated
+ */
+int sort_merge(void** data, size_t n, int (*compare)(const void* key1, const void* key2))   {
+    void **tmp, **sorted;
+
+    if (n <= SORT_ISORT_MAX)    {
+        _isort(data, n, compare);
+        return 0;
+    }
+
+    if ((tmp = (void**)malloc(n * sizeof(void*))) == 0) {
+        return -1;
+    }
+
+    if ((sorted = _merge_sort(data, tmp, n, compare)) != data)  {
+        memcpy(data, sorted, n * sizeof(void*));
+    }
+
+    free(tmp);
+    return 0;
+}
+
+/**
+ * Sorts the n values in "data" with a parallel merge sort on the given pool
+ *
+ * Returns 0 if successful, -1 if the scratch space couldn't be allocated
+ */
+int sort_parallel(void** data, size_t n, int (*compare)(const void* key1, const void* key2), threadpool* tp) {
+    void **tmp, **src, **dst, **swap;
+    size_t *bounds, piece, start, mid, end, len, d;
+    sort_task* tasks;
+    int slices, rounds, runs, ntasks, i, p, pieces;
+
+    if (!tp || n < SORT_PARALLEL_MIN || threadpool_size(tp) == 0)  {
+        return sort_merge(data, n, compare);
+    }
+
+    slices = threadpool_size(tp) + 1;
+    for (rounds = 0; (1 << rounds) < slices; rounds++)  {
+    }
+
+    // Merges aim for pieces of about this size, so each round is split into about 2 jobs per thread.
+    // With the slices that is at most 3 jobs per thread at a time
+    piece = n / (2 * slices) + 1;
+
+    tmp = (void**)malloc(n * sizeof(void*));
+    bounds = (size_t*)malloc((slices + 1) * sizeof(size_t));
+    tasks = (sort_task*)malloc((3 * slices + 2) * sizeof(sort_task));
+    if (!tmp || !bounds || !tasks)  {
+        free(tmp);
+        free(bounds);
+        free(tasks);
+        return -1;
+    }
+
+    // Sort the slices into whichever buffer makes the last round of merges end up in data
+    dst = rounds % 2? tmp : data;
+    for (i = 0; i <= slices; i++)   {
+        bounds[i] = (size_t)((double)n * i / slices);
+    }
+
+    for (i = 0; i < slices; i++)    {
+        tasks[i].compare = compare;
+        tasks[i].a = data + bounds[i];
+        tasks[i].na = bounds[i + 1] - bounds[i];
+        tasks[i].b = tmp + bounds[i];
+        tasks[i].dst = dst + bounds[i];
+        if (threadpool_submit(tp, _sort_task, &tasks[i]) != 0)  {
+            _sort_task(&tasks[i]);
+        }
+    }
+    threadpool_wait(tp);
+
+    // Merge runs pairwise, splitting each merge into pieces that are merged at the same time
+    src = dst;
+    dst = src == data? tmp : data;
+    for (runs = slices; runs > 1; runs = (runs + 1) / 2)    {
+        ntasks = 0;
+        for (i = 0; i < runs; i += 2)   {
+            start = bounds[i];
+            mid = bounds[i + 1];
+            end = i + 2 <= runs? bounds[i + 2] : mid;
+            len = end - start;
+            pieces = (int)((len + piece - 1) / piece);
+
+            for (p = 0, d = 0; p < pieces; p++, d += piece)    {
+                tasks[ntasks].compare = compare;
+                tasks[ntasks].a = src + start;
+                tasks[ntasks].na = mid - start;
+                tasks[ntasks].b = src + mid;
+                tasks[ntasks].nb = end - mid;
+                tasks[ntasks].dst = dst + start;
+                tasks[ntasks].d0 = d;
+                tasks[ntasks].d1 = p + 1 == pieces? len : d + piece;
+                if (threadpool_submit(tp, _merge_task, &tasks[ntasks]) != 0)  {
+                    _merge_task(&tasks[ntasks]);
+                }
+                ntasks++;
+            }
+
+            bounds[i / 2] = start;
+        }
+        bounds[(runs + 1) / 2] = n;
+        threadpool_wait(tp);
+
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    free(tmp);
+    free(bounds);
+    free(tasks);
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "platform.h"
 #include "stringbuilder.h"
@@ -22,52 +23,126 @@ stringbuilder* sb_new() {
 /**
  * Creates a new stringbuilder with initial size at least the given size
  */
-stringbuilder* sb_new_with_size(int size)   {
+stringbuilder* sb_new_with_size(size_t size)    {
+    return sb_new_with_flags(size, 0);
+}
+
+/**
+ * Creates a new stringbuilder with initial size at least the given size and the given SB_* flags
+ */
+stringbuilder* sb_new_with_flags(size_t size, int flags)    {
     stringbuilder* sb;
     
+    // There must always be room for the null terminator
+    if (size < 1)   {
+        size = 1;
+    }
+
     sb = (stringbuilder*)malloc(sizeof(stringbuilder));
     sb->size = size;
     sb->cstr = (char*)malloc(size);
     sb->pos = 0;
-    sb->reallocs = 0;
+    sb->flags = flags & ~(SB_STATIC_BUFFER | SB_STATIC_STRUCT | SB_SINK);
+    sb->growth = 0;
+    memset(&sb->stats, 0, sizeof(sb_stats));
+    sb->sink_file = 0;
+    sb->sink_fd = -1;
+    sb->high_water = 0;
 
-    // Fill cstr with null to ensure it is always null terminated
-    memset(sb->cstr, '\0', size);
+    // Fill cstr with null to ensure it is always null terminated (lazily terminated ones just start empty)
+    if (flags & SB_LAZY_NUL)    {
+        sb->cstr[0] = '\0';
+    } else {
+        memset(sb->cstr, '\0', size);
+    }
     
     return sb;
 }
 
+/**
+ * Initializes a stringbuilder in storage the caller owns
+ */
+void sb_init(stringbuilder* sb, char* buffer, size_t size, int flags)   {
+    if (!buffer || size < 1)    {
+        buffer = sb->small;
+        size = SB_INLINE_SIZE;
+    }
+
+    sb->cstr = buffer;
+    sb->size = size;
+    sb->pos = 0;
+    sb->flags = (flags & ~SB_SINK) | SB_STATIC_BUFFER | SB_STATIC_STRUCT;
+    sb->growth = 0;
+    memset(&sb->stats, 0, sizeof(sb_stats));
+    sb->sink_file = 0;
+    sb->sink_fd = -1;
+    sb->high_water = 0;
+
+    if (flags & SB_LAZY_NUL)    {
+        sb->cstr[0] = '\0';
+    } else {
+        memset(sb->cstr, '\0', size);
+    }
+}
+
 void sb_reset(stringbuilder* sb) {
     sb->pos = 0;
-    memset(sb->cstr, '\0', sb->size);
+    if (sb->flags & SB_LAZY_NUL)    {
+        sb->cstr[0] = '\0';
+    } else {
+        memset(sb->cstr, '\0', sb->size);
+    }
 }
 
 /**
  * Destroys the given stringbuilder
  */
 void sb_destroy(stringbuilder* sb, int free_string) {
-    if (free_string)    {
+    if (free_string && !(sb->flags & SB_STATIC_BUFFER))    {
         free(sb->cstr);
     }
     
-    free(sb);
+    if (!(sb->flags & SB_STATIC_STRUCT))    {
+        free(sb);
+    }
 }
 
 /**
  * Internal function to resize our string buffer's storage.
  * \return 1 iff sb->cstr was successfully resized, otherwise 0
  */
-int sb_resize(stringbuilder* sb, const int new_size) {
+int sb_resize(stringbuilder* sb, const size_t new_size) {
     char* old_cstr = sb->cstr;
+    uintptr_t old_address = (uintptr_t)old_cstr;
+    size_t copied;
     
-    sb->cstr = (char *)realloc(sb->cstr, new_size);
-    if (sb->cstr == NULL) {
-        sb->cstr = old_cstr;
-        return 0;
+    if (sb->flags & SB_STATIC_BUFFER)   {
+        // Spilling out of a buffer that isn't ours, so copy rather than realloc
+        if ((sb->cstr = (char*)malloc(new_size)) == NULL)   {
+            sb->cstr = old_cstr;
+            return 0;
+        }
+        memcpy(sb->cstr, old_cstr, sb->pos);
+        sb->flags &= ~SB_STATIC_BUFFER;
+        copied = sb->pos;
+    } else {
+        sb->cstr = (char *)realloc(sb->cstr, new_size);
+        if (sb->cstr == NULL) {
+            sb->cstr = old_cstr;
+            return 0;
+        }
+        copied = sb->size < new_size? sb->size : new_size;
+    }
+    if (!(sb->flags & SB_LAZY_NUL)) {
+        memset(sb->cstr + sb->pos, '\0', new_size - sb->pos);
+    }
+
+    if ((uintptr_t)sb->cstr != old_address) {
+        sb->stats.moves++;
+        sb->stats.bytes_copied += copied;
     }
-    memset(sb->cstr + sb->pos, '\0', new_size - sb->pos);
     sb->size = new_size;
-    sb->reallocs++;
+    sb->stats.reallocs++;
     return 1;
 }
 
@@ -75,11 +150,189 @@ int sb_double_size(stringbuilder* sb) {
     return sb_resize(sb, sb->size * 2);
 }
 
-void sb_append_ch(stringbuilder* sb, const char ch) {
-    int new_size;
+/**
+ * Grows the buffer by the stringbuilder's growth policy to at least required bytes
+ * \return 1 iff sb->cstr was successfully resized, otherwise 0
+ */
+static int _grow(stringbuilder* sb, size_t required)    {
+    size_t new_size = (sb->growth? sb->growth : sb_grow_double)(sb->size, required);
+
+    return sb_resize(sb, new_size < required? required : new_size);
+}
+
+/**
+ * Makes sure there is room for length more characters and the null terminator
+ * \return 1 iff there is room, otherwise 0
+ */
+static int _make_room(stringbuilder* sb, size_t length)    {
+    // A sink writes out what it holds before the append would take it past the high-water mark.  If the
+    // write fails it keeps the rest, and grows below to make room anyway
+    if ((sb->flags & SB_SINK) && sb->pos && (sb->pos > sb->high_water || length > sb->high_water - sb->pos))  {
+        sb_flush(sb);
+    }
+
+    // <buffer size> - <zero based index of next char to write> - <space for null terminator>
+    if (sb->size - sb->pos - 1 >= length)   {
+        return 1;
+    }
+
+    if (length > SIZE_MAX - sb->pos - 1)    {
+        return 0;
+    }
 
-    if (sb->pos == sb->size) {
-        sb_double_size(sb);
+    return _grow(sb, sb->pos + length + 1);
+}
+
+/**
+ * Doubles size until it is at least required
+ */
+size_t sb_grow_double(size_t size, size_t required) {
+    while (size < required && size <= SIZE_MAX / 2) {
+        size *= 2;
+    }
+
+    return size;
+}
+
+/**
+ * Grows size by half at a time until it is at least required
+ */
+size_t sb_grow_by_half(size_t size, size_t required)    {
+    while (size < required && size <= SIZE_MAX / 3 * 2)  {
+        size += (size + 1) / 2;
+    }
+
+    return size;
+}
+
+/**
+ * Grows size by half, or to required if that is more, rounded up to whole pages
+ */
+size_t sb_grow_pages(size_t size, size_t required)  {
+    size = size <= SIZE_MAX / 3 * 2? size + (size + 1) / 2 : size;
+    if (size < required)    {
+        size = required;
+    }
+
+    return size <= SIZE_MAX - SB_PAGE_SIZE? (size + SB_PAGE_SIZE - 1) & ~(size_t)(SB_PAGE_SIZE - 1) : size;
+}
+
+/**
+ * Grows the buffer, if need be, so it holds a string of at least length characters
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_reserve(stringbuilder* sb, size_t length)    {
+    if (length < sb->size)  {
+        return 0;
+    }
+
+    return length < SIZE_MAX && sb_resize(sb, length + 1)? 0 : -1;
+}
+
+/**
+ * Shrinks the buffer to just fit the current string and its terminator
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_shrink_to_fit(stringbuilder* sb) {
+    if ((sb->flags & SB_STATIC_BUFFER) || sb->size == sb->pos + 1)    {
+        return 0;
+    }
+
+    return sb_resize(sb, sb->pos + 1)? 0 : -1;
+}
+
+/**
+ * Makes room for at least length more characters
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_make_room(stringbuilder* sb, size_t length)  {
+    return _make_room(sb, length)? 0 : -1;
+}
+
+/**
+ * Shrinks a sink's buffer back to its high-water mark, if it grew past it and now holds no more than that
+ */
+static void _shrink_to_mark(stringbuilder* sb)  {
+    if (sb->size - 1 > sb->high_water && sb->pos <= sb->high_water && !(sb->flags & SB_STATIC_BUFFER))  {
+        sb_resize(sb, sb->high_water + 1);
+    }
+}
+
+/**
+ * Makes the stringbuilder a sink, flushing to fd or file once it holds high_water characters
+ */
+static int _bind(stringbuilder* sb, int fd, FILE* file, size_t high_water)  {
+    if (!high_water)    {
+        high_water = SB_SINK_SIZE;
+    }
+
+    if (sb_reserve(sb, high_water) != 0)    {
+        return -1;
+    }
+
+    sb->sink_fd = fd;
+    sb->sink_file = file;
+    sb->high_water = high_water;
+    sb->flags |= SB_SINK;
+    _shrink_to_mark(sb);
+    return 0;
+}
+
+/**
+ * Binds the stringbuilder to the file descriptor fd as a sink
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_bind_fd(stringbuilder* sb, int fd, size_t high_water)    {
+    return _bind(sb, fd, 0, high_water);
+}
+
+/**
+ * Binds the stringbuilder to file as a sink
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int sb_bind_file(stringbuilder* sb, FILE* file, size_t high_water)  {
+    return file? _bind(sb, -1, file, high_water) : -1;
+}
+
+/**
+ * Writes what a sink holds out and empties it
+ *
+ * Returns 0 if successful, -1 if a write failed
+ */
+int sb_flush(stringbuilder* sb) {
+    size_t written;
+    int result;
+
+    if (!(sb->flags & SB_SINK)) {
+        return 0;
+    }
+
+    if (sb->sink_file)  {
+        written = fwrite(sb->cstr, 1, sb->pos, sb->sink_file);
+    } else {
+        written = xp_write(sb->sink_fd, sb->cstr, sb->pos);
+    }
+    result = written == sb->pos? 0 : -1;
+
+    // Keep whatever couldn't be written at the start of the buffer
+    memmove(sb->cstr, sb->cstr + written, sb->pos - written);
+    if (!(sb->flags & SB_LAZY_NUL)) {
+        memset(sb->cstr + sb->pos - written, '\0', written);
+    }
+    sb->pos -= written;
+    _shrink_to_mark(sb);
+    return result;
+}
+
+void sb_append_ch(stringbuilder* sb, const char ch) {
+    // Keep room for the null terminator, and let a sink flush at its high-water mark
+    if ((sb->pos + 1 >= sb->size || (sb->flags & SB_SINK)) && !_make_room(sb, 1)) {
+        return;
     }
 
     sb->cstr[sb->pos++] = ch;
@@ -88,20 +341,9 @@ void sb_append_ch(stringbuilder* sb, const char ch) {
 /**
  * Appends at most length of the given src string to the string buffer
  */
-void sb_append_strn(stringbuilder* sb, const char* src, int length) {
-    int chars_remaining;
-    int chars_required;
-    int new_size;
-    
-    // <buffer size> - <zero based index of next char to write> - <space for null terminator>
-    chars_remaining = sb->size - sb->pos - 1;
-    if (chars_remaining < length)  {
-        chars_required = length - chars_remaining;
-        new_size = sb->size;
-        do {
-            new_size = new_size * 2;
-        } while (new_size < (sb->size + chars_required));
-        sb_resize(sb, new_size);
+void sb_append_strn(stringbuilder* sb, const char* src, size_t length)  {
+    if (!_make_room(sb, length))    {
+        return;
     }
     
     memcpy(sb->cstr + sb->pos, src, length);
@@ -119,19 +361,431 @@ void sb_append_str(stringbuilder* sb, const char* src)  {
  * Appends the formatted string to the given string builder
  */
 void sb_append_strf(stringbuilder* sb, const char* fmt, ...)    {
-    char *str;
     va_list arglist;
 
     va_start(arglist, fmt);
-    xp_vasprintf(&str, fmt, arglist);
+    sb_append_vstrf(sb, fmt, arglist);
     va_end(arglist);
-    
-    if (!str)   {
+}
+
+/**
+ * Appends the formatted string to the given string builder, like sb_append_strf but with a va_list
+ */
+void sb_append_vstrf(stringbuilder* sb, const char* fmt, va_list ap)    {
+    size_t chars_remaining;
+    int length;
+    va_list ap2;
+
+    // A sink at its high-water mark writes out what it holds first
+    if ((sb->flags & SB_SINK) && sb->pos >= sb->high_water)    {
+        sb_flush(sb);
+    }
+
+    // Format into whatever room is left (including the null terminator's).  The va_list is consumed by
+    // each pass, so the first works on a copy in case a second is needed
+    chars_remaining = sb->size - sb->pos;
+    va_copy(ap2, ap);
+    length = xp_vsnprintf(sb->cstr + sb->pos, chars_remaining, fmt, ap2);
+    va_end(ap2);
+
+    if (length >= 0 && (size_t)length >= chars_remaining)   {
+        // Drop the part that did fit, which a sink's flush would otherwise leave past pos
+        if ((sb->flags & (SB_SINK | SB_LAZY_NUL)) == SB_SINK)   {
+            memset(sb->cstr + sb->pos, '\0', chars_remaining);
+        }
+
+        if (!_make_room(sb, length))    {
+            length = -1;
+        } else {
+            length = xp_vsnprintf(sb->cstr + sb->pos, sb->size - sb->pos, fmt, ap);
+        }
+    }
+
+    if (length < 0) {
+        // Drop whatever part of the string did get written
+        if (sb->pos < sb->size) {
+            sb->cstr[sb->pos] = '\0';
+        }
         return;
     }
-    
-    sb_append_str(sb, str);
-    free(str);
+
+    sb->pos += length;
+}
+
+/* "00" to "99", so integers are converted two digits at a time */
+static const char _digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t _pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/**
+ * Returns the number of decimal digits in value
+ */
+static int _count_digits(uint64_t value)    {
+    int digits = 1;
+
+    while (digits < 20 && value >= _pow10[digits])  {
+        digits++;
+    }
+
+    return digits;
+}
+
+/**
+ * Writes the decimal digits of value backwards from just before "end"
+ */
+static void _write_digits(char* end, uint64_t value)    {
+    const char* pair;
+
+    while (value >= 100)    {
+        pair = _digit_pairs + (value % 100) * 2;
+        value /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+
+    if (value >= 10)    {
+        *--end = _digit_pairs[value * 2 + 1];
+        *--end = _digit_pairs[value * 2];
+    } else {
+        *--end = (char)('0' + value);
+    }
+}
+
+/**
+ * Appends the decimal digits of the given unsigned integer
+ */
+void sb_append_u64(stringbuilder* sb, uint64_t value)   {
+    int digits = _count_digits(value);
+
+    if (!_make_room(sb, digits))    {
+        return;
+    }
+
+    _write_digits(sb->cstr + sb->pos + digits, value);
+    sb->pos += digits;
+}
+
+/**
+ * Appends the decimal digits of the given integer, with a '-' if it's negative
+ */
+void sb_append_i64(stringbuilder* sb, int64_t value)    {
+    uint64_t magnitude = value < 0? 0 - (uint64_t)value : (uint64_t)value;
+    int digits = _count_digits(magnitude) + (value < 0);
+
+    if (!_make_room(sb, digits))    {
+        return;
+    }
+
+    sb->cstr[sb->pos] = '-';
+    _write_digits(sb->cstr + sb->pos + digits, magnitude);
+    sb->pos += digits;
+}
+
+/**
+ * Appends value in lowercase hexadecimal, padded with zeros to at least min_digits
+ */
+void sb_append_hex(stringbuilder* sb, uint64_t value, int min_digits)   {
+    static const char hex[] = "0123456789abcdef";
+    char* p;
+    int digits;
+
+    for (digits = 1; digits < 16 && (value >> (4 * digits)); digits++)  {
+    }
+
+    if (digits < min_digits)    {
+        digits = min_digits;
+    }
+
+    if (!_make_room(sb, digits))    {
+        return;
+    }
+
+    for (p = sb->cstr + sb->pos + digits; p > sb->cstr + sb->pos; value >>= 4)  {
+        *--p = hex[value & 0xf];
+    }
+    sb->pos += digits;
+}
+
+/*
+ * Shortest round-trip doubles, with Grisu2 (Florian Loitsch, "Printing Floating-Point Numbers Quickly
+ * and Accurately with Integers", 2010).  The digits it produces always read back as the same double,
+ * and are the shortest that do in all but a small fraction of cases: Grisu2 works within bounds a little
+ * narrower than the exact ones, so a shorter string right at their edge is passed over for a longer one
+ */
+
+/* Longest double sb_append_double writes, like "-0.0000022250738585072014" */
+#define SB_DOUBLE_CHARS     26
+
+/* A floating point number f * 2^e with a 64-bit significand */
+typedef struct  {
+    uint64_t    f;
+    int         e;
+} diy_fp;
+
+/* 10^-348, 10^-340, ..., 10^340, normalized and rounded to 64 bits */
+static const uint64_t _pow10_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t _pow10_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static diy_fp _diy_multiply(diy_fp x, diy_fp y) {
+    uint64_t a = x.f >> 32, b = x.f & 0xffffffff, c = y.f >> 32, d = y.f & 0xffffffff;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t middle = (bd >> 32) + (ad & 0xffffffff) + (bc & 0xffffffff) + (1ULL << 31);
+    diy_fp product;
+
+    // The high 64 bits of the 128-bit product, rounded
+    product.f = ac + (ad >> 32) + (bc >> 32) + (middle >> 32);
+    product.e = x.e + y.e + 64;
+    return product;
+}
+
+static diy_fp _diy_normalize(diy_fp x)  {
+    while (!(x.f & (1ULL << 63)))   {
+        x.f <<= 1;
+        x.e--;
+    }
+
+    return x;
+}
+
+/**
+ * Moves the last digit down while that brings it closer to the real value and stays inside the bounds
+ */
+static void _grisu_round(char* digits, int length, uint64_t delta, uint64_t rest, uint64_t ten_kappa,
+    uint64_t wp_w)  {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))    {
+        digits[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+/**
+ * Generates as few digits of "high" as keep it within delta of the upper bound, adjusting the decimal
+ * exponent k to match
+ */
+static void _digit_gen(diy_fp w, diy_fp high, uint64_t delta, char* digits, int* length, int* k)  {
+    uint64_t one = 1ULL << -high.e;
+    uint64_t wp_w = high.f - w.f;
+    uint32_t p1 = (uint32_t)(high.f >> -high.e);
+    uint64_t p2 = high.f & (one - 1);
+    uint64_t rest;
+    int kappa = _count_digits(p1);
+    int d;
+
+    *length = 0;
+
+    // The integer part, down to the first digit that pins the value within the bounds
+    while (kappa > 0)   {
+        d = (int)(p1 / _pow10[kappa - 1]);
+        p1 %= (uint32_t)_pow10[kappa - 1];
+        if (d || *length)   {
+            digits[(*length)++] = (char)('0' + d);
+        }
+        kappa--;
+
+        rest = ((uint64_t)p1 << -high.e) + p2;
+        if (rest <= delta)  {
+            *k += kappa;
+            _grisu_round(digits, *length, delta, rest, _pow10[kappa] << -high.e, wp_w);
+            return;
+        }
+    }
+
+    // Then the fraction
+    for (;;)    {
+        p2 *= 10;
+        delta *= 10;
+        d = (int)(p2 >> -high.e);
+        if (d || *length)   {
+            digits[(*length)++] = (char)('0' + d);
+        }
+        p2 &= one - 1;
+        kappa--;
+
+        if (p2 < delta) {
+            *k += kappa;
+            _grisu_round(digits, *length, delta, p2, one, -kappa < 20? wp_w * _pow10[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+/**
+ * Finds the digits of the positive, finite double with the given bits, so it is digits * 10^k
+ */
+static void _grisu2(uint64_t bits, char* digits, int* length, int* k)  {
+    diy_fp v, w, plus, minus, c;
+    int biased_e = (int)((bits >> 52) & 0x7ff);
+    int index, mk;
+    double dk;
+
+    v.f = bits & ((1ULL << 52) - 1);
+    if (biased_e)   {
+        v.f |= 1ULL << 52;
+        v.e = biased_e - 1075;
+    } else {
+        v.e = -1074;
+    }
+
+    // The points halfway to the doubles either side, at the same exponent.  The gap below is half as big
+    // when v is a power of 2
+    plus.f = (v.f << 1) + 1;
+    plus.e = v.e - 1;
+    plus = _diy_normalize(plus);
+    if (v.f == (1ULL << 52))    {
+        minus.f = (v.f << 2) - 1;
+        minus.e = v.e - 2;
+    } else {
+        minus.f = (v.f << 1) - 1;
+        minus.e = v.e - 1;
+    }
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    // Scale by the cached power of 10 that brings the exponent into [-60, -32]
+    dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    mk = (int)dk;
+    if (dk - mk > 0.0)  {
+        mk++;
+    }
+    index = (mk >> 3) + 1;
+    *k = -(-348 + index * 8);
+    c.f = _pow10_f[index];
+    c.e = _pow10_e[index];
+
+    w = _diy_multiply(_diy_normalize(v), c);
+    plus = _diy_multiply(plus, c);
+    minus = _diy_multiply(minus, c);
+    minus.f++;
+    plus.f--;
+    _digit_gen(w, plus, plus.f - minus.f, digits, length, k);
+}
+
+/**
+ * Writes digits * 10^k out in plain or exponent notation
+ *
+ * Returns the number of characters written
+ */
+static int _write_decimal(char* out, const char* digits, int length, int k)    {
+    int point = length + k;         // Where the decimal point goes, counting from the first digit
+    int exponent;
+    char* p = out;
+
+    if (k >= 0 && point <= 21)  {
+        memcpy(p, digits, length);
+        memset(p + length, '0', k);
+        p += point;
+    } else if (point > 0 && point <= 21)    {
+        memcpy(p, digits, point);
+        p[point] = '.';
+        memcpy(p + point + 1, digits + point, length - point);
+        p += length + 1;
+    } else if (point > -6 && point <= 0)    {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -point);
+        memcpy(p - point, digits, length);
+        p += length - point;
+    } else {
+        *p++ = digits[0];
+        if (length > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+
+        exponent = point - 1;
+        *p++ = 'e';
+        *p++ = exponent < 0? '-' : '+';
+        exponent = exponent < 0? -exponent : exponent;
+        p += _count_digits(exponent);
+        _write_digits(p, exponent);
+    }
+
+    return (int)(p - out);
+}
+
+/**
+ * Appends the shortest decimal string that reads back as exactly the same double
+ */
+void sb_append_double(stringbuilder* sb, double value)  {
+    char digits[24];
+    uint64_t bits;
+    int length, k;
+    char* p;
+
+    if (!_make_room(sb, SB_DOUBLE_CHARS))   {
+        return;
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+    p = sb->cstr + sb->pos;
+
+    if (((bits >> 52) & 0x7ff) == 0x7ff)    {
+        // Infinite if there are no significand bits, NaN otherwise
+        if (bits & ((1ULL << 52) - 1))  {
+            memcpy(p, "nan", 3);
+            sb->pos += 3;
+        } else {
+            memcpy(p, bits >> 63? "-inf" : "inf", 4);
+            sb->pos += bits >> 63? 4 : 3;
+        }
+        return;
+    }
+
+    if (bits >> 63) {
+        *p++ = '-';
+    }
+
+    if ((bits << 1) == 0)   {
+        *p++ = '0';
+    } else {
+        _grisu2(bits & ~(1ULL << 63), digits, &length, &k);
+        p += _write_decimal(p, digits, length, k);
+    }
+
+    sb->pos = (size_t)(p - sb->cstr);
 }
 
 /**
@@ -145,7 +799,8 @@ char* sb_make_cstring(stringbuilder* sb)    {
     }
     
     out = (char*)malloc(sb->pos + 1);
-    strcpy(out, sb_cstring(sb));
+    memcpy(out, sb->cstr, sb->pos);
+    out[sb->pos] = '\0';
     
     return out;
 }
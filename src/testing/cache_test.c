@@ -0,0 +1,203 @@
+#include "test_utils.h"
+#include "platform.h"
+#include "cache.h"
+
+static char _evicted[256];
+
+/**
+ * Eviction callback, records the order values were evicted in
+ */
+static void _destroy(void* data)    {
+    strcat(_evicted, (char*)data);
+    strcat(_evicted, " ");
+    free(data);
+}
+
+static int _put(cache* c, const char* value, size_t cost)    {
+    return cache_put_cost(c, xp_strdup(value), cost);
+}
+
+static int _get(cache* c, const char* value)    {
+    void* data = (void*)value;
+
+    return cache_get(c, &data);
+}
+
+/**
+ * A cache of three values, with "a" used after all three were added
+ */
+static int _test_policy(int policy, const char* expected)   {
+    cache c;
+
+    if (cache_init(&c, 3, policy, 0, 0, _destroy) != 0) {
+        fprintf(stderr, "Cache not initialized\n");
+        return -1;
+    }
+
+    _evicted[0] = 0;
+    _put(&c, "a", 1);
+    _put(&c, "b", 1);
+    _put(&c, "c", 1);
+    if (_get(&c, "a") != 0 || _get(&c, "z") != -1)  {
+        fprintf(stderr, "Lookups before eviction are wrong\n");
+        return -1;
+    }
+
+    _put(&c, "d", 1);
+    _put(&c, "e", 1);
+    _get(&c, "d");
+    _put(&c, "f", 1);
+
+    if (strcmp(_evicted, expected) || cache_size(&c) != 3 || c.evictions != 3 || c.hits != 2 || c.misses != 1)  {
+        fprintf(stderr, "Evicted \"%s\", expected \"%s\"\n", _evicted, expected);
+        return -1;
+    }
+
+    cache_destroy(&c);
+    return 0;
+}
+
+/**
+ * Byte costs, replacing a value and removing one
+ */
+static int _test_costs()    {
+    void* data;
+    cache c;
+
+    if (cache_init(&c, 100, CACHE_LRU, 0, 0, _destroy) != 0)   {
+        fprintf(stderr, "Cache not initialized\n");
+        return -1;
+    }
+
+    _evicted[0] = 0;
+    _put(&c, "a", 60);
+    _put(&c, "b", 30);
+    if (cache_put_cost(&c, "huge", 101) != -1 || c.used != 90)   {
+        fprintf(stderr, "A value larger than the cache was accepted\n");
+        return -1;
+    }
+
+    /* "b" is the least recently used, but both have to go to fit 80 */
+    _get(&c, "b");
+    _put(&c, "c", 80);
+    if (strcmp(_evicted, "a b ") || c.used != 80 || cache_size(&c) != 1)    {
+        fprintf(stderr, "Evicted \"%s\" with %d bytes used\n", _evicted, (int)c.used);
+        return -1;
+    }
+
+    /* Replacing a value destroys the old one and takes the new cost */
+    _evicted[0] = 0;
+    if (_put(&c, "c", 10) != 1 || strcmp(_evicted, "c ") || c.used != 10 || cache_size(&c) != 1)   {
+        fprintf(stderr, "Replacing a value went wrong\n");
+        return -1;
+    }
+
+    data = "c";
+    if (cache_remove(&c, &data) != 0 || data == (void*)"c" || c.used != 0 || cache_size(&c) != 0)    {
+        fprintf(stderr, "Removing a value went wrong\n");
+        return -1;
+    }
+    free(data);
+
+    if (_get(&c, "c") != -1)    {
+        fprintf(stderr, "Removed value was found\n");
+        return -1;
+    }
+
+    cache_destroy(&c);
+    return 0;
+}
+
+/**
+ * Replacing a value with a larger cost under CLOCK, where the hand mustn't come back round to the value
+ * being replaced: "b" is evicted to make room, then the old "a" destroyed
+ */
+static int _test_clock_replace()    {
+    cache c;
+
+    if (cache_init(&c, 10, CACHE_CLOCK, 0, 0, _destroy) != 0)   {
+        fprintf(stderr, "Cache not initialized\n");
+        return -1;
+    }
+
+    _evicted[0] = 0;
+    _put(&c, "a", 5);
+    _put(&c, "b", 5);
+    _get(&c, "b");
+    if (_put(&c, "a", 10) != 1 || strcmp(_evicted, "b a ") || c.used != 10 || cache_size(&c) != 1 ||
+        _get(&c, "a") != 0 || _get(&c, "b") != -1) {
+        fprintf(stderr, "Replacing under CLOCK evicted \"%s\" with %d bytes used\n", _evicted, (int)c.used);
+        return -1;
+    }
+
+    cache_destroy(&c);
+    return 0;
+}
+
+/**
+ * Lots of values through a small cache, which also reuses entries from evictions
+ */
+static int _test_churn(int policy)  {
+    char key[32];
+    cache c;
+    int i;
+
+    if (cache_init(&c, 100, policy, 0, 0, free) != 0)   {
+        fprintf(stderr, "Cache not initialized\n");
+        return -1;
+    }
+
+    for (i = 0; i < 10000; i++) {
+        sprintf(key, "key%d", i);
+        if (_put(&c, key, 1) != 0 || _get(&c, key) != 0)  {
+            fprintf(stderr, "Error caching %s\n", key);
+            return -1;
+        }
+
+        sprintf(key, "key%d", i / 2);
+        _get(&c, key);
+    }
+
+    if (cache_size(&c) != 100 || c.evictions != 9900 || ht_size(&c.index) != 100)  {
+        fprintf(stderr, "Cache holds %d values after %lu evictions\n", cache_size(&c), c.evictions);
+        return -1;
+    }
+
+    cache_destroy(&c);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    /* LRU: "b" is oldest once "a" is used, then "c", and "a" once "d" is used after "e" was added */
+    if (_test_policy(CACHE_LRU, "b c a ") != 0) {
+        fprintf(stderr, "LRU policy failed\n");
+        return -1;
+    }
+
+    /* CLOCK: the hand clears "a" and takes "b", then "c", then passes "a" (cleared) and takes it */
+    if (_test_policy(CACHE_CLOCK, "b c a ") != 0)   {
+        fprintf(stderr, "CLOCK policy failed\n");
+        return -1;
+    }
+
+    if (_test_costs() != 0) {
+        fprintf(stderr, "Costs failed\n");
+        return -1;
+    }
+
+    if (_test_clock_replace() != 0) {
+        fprintf(stderr, "CLOCK replacement failed\n");
+        return -1;
+    }
+
+    if (_test_churn(CACHE_LRU) != 0 || _test_churn(CACHE_CLOCK) != 0)   {
+        fprintf(stderr, "Churn failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "test_utils.h"
+#include "platform.h"
+#include "chashtable.h"
+
+#define THREADS     4
+#define KEYS        20000
+
+static int _keys[KEYS * 2];
+static chashtable _cht;
+static atomic_int _writers_done;
+
+static int _hash(const void* key)   {
+    return *(const int*)key;
+}
+
+static int _match(const void* key1, const void* key2)   {
+    return *(const int*)key1 == *(const int*)key2;
+}
+
+/**
+ * Single threaded checks of the ht_* style return conventions
+ */
+static int _test_api()  {
+    chashtable cht;
+    char key[32];
+    void* data;
+    int i, buckets;
+
+    if (cht_init(&cht, 16, 0, 0, free) != 0)    {
+        fprintf(stderr, "Concurrent hashtable not initialized\n");
+        return -1;
+    }
+
+    buckets = cht_buckets(&cht);
+    for (i = 0; i < 5000; i++)  {
+        sprintf(key, "key%d", i);
+        if (cht_insert(&cht, xp_strdup(key)) != 0)  {
+            fprintf(stderr, "Error inserting %s\n", key);
+            return -1;
+        }
+    }
+
+    data = "key42";
+    if (cht_insert_or_get(&cht, &data) != 1 || data == (void*)"key42" || strcmp((char*)data, "key42"))    {
+        fprintf(stderr, "Duplicate insert was not detected\n");
+        return -1;
+    }
+
+    for (i = 0; i < 5000; i += 2)   {
+        sprintf(key, "key%d", i);
+        data = key;
+        if (cht_remove(&cht, &data) != 0 || data == (void*)key || strcmp((char*)data, key))   {
+            fprintf(stderr, "Error removing %s\n", key);
+            return -1;
+        }
+        cht_retire(data, free);
+    }
+
+    for (i = 0; i < 5000; i++)  {
+        sprintf(key, "key%d", i);
+        data = key;
+        if (cht_lookup(&cht, &data) != (i % 2? 0 : -1) || (i % 2 && data == (void*)key))    {
+            fprintf(stderr, "Lookup of %s is wrong\n", key);
+            return -1;
+        }
+    }
+
+    if (cht_size(&cht) != 2500 || cht_buckets(&cht) <= buckets) {
+        fprintf(stderr, "Table holds %d values in %d buckets, should be 2500\n", cht_size(&cht), cht_buckets(&cht));
+        return -1;
+    }
+
+    /* Emptied, every segment shrinks back to the size it started at */
+    for (i = 1; i < 5000; i += 2)   {
+        sprintf(key, "key%d", i);
+        data = key;
+        if (cht_remove(&cht, &data) != 0)   {
+            fprintf(stderr, "Error removing %s\n", key);
+            return -1;
+        }
+        cht_retire(data, free);
+    }
+
+    if (cht_size(&cht) != 0 || cht_buckets(&cht) != buckets)   {
+        fprintf(stderr, "Emptied table has %d buckets, should be %d\n", cht_buckets(&cht), buckets);
+        return -1;
+    }
+
+    cht_destroy(&cht);
+    return 0;
+}
+
+/**
+ * Keeps inserting and removing its own range of keys, growing and shrinking the segments as it goes
+ */
+static void* _writer(void* arg) {
+    int id = (int)(intptr_t)arg;
+    int round, i;
+    void* data;
+
+    for (round = 0; round < 3; round++) {
+        for (i = KEYS + id; i < KEYS * 2; i += THREADS) {
+            cht_insert(&_cht, &_keys[i]);
+        }
+        for (i = KEYS + id; i < KEYS * 2; i += THREADS) {
+            data = &_keys[i];
+            if (cht_remove(&_cht, &data) != 0 || data != &_keys[i]) {
+                fprintf(stderr, "Writer %d could not remove %d\n", id, i);
+                return (void*)1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Looks up the keys that are never removed while the writers work.  Every one of them must be found
+ * every time, no matter how the segments are being resized underneath
+ */
+static void* _reader(void* arg) {
+    int i, misses;
+    void* data;
+
+    misses = 0;
+    (void)arg;
+    while (!_writers_done)  {
+        for (i = 0; i < KEYS; i += 7)   {
+            data = &i;
+            if (cht_lookup(&_cht, &data) != 0 || data != &_keys[i]) {
+                misses++;
+            }
+        }
+    }
+
+    return (void*)(intptr_t)misses;
+}
+
+static int _test_threads()  {
+    pthread_t writers[THREADS], readers[THREADS];
+    void* result;
+    int i, failed;
+
+    for (i = 0; i < KEYS * 2; i++)  {
+        _keys[i] = i;
+    }
+
+    if (cht_init(&_cht, 16, _hash, _match, 0) != 0) {
+        fprintf(stderr, "Concurrent hashtable not initialized\n");
+        return -1;
+    }
+
+    for (i = 0; i < KEYS; i++)  {
+        cht_insert(&_cht, &_keys[i]);
+    }
+
+    _writers_done = 0;
+    for (i = 0; i < THREADS; i++)   {
+        pthread_create(&readers[i], 0, _reader, 0);
+        pthread_create(&writers[i], 0, _writer, (void*)(intptr_t)i);
+    }
+
+    failed = 0;
+    for (i = 0; i < THREADS; i++)   {
+        pthread_join(writers[i], &result);
+        failed |= result != 0;
+    }
+
+    _writers_done = 1;
+    for (i = 0; i < THREADS; i++)   {
+        pthread_join(readers[i], &result);
+        if (result) {
+            fprintf(stderr, "Reader %d missed %d lookups\n", i, (int)(intptr_t)result);
+            failed = 1;
+        }
+    }
+
+    if (failed || cht_size(&_cht) != KEYS)  {
+        fprintf(stderr, "Table holds %d values, should be %d\n", cht_size(&_cht), KEYS);
+        return -1;
+    }
+
+    cht_destroy(&_cht);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    if (_test_api() != 0)   {
+        fprintf(stderr, "Single threaded use failed\n");
+        return -1;
+    }
+
+    if (_test_threads() != 0)   {
+        fprintf(stderr, "Multi-threaded use failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
@@ -0,0 +1,165 @@
+#include "test_utils.h"
+#include "platform.h"
+#include "hashtable_gen.h"
+
+/* Looking up a key in a table straight after initializing it, GCC can't see that the zeroed control bytes
+   keep the (never written) keys from being read, and warns that they may be used uninitialized */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+HT_DECLARE(u64_table, uint64_t, int, ht_gen_hash_u64, ht_gen_eq_u64)
+HT_DECLARE(str_table, const char*, int, ht_gen_hash_str, ht_gen_eq_str)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#define KEYS    5000
+
+/**
+ * Puts, replaces, looks up and removes integer keys, checking the table against a plain array
+ */
+static int _test_u64()  {
+    static int present[KEYS];
+    u64_table t;
+    int i, n, val, size;
+    uint64_t key;
+    int* found;
+
+    if (u64_table_init(&t, 0) != 0) {
+        fprintf(stderr, "Table not initialized\n");
+        return -1;
+    }
+
+    if (u64_table_get(&t, 7) != 0 || u64_table_remove(&t, 7, 0) != -1 || u64_table_next(&t, 0) != -1)  {
+        fprintf(stderr, "Empty table returned a value\n");
+        return -1;
+    }
+
+    /* Keys are spread over the whole 64 bits, the table has to grow many times along the way */
+    size = 0;
+    for (i = 0; i < KEYS * 4; i++)  {
+        n = (i * 7919) % KEYS;
+        key = (uint64_t)n * 0x9e3779b97f4a7c15ULL;
+        if (i % 3 == 2) {
+            if (u64_table_remove(&t, key, &val) != (present[n]? 0 : -1) || (present[n] && val != n))  {
+                fprintf(stderr, "Error removing %d\n", n);
+                return -1;
+            }
+            size -= present[n];
+            present[n] = 0;
+        } else {
+            if (u64_table_put(&t, key, n) != present[n])    {
+                fprintf(stderr, "Error putting %d\n", n);
+                return -1;
+            }
+            size += !present[n];
+            present[n] = 1;
+        }
+    }
+
+    if (t.size != size)   {
+        fprintf(stderr, "Table holds %d values, should be %d\n", t.size, size);
+        return -1;
+    }
+
+    for (n = 0; n < KEYS; n++)  {
+        found = u64_table_get(&t, (uint64_t)n * 0x9e3779b97f4a7c15ULL);
+        if ((found != 0) != present[n] || (found && *found != n))   {
+            fprintf(stderr, "Lookup of %d is wrong\n", n);
+            return -1;
+        }
+    }
+
+    n = 0;
+    for (i = u64_table_next(&t, 0); i >= 0; i = u64_table_next(&t, i + 1))  {
+        if (t.keys[i] != (uint64_t)t.vals[i] * 0x9e3779b97f4a7c15ULL)  {
+            fprintf(stderr, "Slot %d holds a mismatched entry\n", i);
+            return -1;
+        }
+        n++;
+    }
+
+    if (n != size)  {
+        fprintf(stderr, "Walked %d values, table holds %d\n", n, size);
+        return -1;
+    }
+
+    u64_table_destroy(&t);
+    return 0;
+}
+
+/**
+ * String keys are compared by content, not by pointer
+ */
+static int _test_str()  {
+    static char* keys[KEYS];
+    str_table t;
+    char key[32];
+    int i;
+    int* found;
+
+    if (str_table_init(&t, KEYS) != 0) {
+        fprintf(stderr, "Table not initialized\n");
+        return -1;
+    }
+
+    for (i = 0; i < KEYS; i++)  {
+        sprintf(key, "key%d", i);
+        keys[i] = xp_strdup(key);
+        if (str_table_put(&t, keys[i], i) != 0)   {
+            fprintf(stderr, "Error putting %s\n", key);
+            return -1;
+        }
+    }
+
+    if (t.slots != 8192)    {
+        fprintf(stderr, "Table with room for %d values has %d slots\n", KEYS, t.slots);
+        return -1;
+    }
+
+    for (i = 0; i < KEYS; i++)  {
+        sprintf(key, "key%d", i);
+        if ((found = str_table_get(&t, key)) == 0 || *found != i)   {
+            fprintf(stderr, "Lookup of %s failed\n", key);
+            return -1;
+        }
+
+        if (i % 2 == 0 && str_table_remove(&t, key, 0) != 0)  {
+            fprintf(stderr, "Error removing %s\n", key);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < KEYS; i++)  {
+        sprintf(key, "key%d", i);
+        if ((str_table_get(&t, key) != 0) != (i % 2))   {
+            fprintf(stderr, "Lookup of %s is wrong after removing\n", key);
+            return -1;
+        }
+    }
+
+    str_table_destroy(&t);
+    for (i = 0; i < KEYS; i++)  {
+        free(keys[i]);
+    }
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    if (_test_u64() != 0)   {
+        fprintf(stderr, "uint64_t table failed\n");
+        return -1;
+    }
+
+    if (_test_str() != 0)   {
+        fprintf(stderr, "String table failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
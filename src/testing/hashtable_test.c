@@ -2,11 +2,16 @@
 #include "platform.h"
 #include "hashtable.h"
 
+static int _hash_calls;
+static int _match_calls;
+
 static int _hash(const void* key)  {
+    _hash_calls++;
     return ht_hashpjw((char*)key);
 }
 
 static int _match(const void* key1, const void* key2)  {
+    _match_calls++;
     return !strcmp((char*)key1, (char*)key2);
 }
 
@@ -14,12 +19,368 @@ static void _destroy(void *data)   {
     free((char*)data);
 }
 
-DEFINE_TEST_FUNCTION {  
+/**
+ * Inserts, looks up and removes enough keys to force collisions (and, for the open engine, several
+ * resizes and backward shifts), checking the table against what we expect at every step
+ */
+static int _stress(hashtable* ht, int count)   {
+    char key[32];
+    void* data;
+    int i, expected;
+    
+    expected = ht_size(ht) + count - (count + 2) / 3;
+    for (i = 0; i < count; i++)  {
+        sprintf(key, "key%d", i);
+        if (ht_insert(ht, (void*)xp_strdup(key)) != 0)  {
+            fprintf(stderr, "Error inserting %s\n", key);
+            return -1;
+        }
+    }
+    
+    sprintf(key, "key%d", 0);
+    if (ht_insert(ht, (void*)key) != 1)  {
+        fprintf(stderr, "Duplicate insert of %s not detected\n", key);
+        return -1;
+    }
+    
+    /* Remove every third key */
+    for (i = 0; i < count; i += 3)  {
+        sprintf(key, "key%d", i);
+        data = key;
+        if (ht_remove(ht, &data) != 0 || data == key || strcmp((char*)data, key))  {
+            fprintf(stderr, "Error removing %s\n", key);
+            return -1;
+        }
+        free(data);
+    }
+    
+    for (i = 0; i < count; i++)  {
+        sprintf(key, "key%d", i);
+        data = key;
+        if ((ht_lookup(ht, &data) == 0) != (i % 3 != 0))    {
+            fprintf(stderr, "Lookup of %s returned the wrong result\n", key);
+            return -1;
+        }
+        
+        if (i % 3 != 0 && (data == key || strcmp((char*)data, key)))  {
+            fprintf(stderr, "Lookup of %s returned the wrong value\n", key);
+            return -1;
+        }
+    }
+    
+    if (ht_size(ht) != expected)   {
+        fprintf(stderr, "Size is %d after removals, should be %d\n", ht_size(ht), expected);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/**
+ * Removes the keys left over by _stress and checks that the table grew while they were there and
+ * shrinks back down once they are gone
+ */
+static int _drain(hashtable* ht, int count, int min_buckets)    {
+    char key[32];
+    void* data;
+    int buckets, rehash_index;
+    int i;
+    
+    if (ht->buckets <= min_buckets)   {
+        fprintf(stderr, "Table did not grow past %d buckets\n", min_buckets);
+        return -1;
+    }
+    
+    for (i = 0; i < count; i++)  {
+        if (i % 3 == 0) {
+            continue;
+        }
+        
+        sprintf(key, "key%d", i);
+        data = key;
+        if (ht_remove(ht, &data) != 0)  {
+            fprintf(stderr, "Error draining %s\n", key);
+            return -1;
+        }
+        free(data);
+        
+        /* Removing a key that isn't there leaves the table, and any resize in progress, alone */
+        buckets = ht->buckets;
+        rehash_index = ht->rehash_index;
+        data = "missing";
+        if (ht_remove(ht, &data) != -1 || ht->buckets != buckets || ht->rehash_index != rehash_index) {
+            fprintf(stderr, "Removing a missing key resized the table\n");
+            return -1;
+        }
+    }
+    
+    /* Shrinking is incremental, add and remove a value a few more times to give it the operations to finish */
+    for (i = 0; i < 1000; i++)  {
+        data = "scratch";
+        if (ht_insert(ht, data) != 0 || ht_remove(ht, &data) != 0)  {
+            fprintf(stderr, "Error adding and removing a value while draining\n");
+            return -1;
+        }
+    }
+    
+    if (ht->buckets != min_buckets || ht->rehash_index >= 0)  {
+        fprintf(stderr, "Table has %d buckets after draining, should be %d\n", ht->buckets, min_buckets);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/**
+ * ht_foreach callback that counts the values it is given, stopping once the count reaches "limit"
+ */
+static int _count(void* data, void* arg)    {
+    int* counter = (int*)arg;
+    
+    (void)data;
+    return ++counter[0] == counter[1]? 1 : 0;
+}
+
+/**
+ * Counts the values in the table with a cursor, ht_foreach and HT_FOREACH and checks that they agree
+ */
+static int _count_all(hashtable* ht)    {
+    hashtable_cursor c;
+    int counter[2], i;
+    void* value;
+    
+    i = 0;
+    HT_FOREACH(ht, c, value) {
+        if (!value) {
+            fprintf(stderr, "Cursor returned a NULL value\n");
+            return -1;
+        }
+        i++;
+    }
+    
+    counter[0] = 0;
+    counter[1] = -1;
+    if (ht_foreach(ht, _count, counter) != 0 || counter[0] != i || i != ht_size(ht))    {
+        fprintf(stderr, "Cursor counted %d, foreach %d, table holds %d\n", i, counter[0], ht_size(ht));
+        return -1;
+    }
+    
+    return 0;
+}
+
+/**
+ * Checks cursor iteration while the table grows and shrinks, so that resizes are caught in progress,
+ * and that stopping early works
+ */
+static int _test_cursor(int engine) {
+    hashtable ht;
+    hashtable_cursor c;
+    int counter[2], i;
+    char key[32];
+    void* value;
+    
+    if (ht_init_engine(&ht, engine, 8, _hash, _match, _destroy) != 0)  {
+        fprintf(stderr, "Hashtable not initialized\n");
+        return -1;
+    }
+    
+    if (ht_cursor_begin(&ht, &c) != -1 || !c.end || ht_cursor_next(&c) != -1)    {
+        fprintf(stderr, "Cursor on an empty table should be at the end\n");
+        return -1;
+    }
+    
+    for (i = 0; i < 300; i++)   {
+        sprintf(key, "cursor%d", i);
+        ht_insert(&ht, xp_strdup(key));
+        if (_count_all(&ht) != 0)   {
+            return -1;
+        }
+    }
+    
+    /* Breaking out of the loop early leaves nothing to clean up */
+    i = 0;
+    HT_FOREACH(&ht, c, value)    {
+        if (++i == 10)  {
+            break;
+        }
+    }
+    
+    counter[0] = 0;
+    counter[1] = 10;
+    if (i != 10 || c.end || ht_foreach(&ht, _count, counter) != 1 || counter[0] != 10)    {
+        fprintf(stderr, "Early stop visited %d and %d values\n", i, counter[0]);
+        return -1;
+    }
+    
+    for (i = 0; i < 300; i++)   {
+        sprintf(key, "cursor%d", i);
+        value = key;
+        if (ht_remove(&ht, &value) != 0)    {
+            fprintf(stderr, "Error removing %s\n", key);
+            return -1;
+        }
+        free(value);
+        if (_count_all(&ht) != 0)   {
+            return -1;
+        }
+    }
+    
+    ht_destroy(&ht);
+    return 0;
+}
+
+/**
+ * Inserts and looks up keys in batches (with a duplicate inside each batch and keys that are missing)
+ * while the table resizes, checking every status against the single key functions' conventions
+ */
+static int _test_batch(int engine)  {
+    static char keys[1000][16], probes[1000][16];
+    void* data[1000];
+    int status[1000];
+    hashtable ht;
+    int i, n;
+    
+    if (ht_init_engine(&ht, engine, 8, 0, 0, 0) != 0)  {
+        fprintf(stderr, "Hashtable not initialized\n");
+        return -1;
+    }
+    
+    /* Every 10th value repeats the one before it */
+    for (i = 0; i < 1000; i++)  {
+        sprintf(keys[i], "batch%d", i % 10 == 9? i - 1 : i);
+        data[i] = keys[i];
+    }
+    
+    if ((n = ht_insert_batch(&ht, data, status, 1000)) != 900 || ht_size(&ht) != 900)   {
+        fprintf(stderr, "Batch inserted %d values, table holds %d\n", n, ht_size(&ht));
+        return -1;
+    }
+    
+    for (i = 0; i < 1000; i++)  {
+        if (status[i] != (i % 10 == 9) || data[i] != (void*)keys[i % 10 == 9? i - 1 : i])  {
+            fprintf(stderr, "Batch insert of %s returned %d\n", keys[i], status[i]);
+            return -1;
+        }
+    }
+    
+    /* Odd keys are missing, and for the keys found data must point at the stored value */
+    for (i = 0; i < 1000; i++)  {
+        sprintf(probes[i], i % 2? "missing%d" : "batch%d", i);
+        data[i] = probes[i];
+    }
+    
+    if ((n = ht_lookup_batch(&ht, data, status, 1000)) != 500)  {
+        fprintf(stderr, "Batch lookup found %d keys\n", n);
+        return -1;
+    }
+    
+    for (i = 0; i < 1000; i++)  {
+        if (status[i] != (i % 2? -1 : 0) || data[i] != (void*)(i % 2? probes[i] : keys[i]))   {
+            fprintf(stderr, "Batch lookup of %s returned %d\n", probes[i], status[i]);
+            return -1;
+        }
+    }
+    
+    ht_destroy(&ht);
+    return 0;
+}
+
+/**
+ * Checks that each operation hashes its key once and that stored hashes keep match from being called
+ * on values that can't be equal
+ */
+static int _test_calls(hashtable* ht)   {
+    void* data;
+    
+    _hash_calls = _match_calls = 0;
+    data = "Hello";
+    if (ht_insert_or_get(ht, &data) != 1 || data == (void*)"Hello" || strcmp((char*)data, "Hello"))  {
+        fprintf(stderr, "Insert-or-get did not return the existing value\n");
+        return -1;
+    }
+    
+    if (_hash_calls != 1 || _match_calls != 1)  {
+        fprintf(stderr, "Insert-or-get made %d hash and %d match calls, should be 1 and 1\n", _hash_calls, _match_calls);
+        return -1;
+    }
+    
+    _hash_calls = _match_calls = 0;
+    data = "Goodbye";
+    if (ht_lookup(ht, &data) == 0 || _hash_calls != 1 || _match_calls != 0)  {
+        fprintf(stderr, "Missed lookup made %d hash and %d match calls, should be 1 and 0\n", _hash_calls, _match_calls);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/**
+ * Sanity checks for the default hash: it must be deterministic for a given seed, depend on the seed and
+ * on every byte, and work on keys that aren't NUL terminated
+ */
+static int _test_hash() {
+    char buf[256], key[32];
+    uint64_t h1, h2;
+    hashtable ht;
+    void* data;
+    int i;
+    
+    for (i = 0; i < (int)sizeof(buf); i++)   {
+        buf[i] = 'a' + i % 26;
+    }
+    
+    for (i = 0; i < (int)sizeof(buf); i++)   {
+        h1 = ht_hash_bytes(buf, i, 42);
+        if (h1 != ht_hash_bytes(buf, i, 42) || h1 == ht_hash_bytes(buf, i, 43))    {
+            fprintf(stderr, "Hash of length %d is not stable or ignores the seed\n", i);
+            return -1;
+        }
+        
+        if (i > 0)  {
+            buf[i - 1] ^= 1;
+            h2 = ht_hash_bytes(buf, i, 42);
+            buf[i - 1] ^= 1;
+            if (h1 == h2)   {
+                fprintf(stderr, "Hash of length %d ignores its last byte\n", i);
+                return -1;
+            }
+        }
+    }
+    
+    if (ht_hash_str("metric.name", 7) != ht_hash_bytes("metric.name.suffix", 11, 7))    {
+        fprintf(stderr, "String and length-aware hashes disagree\n");
+        return -1;
+    }
+    
+    /* A table with the default (seeded) hash */
+    if (ht_init_engine(&ht, HT_ENGINE_OPEN, 0, 0, 0, free) != 0)  {
+        return -1;
+    }
+    
+    for (i = 0; i < 1000; i++)  {
+        sprintf(key, "service.requests.%d", i);
+        ht_insert(&ht, xp_strdup(key));
+    }
+    
+    sprintf(key, "service.requests.%d", 500);
+    data = key;
+    if (ht_size(&ht) != 1000 || ht_lookup(&ht, &data) != 0 || data == key || ht_set_seed(&ht, 0) == 0)    {
+        fprintf(stderr, "Table with the default hash is broken\n");
+        return -1;
+    }
+    
+    ht_destroy(&ht);
+    return 0;
+}
+
+static int _test_engine(int engine)    {
+    static const char* greeting[] = { "Hello", ",", " ", "World" };
     hashtable_iter* iter;
     hashtable* ht = (hashtable*)malloc(sizeof(hashtable));
+    void* data;
     int i;
     
-    if (ht_init(ht, 17, _hash, _match, _destroy) != 0) {
+    if (ht_init_engine(ht, engine, 17, _hash, _match, _destroy) != 0) {
         fprintf(stderr, "Hashtable not initialized\n");
         return -1;
     }
@@ -72,7 +433,88 @@ DEFINE_TEST_FUNCTION {
         return -1;
     }
     
+    if (_test_calls(ht) != 0)   {
+        return -1;
+    }
+    
+    if (ht_set_load_factors(ht, 1.0f, 0.6f) == 0 || ht_set_load_factors(ht, 0.0f, 0.0f) == 0)    {
+        fprintf(stderr, "Invalid load factors accepted\n");
+        return -1;
+    }
+    
+    if (_stress(ht, 5000) != 0)  {
+        return -1;
+    }
+    
+    /* Iteration must visit every remaining item exactly once */
+    i = 0;
+    iter = ht_iter_begin(ht);
+    while (iter)    {
+        iter = ht_iter_next(iter);
+        i++;
+    }
+    if (i != ht_size(ht))   {
+        fprintf(stderr, "Iterated over %d items, table holds %d\n", i, ht_size(ht));
+        return -1;
+    }
+    
+    /* The first four values go too, so that draining can shrink the table all the way back down */
+    for (i = 0; i < 4; i++) {
+        data = (void*)greeting[i];
+        if (ht_remove(ht, &data) != 0)  {
+            fprintf(stderr, "Error removing \"%s\"\n", greeting[i]);
+            return -1;
+        }
+        free(data);
+    }
+    
+    if (_drain(ht, 5000, ht->min_buckets) != 0)    {
+        return -1;
+    }
+    
+    /* A reserved table must take all of its values without resizing */
+    if (ht_reserve(ht, 1000) != 0)  {
+        fprintf(stderr, "Reserve failed\n");
+        return -1;
+    }
+    
+    i = ht->buckets;
+    if (_stress(ht, 1000) != 0 || ht->buckets != i)    {
+        fprintf(stderr, "Reserved table resized from %d to %d buckets\n", i, ht->buckets);
+        return -1;
+    }
+    
     ht_destroy(ht);
+    free(ht);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {  
+    if (_test_hash() != 0)  {
+        fprintf(stderr, "Default hash failed\n");
+        return -1;
+    }
+    
+    if (_test_engine(HT_ENGINE_CHAINED) != 0)    {
+        fprintf(stderr, "Chained engine failed\n");
+        return -1;
+    }
+    
+    if (_test_engine(HT_ENGINE_OPEN) != 0)  {
+        fprintf(stderr, "Open addressing engine failed\n");
+        return -1;
+    }
+    
+    if (_test_cursor(HT_ENGINE_CHAINED) != 0 || _test_cursor(HT_ENGINE_OPEN) != 0)  {
+        fprintf(stderr, "Cursor iteration failed\n");
+        return -1;
+    }
+    
+    if (_test_batch(HT_ENGINE_CHAINED) != 0 || _test_batch(HT_ENGINE_OPEN) != 0)    {
+        fprintf(stderr, "Batch operations failed\n");
+        return -1;
+    }
+    
     return 0;
 }
 
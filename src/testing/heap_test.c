@@ -0,0 +1,256 @@
+#include "test_utils.h"
+#include "platform.h"
+#include "heap.h"
+
+#define COUNT   2000
+
+static int _keys[COUNT];
+
+static int _compare(const void* key1, const void* key2) {
+    int a = *(const int*)key1, b = *(const int*)key2;
+
+    return a < b? -1 : a > b;
+}
+
+/**
+ * Checks every node comes out no later than its children, and every handle points at its value
+ */
+static int _check(heap* h)  {
+    int i;
+
+    for (i = 1; i < heap_size(h); i++)  {
+        if (_compare(h->entries[(i - 1) / HEAP_ARITY].data, h->entries[i].data) > 0)    {
+            fprintf(stderr, "Node %d comes out before its parent\n", i);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < heap_size(h); i++)  {
+        if (h->positions[h->entries[i].handle] != i)    {
+            fprintf(stderr, "Handle %d doesn't point at node %d\n", h->entries[i].handle, i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Pops everything, checking the values come out in order and there are "count" of them
+ */
+static int _drain(heap* h, int count)   {
+    int* data;
+    int last = -1, n = 0;
+
+    while (heap_pop(h, (void**)&data) == 0) {
+        if (*data < last)   {
+            fprintf(stderr, "%d came out after %d\n", *data, last);
+            return -1;
+        }
+        last = *data;
+        n++;
+    }
+
+    if (n != count || heap_size(h) != 0 || heap_peek(h) != 0)   {
+        fprintf(stderr, "%d values came out, should be %d\n", n, count);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Pushes and pops, with handles reused along the way
+ */
+static int _test_push_pop() {
+    int handles[COUNT];
+    int* data;
+    heap h;
+    int i;
+
+    if (heap_init(&h, 0, 0, 0) != -1 || heap_init(&h, 0, _compare, 0) != 0 || heap_pop(&h, (void**)&data) != -1) {
+        fprintf(stderr, "Bad initialization\n");
+        return -1;
+    }
+
+    for (i = 0; i < COUNT; i++) {
+        _keys[i] = rand() % 500;
+        if ((handles[i] = heap_push(&h, &_keys[i])) != i || heap_data(&h, i) != &_keys[i])  {
+            fprintf(stderr, "Push %d got handle %d\n", i, handles[i]);
+            return -1;
+        }
+    }
+
+    if (_check(&h) != 0 || heap_size(&h) != COUNT) {
+        return -1;
+    }
+
+    // Pop half, then push them back, which should take the freed handles rather than new ones
+    for (i = 0; i < COUNT / 2; i++) {
+        heap_pop(&h, (void**)&data);
+    }
+    for (i = 0; i < COUNT / 2; i++) {
+        if (heap_push(&h, &_keys[i]) >= COUNT)  {
+            fprintf(stderr, "Freed handles weren't reused\n");
+            return -1;
+        }
+    }
+
+    if (_check(&h) != 0 || _drain(&h, COUNT) != 0)  {
+        return -1;
+    }
+
+    heap_destroy(&h);
+    return 0;
+}
+
+/**
+ * Changing priorities and removing values by handle
+ */
+static int _test_handles()  {
+    int handles[COUNT];
+    int* data;
+    heap h;
+    int i;
+
+    heap_init(&h, 16, _compare, 0);
+    for (i = 0; i < COUNT; i++) {
+        _keys[i] = 1000 + rand() % 1000;
+        handles[i] = heap_push(&h, &_keys[i]);
+    }
+
+    // Decrease every third key below everything else, and increase every fifth
+    for (i = 0; i < COUNT; i += 3)  {
+        _keys[i] -= 1000;
+        if (heap_update(&h, handles[i], &_keys[i]) != 0)    {
+            fprintf(stderr, "Couldn't update handle %d\n", handles[i]);
+            return -1;
+        }
+    }
+    for (i = 1; i < COUNT; i += 5)  {
+        _keys[i] += 1000;
+        heap_update(&h, handles[i], &_keys[i]);
+    }
+
+    if (_check(&h) != 0 || *(int*)heap_peek(&h) >= 1000)    {
+        fprintf(stderr, "Decreased keys didn't move up\n");
+        return -1;
+    }
+
+    // Remove every seventh
+    for (i = 0; i < COUNT; i += 7)  {
+        if (heap_remove(&h, handles[i], (void**)&data) != 0 || data != &_keys[i])   {
+            fprintf(stderr, "Couldn't remove handle %d\n", handles[i]);
+            return -1;
+        }
+    }
+
+    if (heap_remove(&h, handles[0], (void**)&data) != -1 || heap_update(&h, handles[0], &_keys[0]) != -1 ||
+        heap_remove(&h, -1, (void**)&data) != -1 || heap_update(&h, COUNT, &_keys[0]) != -1)  {
+        fprintf(stderr, "Handles not in use were accepted\n");
+        return -1;
+    }
+
+    if (_check(&h) != 0 || _drain(&h, COUNT - (COUNT + 6) / 7) != 0)    {
+        return -1;
+    }
+
+    heap_destroy(&h);
+    return 0;
+}
+
+/**
+ * Building a heap from an array
+ */
+static int _test_heapify()  {
+    void* values[COUNT];
+    heap h;
+    int i, n;
+
+    for (i = 0; i < COUNT; i++) {
+        _keys[i] = rand() % 100;
+        values[i] = &_keys[i];
+    }
+
+    heap_init(&h, 0, _compare, 0);
+    for (n = 0; n <= 6; n++)    {
+        if (heap_heapify(&h, values, n) != 0 || _check(&h) != 0 || _drain(&h, n) != 0)  {
+            fprintf(stderr, "Couldn't heapify %d values\n", n);
+            return -1;
+        }
+    }
+
+    if (heap_heapify(&h, values, COUNT) != 0 || _check(&h) != 0)    {
+        return -1;
+    }
+
+    for (i = 0; i < COUNT; i++) {
+        if (heap_data(&h, i) != values[i])  {
+            fprintf(stderr, "Handle %d isn't value %d\n", i, i);
+            return -1;
+        }
+    }
+
+    if (heap_heapify(&h, values, COUNT) != -1)  {
+        fprintf(stderr, "Heapified into a heap that wasn't empty\n");
+        return -1;
+    }
+
+    // Handles carry on from the array's
+    _keys[COUNT - 1] = -1;
+    heap_update(&h, COUNT - 1, &_keys[COUNT - 1]);
+    if (heap_peek(&h) != &_keys[COUNT - 1] || heap_push(&h, &_keys[0]) != COUNT)   {
+        fprintf(stderr, "Handles wrong after heapify\n");
+        return -1;
+    }
+
+    if (_check(&h) != 0 || _drain(&h, COUNT + 1) != 0)  {
+        return -1;
+    }
+
+    heap_destroy(&h);
+    return 0;
+}
+
+static int _destroyed;
+
+static void _destroy(void* data)    {
+    (void)data;
+    _destroyed++;
+}
+
+DEFINE_TEST_FUNCTION {
+    heap h;
+
+    srand(42);
+
+    if (_test_push_pop() != 0)  {
+        fprintf(stderr, "Push and pop failed\n");
+        return -1;
+    }
+
+    if (_test_handles() != 0)   {
+        fprintf(stderr, "Handles failed\n");
+        return -1;
+    }
+
+    if (_test_heapify() != 0)   {
+        fprintf(stderr, "Heapify failed\n");
+        return -1;
+    }
+
+    heap_init(&h, 0, _compare, _destroy);
+    heap_push(&h, &_keys[0]);
+    heap_push(&h, &_keys[1]);
+    heap_destroy(&h);
+    if (_destroyed != 2)    {
+        fprintf(stderr, "Destroy called %d times, should be 2\n", _destroyed);
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
@@ -0,0 +1,144 @@
+#include "test_utils.h"
+#include "platform.h"
+#include "ilist.h"
+
+typedef struct  {
+    int         id;
+    ilist_node  by_age;
+    ilist_node  by_parity;
+} item;
+
+/**
+ * Checks that the list holds the items with the given ids, in order, walking it both ways
+ */
+static int _check(ilist* l, const int* ids, int count)  {
+    ilist_node* n;
+    int i;
+
+    if (ilist_size(l) != count) {
+        fprintf(stderr, "List has %d nodes, should have %d\n", ilist_size(l), count);
+        return -1;
+    }
+
+    i = 0;
+    ILIST_FOREACH(l, n) {
+        if (i >= count || ilist_entry(n, item, by_age)->id != ids[i])    {
+            fprintf(stderr, "Node %d is wrong walking forward\n", i);
+            return -1;
+        }
+        i++;
+    }
+
+    for (n = ilist_last(l); n; n = ilist_prev(l, n))    {
+        if (ilist_entry(n, item, by_age)->id != ids[--i])   {
+            fprintf(stderr, "Node %d is wrong walking back\n", i);
+            return -1;
+        }
+    }
+
+    return i == 0? 0 : -1;
+}
+
+/**
+ * Pushing at both ends, removing from the middle and moving to the front
+ */
+static int _test_order()    {
+    static const int after_push[] = { 3, 2, 1, 0, 4, 5, 6, 7 };
+    static const int after_remove[] = { 2, 1, 0, 4, 6 };
+    static const int after_move[] = { 6, 2, 1, 0, 4, 7 };
+    item items[8];
+    ilist l;
+    int i;
+
+    ilist_init(&l);
+    if (ilist_first(&l) != 0 || ilist_last(&l) != 0 || ilist_size(&l) != 0) {
+        fprintf(stderr, "Empty list is wrong\n");
+        return -1;
+    }
+
+    for (i = 0; i < 8; i++) {
+        items[i].id = i;
+        if (i < 4)  {
+            ilist_push_front(&l, &items[i].by_age);
+        } else {
+            ilist_push_back(&l, &items[i].by_age);
+        }
+    }
+
+    if (_check(&l, after_push, 8) != 0) {
+        return -1;
+    }
+
+    /* Both ends and two in the middle, none of which needs the node before it */
+    ilist_remove(&l, &items[3].by_age);
+    ilist_remove(&l, &items[7].by_age);
+    ilist_remove(&l, &items[5].by_age);
+    if (_check(&l, after_remove, 5) != 0)   {
+        return -1;
+    }
+
+    ilist_move_front(&l, &items[6].by_age);
+    ilist_move_front(&l, &items[6].by_age);
+    ilist_insert_after(&l, &items[4].by_age, &items[7].by_age);
+    if (_check(&l, after_move, 6) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * One item on two lists at once, and removing while walking
+ */
+static int _test_two_lists()    {
+    item items[10];
+    ilist all, odd;
+    ilist_node *n, *tmp;
+    int i, sum;
+
+    ilist_init(&all);
+    ilist_init(&odd);
+    for (i = 0; i < 10; i++)    {
+        items[i].id = i;
+        ilist_push_back(&all, &items[i].by_age);
+        if (i % 2)  {
+            ilist_push_back(&odd, &items[i].by_parity);
+        }
+    }
+
+    /* Take every odd item off the first list by walking the second */
+    ILIST_FOREACH_SAFE(&odd, n, tmp)    {
+        ilist_remove(&all, &ilist_entry(n, item, by_parity)->by_age);
+        ilist_remove(&odd, n);
+    }
+
+    sum = 0;
+    ILIST_FOREACH(&all, n)  {
+        sum += ilist_entry(n, item, by_age)->id;
+    }
+
+    if (ilist_size(&odd) != 0 || ilist_size(&all) != 5 || sum != 0 + 2 + 4 + 6 + 8)  {
+        fprintf(stderr, "Lists are wrong after removing while walking\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    if (_test_order() != 0) {
+        fprintf(stderr, "Order failed\n");
+        return -1;
+    }
+
+    if (_test_two_lists() != 0) {
+        fprintf(stderr, "Two lists failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
@@ -0,0 +1,176 @@
+#include "test_utils.h"
+#include "platform.h"
+#include "pool.h"
+#include "list.h"
+#include "hashtable.h"
+
+/**
+ * Objects are distinct, aligned, recycled after being freed, and the slabs grow geometrically
+ */
+static int _test_pool() {
+    void* objs[1000];
+    pool p;
+    int i, slabs;
+    pool_slab* slab;
+
+    if (pool_init(&p, 3, 4) != 0 || p.size != sizeof(void*))    {
+        fprintf(stderr, "Pool not initialized, or objects not padded to hold a pointer\n");
+        return -1;
+    }
+
+    for (i = 0; i < 1000; i++)  {
+        if ((objs[i] = pool_alloc(&p)) == 0 || (size_t)objs[i] % sizeof(void*))  {
+            fprintf(stderr, "Bad object %d\n", i);
+            return -1;
+        }
+        memset(objs[i], i, p.size);
+    }
+
+    for (i = 1; i < 1000; i++)  {
+        if (*(unsigned char*)objs[i - 1] != (unsigned char)(i - 1))  {
+            fprintf(stderr, "Objects %d and %d overlap\n", i - 1, i);
+            return -1;
+        }
+    }
+
+    /* 4 + 8 + ... + 512 is 1020 objects */
+    slabs = 0;
+    for (slab = p.slabs; slab; slab = *(pool_slab**)slab)   {
+        slabs++;
+    }
+
+    if (slabs != 8 || pool_used(&p) != 1000)    {
+        fprintf(stderr, "%d slabs for %d objects\n", slabs, pool_used(&p));
+        return -1;
+    }
+
+    /* The last object freed is the next one handed out */
+    pool_free(&p, objs[10]);
+    pool_free(&p, objs[20]);
+    if (pool_alloc(&p) != objs[20] || pool_alloc(&p) != objs[10] || pool_used(&p) != 1000)  {
+        fprintf(stderr, "Freed objects were not reused\n");
+        return -1;
+    }
+
+    pool_destroy(&p);
+    return 0;
+}
+
+/**
+ * Several lists and a hashtable share one pool.  The table is destroyed first, the lists are left for
+ * the pool to take down
+ */
+static int _test_shared()   {
+    list lists[4];
+    hashtable ht;
+    void* data;
+    char key[32];
+    pool p, small;
+    int i;
+
+    if (pool_init(&p, HT_ENTRY_SIZE, 0) != 0 || ht_init(&ht, 16, 0, 0, 0) != 0 || ht_set_pool(&ht, &p) != 0)   {
+        fprintf(stderr, "Pool not initialized\n");
+        return -1;
+    }
+
+    for (i = 0; i < 4; i++) {
+        list_init_pool(&lists[i], 0, &p);
+    }
+
+    for (i = 0; i < 4000; i++)  {
+        if (list_insert_next(&lists[i % 4], list_tail(&lists[i % 4]), (void*)(size_t)i) != 0)  {
+            fprintf(stderr, "Error inserting %d into a list\n", i);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < 1000; i++)  {
+        sprintf(key, "key%d", i);
+        if (ht_insert(&ht, xp_strdup(key)) != 0)    {
+            fprintf(stderr, "Error inserting %s\n", key);
+            return -1;
+        }
+    }
+
+    if (pool_used(&p) != 5000)  {
+        fprintf(stderr, "Pool has %d objects in use, should be 5000\n", pool_used(&p));
+        return -1;
+    }
+
+    /* Removing gives the objects back, and lists keep their order */
+    for (i = 0; i < 1000; i++)  {
+        if (list_remove_next(&lists[0], 0, &data) != 0 || data != (void*)(size_t)(i * 4))  {
+            fprintf(stderr, "List returned the wrong value\n");
+            return -1;
+        }
+
+        sprintf(key, "key%d", i);
+        data = key;
+        if (ht_remove(&ht, &data) != 0) {
+            fprintf(stderr, "Error removing %s\n", key);
+            return -1;
+        }
+        free(data);
+    }
+
+    if (pool_used(&p) != 3000 || ht_size(&ht) != 0 || list_size(&lists[0]) != 0)   {
+        fprintf(stderr, "Pool has %d objects in use, should be 3000\n", pool_used(&p));
+        return -1;
+    }
+
+    /* Tables with values, open addressing tables and pools with small objects are turned down */
+    ht_insert(&ht, "value");
+    if (ht_set_pool(&ht, &p) != -1) {
+        fprintf(stderr, "A pool was set on a table with values in it\n");
+        return -1;
+    }
+
+    /* Destroying the table gives its entries back to the pool, and frees its own arrays */
+    ht_insert(&ht, "another");
+    if (pool_used(&p) != 3002)  {
+        fprintf(stderr, "Pool has %d objects in use, should be 3002\n", pool_used(&p));
+        return -1;
+    }
+    ht_destroy(&ht);
+    if (pool_used(&p) != 3000)  {
+        fprintf(stderr, "Destroyed table left %d objects in use, should be 3000\n", pool_used(&p));
+        return -1;
+    }
+
+    ht_init_engine(&ht, HT_ENGINE_OPEN, 16, 0, 0, 0);
+    if (ht_set_pool(&ht, &p) != -1) {
+        fprintf(stderr, "A pool was set on an open addressing table\n");
+        return -1;
+    }
+    ht_destroy(&ht);
+
+    ht_init(&ht, 16, 0, 0, 0);
+    pool_init(&small, sizeof(void*), 0);
+    if (ht_set_pool(&ht, &small) != -1) {
+        fprintf(stderr, "A pool with objects too small for entries was set\n");
+        return -1;
+    }
+    ht_destroy(&ht);
+
+    /* Lists 1 to 3 still hold 3000 elements, which all go at once */
+    pool_destroy(&p);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    if (_test_pool() != 0)  {
+        fprintf(stderr, "Pool failed\n");
+        return -1;
+    }
+
+    if (_test_shared() != 0)    {
+        fprintf(stderr, "Shared pool failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
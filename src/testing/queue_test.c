@@ -0,0 +1,227 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include "test_utils.h"
+#include "platform.h"
+#include "queue.h"
+
+#define PRODUCERS       4
+#define CONSUMERS       4
+#define PER_PRODUCER    200000
+
+/* Values are (producer << 24) | (sequence + 1), so each producer's order can be checked */
+#define VALUE(p, i)     ((void*)(size_t)(((p) << 24) | ((i) + 1)))
+
+static spsc_queue _spsc;
+static mpmc_queue _mpmc;
+static atomic_int _consumed;
+static atomic_int _errors;
+
+/**
+ * Full and empty queues, wrapping around, and batches that wrap
+ */
+static int _test_single()   {
+    void* batch[8];
+    void* data;
+    size_t i, n;
+
+    if (spsc_init(&_spsc, 5) != 0 || _spsc.mask != 7 || mpmc_init(&_mpmc, 8) != 0 || _mpmc.mask != 7)  {
+        fprintf(stderr, "Queues not initialized to the next power of 2\n");
+        return -1;
+    }
+
+    for (n = 0; n < 3; n++) {
+        if (spsc_pop(&_spsc, &data) != -1 || mpmc_pop(&_mpmc, &data) != -1)    {
+            fprintf(stderr, "Empty queue returned a value\n");
+            return -1;
+        }
+
+        for (i = 0; i < 8; i++) {
+            if (spsc_push(&_spsc, VALUE(0, i)) != 0 || mpmc_push(&_mpmc, VALUE(0, i)) != 0)  {
+                fprintf(stderr, "Error pushing %d\n", (int)i);
+                return -1;
+            }
+        }
+
+        if (spsc_push(&_spsc, VALUE(0, 8)) != -1 || mpmc_push(&_mpmc, VALUE(0, 8)) != -1)   {
+            fprintf(stderr, "Full queue took a value\n");
+            return -1;
+        }
+
+        for (i = 0; i < 8; i++) {
+            if (spsc_pop(&_spsc, &data) != 0 || data != VALUE(0, i) ||
+                mpmc_pop(&_mpmc, &data) != 0 || data != VALUE(0, i))  {
+                fprintf(stderr, "Value %d came out wrong\n", (int)i);
+                return -1;
+            }
+        }
+    }
+
+    /* Move both rings 3 slots along, so the batches below wrap around the end */
+    for (i = 0; i < 3; i++) {
+        spsc_push(&_spsc, VALUE(0, i));
+        spsc_pop(&_spsc, &data);
+        mpmc_push(&_mpmc, VALUE(0, i));
+        mpmc_pop(&_mpmc, &data);
+    }
+
+    /* Batches of 5 into a ring of 8 fit 8 values, then the ring is full */
+    for (n = 0; n < 4; n++) {
+        for (i = 0; i < 5; i++) {
+            batch[i] = VALUE(1, n * 5 + i);
+        }
+
+        if (spsc_push_batch(&_spsc, batch, 5) != 5 || spsc_push_batch(&_spsc, batch, 5) != 3 ||
+            mpmc_push_batch(&_mpmc, batch, 5) != 5 || mpmc_push_batch(&_mpmc, batch, 5) != 3)  {
+            fprintf(stderr, "Batch pushes added the wrong number of values\n");
+            return -1;
+        }
+
+        if (spsc_pop_batch(&_spsc, batch, 6) != 6 || batch[4] != VALUE(1, n * 5 + 4) ||
+            batch[5] != VALUE(1, n * 5) || spsc_pop_batch(&_spsc, batch, 6) != 2 ||
+            batch[1] != VALUE(1, n * 5 + 2) || spsc_pop_batch(&_spsc, batch, 6) != 0)  {
+            fprintf(stderr, "SPSC batch pops are wrong\n");
+            return -1;
+        }
+
+        if (mpmc_pop_batch(&_mpmc, batch, 6) != 6 || batch[4] != VALUE(1, n * 5 + 4) ||
+            batch[5] != VALUE(1, n * 5) || mpmc_pop_batch(&_mpmc, batch, 6) != 2 ||
+            batch[1] != VALUE(1, n * 5 + 2) || mpmc_pop_batch(&_mpmc, batch, 6) != 0)  {
+            fprintf(stderr, "MPMC batch pops are wrong\n");
+            return -1;
+        }
+    }
+
+    spsc_destroy(&_spsc);
+    mpmc_destroy(&_mpmc);
+    return 0;
+}
+
+/**
+ * Pushes PER_PRODUCER values, alternating between single pushes and batches
+ */
+static void* _producer(void* arg)   {
+    int p = (int)(size_t)arg;
+    void* batch[16];
+    int i, n, sent;
+
+    for (i = 0; i < PER_PRODUCER;)  {
+        if (i % 64 < 32)    {
+            while ((p < 0? spsc_push(&_spsc, VALUE(0, i)) : mpmc_push(&_mpmc, VALUE(p, i))) != 0)   {
+                sched_yield();
+            }
+            i++;
+        } else {
+            n = PER_PRODUCER - i < 16? PER_PRODUCER - i : 16;
+            for (sent = 0; sent < n; sent++)    {
+                batch[sent] = p < 0? VALUE(0, i + sent) : VALUE(p, i + sent);
+            }
+
+            for (sent = 0; sent < n;)   {
+                sent += (int)(p < 0? spsc_push_batch(&_spsc, batch + sent, n - sent) :
+                    mpmc_push_batch(&_mpmc, batch + sent, n - sent));
+                if (sent < n)   {
+                    sched_yield();
+                }
+            }
+            i += n;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Pops values until every producer's are all consumed, checking each producer's values arrive in order
+ */
+static void* _consumer(void* arg)   {
+    int spsc = (int)(size_t)arg < 0;
+    int last[PRODUCERS];
+    void* batch[8];
+    size_t n, i;
+    int p, seq;
+
+    memset(last, 0, sizeof(last));
+    while (atomic_load(&_consumed) < (spsc? PER_PRODUCER : PRODUCERS * PER_PRODUCER))  {
+        n = spsc? spsc_pop_batch(&_spsc, batch, 8) : mpmc_pop_batch(&_mpmc, batch, 8);
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+
+        for (i = 0; i < n; i++) {
+            p = (int)((size_t)batch[i] >> 24);
+            seq = (int)((size_t)batch[i] & 0xffffff);
+            if (p >= PRODUCERS || seq <= last[p])   {
+                atomic_fetch_add(&_errors, 1);
+            }
+            last[p] = seq;
+        }
+        atomic_fetch_add(&_consumed, (int)n);
+    }
+
+    return 0;
+}
+
+/**
+ * One producer and one consumer on the ring, then several of each on the MPMC queue
+ */
+static int _test_threads()  {
+    pthread_t producers[PRODUCERS], consumers[CONSUMERS];
+    int i;
+
+    spsc_init(&_spsc, 64);
+    atomic_store(&_consumed, 0);
+    atomic_store(&_errors, 0);
+    pthread_create(&producers[0], 0, _producer, (void*)(size_t)-1);
+    pthread_create(&consumers[0], 0, _consumer, (void*)(size_t)-1);
+    pthread_join(producers[0], 0);
+    pthread_join(consumers[0], 0);
+
+    if (atomic_load(&_errors) || atomic_load(&_consumed) != PER_PRODUCER)   {
+        fprintf(stderr, "SPSC queue lost or reordered values\n");
+        return -1;
+    }
+    spsc_destroy(&_spsc);
+
+    mpmc_init(&_mpmc, 64);
+    atomic_store(&_consumed, 0);
+    for (i = 0; i < PRODUCERS; i++) {
+        pthread_create(&producers[i], 0, _producer, (void*)(size_t)i);
+    }
+    for (i = 0; i < CONSUMERS; i++) {
+        pthread_create(&consumers[i], 0, _consumer, (void*)(size_t)i);
+    }
+    for (i = 0; i < PRODUCERS; i++) {
+        pthread_join(producers[i], 0);
+    }
+    for (i = 0; i < CONSUMERS; i++) {
+        pthread_join(consumers[i], 0);
+    }
+
+    if (atomic_load(&_errors) || atomic_load(&_consumed) != PRODUCERS * PER_PRODUCER)   {
+        fprintf(stderr, "MPMC queue lost or reordered values\n");
+        return -1;
+    }
+
+    mpmc_destroy(&_mpmc);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    if (_test_single() != 0)    {
+        fprintf(stderr, "Single thread failed\n");
+        return -1;
+    }
+
+    if (_test_threads() != 0)   {
+        fprintf(stderr, "Threads failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
@@ -0,0 +1,122 @@
+#include <unistd.h>
+
+#include "test_utils.h"
+#include "platform.h"
+#include "rope.h"
+
+#define PIECES  300
+
+/**
+ * Checks the rope flattens to the given string, and writes out the same through a temporary file
+ */
+static int _check(rope* r, const char* expected, size_t length)   {
+    FILE* f;
+    char* flat;
+    char* read_back;
+    size_t n;
+
+    if (rope_length(r) != length || (flat = rope_flatten(r)) == 0 || memcmp(flat, expected, length + 1))   {
+        fprintf(stderr, "Rope flattened wrong (%d bytes, should be %d)\n", (int)rope_length(r), (int)length);
+        return -1;
+    }
+    free(flat);
+
+    f = tmpfile();
+    read_back = (char*)malloc(length + 1);
+    if (!f || rope_write(r, fileno(f)) != 0)  {
+        fprintf(stderr, "Couldn't write the rope\n");
+        return -1;
+    }
+
+    rewind(f);
+    n = fread(read_back, 1, length + 1, f);
+    if (n != length || memcmp(read_back, expected, length)) {
+        fprintf(stderr, "Rope wrote %d bytes, should be %d\n", (int)n, (int)length);
+        return -1;
+    }
+
+    free(read_back);
+    fclose(f);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    static char borrowed[PIECES][200];
+    char* expected;
+    char* flat;
+    size_t length = 0;
+    rope r;
+    int i;
+
+    expected = (char*)malloc(PIECES * 300);
+    expected[0] = '\0';
+
+    // Small chunks, so pieces are split between them and there are more segments than one writev takes
+    rope_init(&r, 100);
+    if (_check(&r, "", 0) != 0 || rope_segments(&r) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < PIECES; i++)    {
+        switch (i % 4)  {
+            case 0:
+                rope_append_str(&r, "copied, ");
+                length += sprintf(expected + length, "copied, ");
+                break;
+            case 1:
+                rope_append_strf(&r, "formatted %d with %s, ", i, "an argument");
+                length += sprintf(expected + length, "formatted %d with %s, ", i, "an argument");
+                break;
+            case 2:
+                memset(borrowed[i], 'a' + i % 26, i % 3 == 0? 20 : 150);
+                rope_append_ref(&r, borrowed[i], i % 3 == 0? 20 : 150);
+                memcpy(expected + length, borrowed[i], i % 3 == 0? 20 : 150);
+                length += i % 3 == 0? 20 : 150;
+                expected[length] = '\0';
+                break;
+            case 3:
+                // Longer than a chunk
+                memset(borrowed[i], 'A' + i % 26, 199);
+                borrowed[i][199] = '\0';
+                rope_append(&r, borrowed[i], 199);
+                length += sprintf(expected + length, "%s", borrowed[i]);
+                break;
+        }
+    }
+
+    if (_check(&r, expected, length) != 0 || rope_segments(&r) < 128)  {
+        return -1;
+    }
+
+    // A formatted string longer than a chunk gets a chunk of its own, rather than being split
+    i = rope_segments(&r);
+    rope_append_strf(&r, "%0200d", 7);
+    length += sprintf(expected + length, "%0200d", 7);
+    if (rope_segments(&r) != i + 1 || r.tail->length != 200 || _check(&r, expected, length) != 0) {
+        fprintf(stderr, "Long formatted string went wrong\n");
+        return -1;
+    }
+
+    rope_reset(&r);
+    if (_check(&r, "", 0) != 0 || r.chunk_size != 100)  {
+        return -1;
+    }
+
+    // Borrowed buffers aren't copied, so changes to them show up
+    rope_append_ref(&r, borrowed[2], 150);
+    rope_append_str(&r, "x");
+    borrowed[2][0] = '!';
+    if (rope_segments(&r) != 2 || (flat = rope_flatten(&r)) == 0 || flat[0] != '!' || flat[150] != 'x')  {
+        fprintf(stderr, "Borrowed buffer was copied\n");
+        return -1;
+    }
+
+    free(flat);
+    free(expected);
+    rope_destroy(&r);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
@@ -0,0 +1,157 @@
+#include <stdint.h>
+#include <limits.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "test_utils.h"
+#include "sbtemplate.h"
+
+#define RANDOM_VALUES   100000
+
+static const char* _names = "abcdefghijklmnopq";
+
+static uint64_t _random_bits(uint64_t* x)   {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+/**
+ * Compiles fmt, appends it with the given arguments after what sb already holds, and checks the result
+ * is what vsnprintf makes of them
+ */
+static int _check(stringbuilder* sb, const char* fmt, ...)  {
+    char expected[512];
+    sb_template t;
+    va_list arglist;
+    va_list arglist2;
+    size_t start = sb->pos;
+
+    if (sb_template_compile(&t, fmt) != 0)  {
+        fprintf(stderr, "Couldn't compile \"%s\"\n", fmt);
+        return -1;
+    }
+
+    va_start(arglist, fmt);
+    va_copy(arglist2, arglist);
+    vsnprintf(expected, sizeof(expected), fmt, arglist);
+    sb_append_vtemplate(sb, &t, arglist2);
+    va_end(arglist2);
+    va_end(arglist);
+
+    if (strcmp(sb_cstring(sb) + start, expected))   {
+        fprintf(stderr, "\"%s\" made \"%s\", should be \"%s\"\n", fmt, sb_cstring(sb) + start, expected);
+        return -1;
+    }
+
+    sb_template_destroy(&t);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    static const char* unsupported[] = { "%e", "%g", "%p", "%n", "%*d", "%.*s", "%.3d", "%05s", "%lc", "%Lf",
+        "%zf", "%#x", "% d", "%", "trailing %", "%12345d" };
+    char formats[2][32];
+    stringbuilder* sb = sb_new();
+    stringbuilder* expected;
+    char* read_back;
+    FILE* file;
+    uint64_t x = 88172645463325252ULL;
+    double value;
+    sb_template t;
+    int i, j;
+
+    if (_check(sb, "") != 0 || _check(sb, "no conversions, 100%% literal") != 0 ||
+        _check(sb, "%d%s%c", -5, "x", 'y') != 0 ||
+        _check(sb, "%d %i %u %x %X", INT32_MIN, INT32_MAX, UINT32_MAX, 0xdeadbeef, 0xdeadbeef) != 0 ||
+        _check(sb, "%hhd %hhu %hd %hu", 300, 300, 70000, 70000) != 0 ||
+        _check(sb, "%ld %lu %lld %llx", LONG_MIN, ULONG_MAX, LLONG_MIN, ULLONG_MAX) != 0 ||
+        _check(sb, "%zu %zd %jd %ju %td", SIZE_MAX, (ptrdiff_t)-1, INTMAX_MIN, UINTMAX_MAX, PTRDIFF_MIN) != 0 ||
+        _check(sb, "[%5d|%-5d|%05d|%+d|%+05d|%-+5d|%-05d]", -42, -42, -42, 42, 42, 42, 42) != 0 ||
+        _check(sb, "[%08x|%-8X|%3u|%3c|%-3c]", 0xbeef, 0xbeef, 123456, 'a', 'b') != 0 ||
+        _check(sb, "[%s|%10s|%-10s|%.3s|%10.3s|%.10s]", "abcdef", "abcdef", "abcdef", "abcdef", "abcdef", "abc") != 0 ||
+        _check(sb, "[%f|%.0f|%.1f|%.2f|%.3f|%lf]", 3.14159, 2.5, 0.05, 0.125, -0.0005, 1e10) != 0 ||
+        _check(sb, "[%10.2f|%-10.2f|%010.2f|%+.2f|%+010.2f|%.0f]", -3.14159, 3.14159, -3.14159, 0.0, 2.0, 0.5) != 0 ||
+        _check(sb, "[%f|%.2f|%.15f|%.20f|%08.3f|%-8f|%+f]", 1e300, 123456789012345.678, 0.1, 0.1, INFINITY,
+            -INFINITY, NAN) != 0 ||
+        _check(sb, "[%.0f|%.0f|%.1f|%.2f|%.3f]", 0.5, 1.5, 0.25, 1.005, 1e-300) != 0 ||
+        _check(sb, "2024-05-%02d 12:%02d:%02d.%03d [%s] conn %d: %s (%d bytes in %.3f ms)\n", 7, 3, 9, 45,
+            "info", 1234, "request served", 5678, 12.3456) != 0)  {
+        return -1;
+    }
+
+    for (i = 0; i < (int)(sizeof(unsupported) / sizeof(unsupported[0])); i++)   {
+        if (sb_template_compile(&t, unsupported[i]) == 0 || t.text || t.slots)    {
+            fprintf(stderr, "Compiled \"%s\", which isn't supported\n", unsupported[i]);
+            return -1;
+        }
+    }
+
+    if (sb_template_compile(&t, "%s=%d (%.2f%%)") != 0 || sb_template_args(&t) != 3 ||
+        strcmp(t.text, "= (%)") != 0)    {
+        fprintf(stderr, "Template compiled wrong\n");
+        return -1;
+    }
+    sb_template_destroy(&t);
+
+    // Random values, widths and precisions, including doubles close to halfway between two outputs
+    for (i = 0; i < RANDOM_VALUES; i++) {
+        sb_reset(sb);
+        j = (int)(_random_bits(&x) % 4);
+        sprintf(formats[0], "%%%s%d.%df", j == 0? "-" : j == 1? "0" : j == 2? "+" : "", (int)((x >> 8) % 20),
+            (int)((x >> 16) % 18));
+        sprintf(formats[1], "%%%s%dll%c", j == 0? "-" : j == 1? "0" : "", (int)((x >> 24) % 25),
+            "dux"[(x >> 32) % 3]);
+
+        switch ((x >> 40) % 3)  {
+            case 0:
+                value = (double)(int64_t)_random_bits(&x) / (double)(1ULL << (x % 64));
+                break;
+            case 1:
+                value = (double)(int)(_random_bits(&x) % 100000) / 1000.0 + 0.0005;
+                break;
+            default:
+                value = (double)(int)(_random_bits(&x) % 1000) / 8.0;
+                break;
+        }
+
+        if (_check(sb, formats[0], value) != 0 || _check(sb, formats[1], (long long)_random_bits(&x)) != 0)    {
+            return -1;
+        }
+    }
+
+    sb_destroy(sb, 1);
+
+    // Through a sink much smaller than a line, where every field must still be written whole
+    if (sb_template_compile(&t, "[%-12s|%+010.3f|%08llx|%5c|%-6d]\n") != 0 || (file = tmpfile()) == 0) {
+        return -1;
+    }
+
+    sb = sb_new_with_flags(0, 0);
+    expected = sb_new();
+    sb_bind_fd(sb, fileno(file), 24);
+    for (i = 0; i < 1000; i++)  {
+        // Names of varying length, so the flushes fall at every point in the line
+        sb_append_template(sb, &t, _names + i % 17, i * 1.125, (long long)i * 977, 'a' + i % 26, -i);
+        sb_append_template(expected, &t, _names + i % 17, i * 1.125, (long long)i * 977, 'a' + i % 26, -i);
+    }
+
+    read_back = (char*)malloc(expected->pos + 1);
+    if (sb_flush(sb) != 0 || sb->size != 25 || fseek(file, 0, SEEK_SET) != 0 || fread(read_back, 1, expected->pos + 1, file) != expected->pos ||
+        memcmp(read_back, expected->cstr, expected->pos))    {
+        fprintf(stderr, "Template went wrong through a sink\n");
+        return -1;
+    }
+
+    free(read_back);
+    fclose(file);
+    sb_destroy(expected, 1);
+    sb_destroy(sb, 1);
+    sb_template_destroy(&t);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
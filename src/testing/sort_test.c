@@ -0,0 +1,208 @@
+#include <stdint.h>
+
+#include "test_utils.h"
+#include "platform.h"
+#include "list.h"
+#include "sort.h"
+#include "threadpool.h"
+
+/* Values have a key that repeats a lot, and their original position to check stability with */
+typedef struct  {
+    int key;
+    int seq;
+} record;
+
+static int _compare(const void* key1, const void* key2) {
+    return ((const record*)key1)->key - ((const record*)key2)->key;
+}
+
+/**
+ * Fills records with n values, random or in one of a few awkward orders
+ */
+static void _fill(record* records, int n, int kind) {
+    uint32_t x = 2463534242u;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        switch (kind)   {
+        case 0:     records[i].key = (int)(x % 1000);   break;
+        case 1:     records[i].key = i;                 break;
+        case 2:     records[i].key = n - i;             break;
+        default:    records[i].key = 5;                 break;
+        }
+        records[i].seq = i;
+    }
+}
+
+/**
+ * Checks that the values are sorted, and that equal keys kept their original order
+ */
+static int _check(record** sorted, int n)   {
+    int i;
+
+    for (i = 1; i < n; i++) {
+        if (sorted[i - 1]->key > sorted[i]->key ||
+            (sorted[i - 1]->key == sorted[i]->key && sorted[i - 1]->seq > sorted[i]->seq))  {
+            fprintf(stderr, "Values %d and %d are out of order\n", i - 1, i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * list_sort on lists of several sizes, which must come back sorted, stable, and with the right tail
+ */
+static int _test_list() {
+    static record records[10000];
+    static record* sorted[10000];
+    list_element* e;
+    list l;
+    int kind, n, i;
+
+    for (kind = 0; kind < 4; kind++)    {
+        for (n = 0; n <= 10000; n = n * 2 + 1)  {
+            _fill(records, n, kind);
+            list_init(&l, 0);
+            for (i = 0; i < n; i++) {
+                list_insert_next(&l, list_tail(&l), &records[i]);
+            }
+
+            if (list_sort(&l, _compare) != 0)   {
+                fprintf(stderr, "Error sorting %d values\n", n);
+                return -1;
+            }
+
+            i = 0;
+            for (e = list_head(&l); e; e = list_next(e))    {
+                sorted[i++] = (record*)list_data(e);
+            }
+
+            if (i != n || list_size(&l) != n || (n && list_data(list_tail(&l)) != sorted[n - 1]) ||
+                (n && list_next(list_tail(&l)) != 0) || _check(sorted, n) != 0)   {
+                fprintf(stderr, "%d values of kind %d not sorted\n", n, kind);
+                return -1;
+            }
+
+            list_destroy(&l);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * sort_merge, and sort_parallel on pools of several sizes
+ */
+static int _test_arrays()   {
+    static const int threads[] = { -1, 0, 1, 3, 6 };
+    record* records;
+    record** sorted;
+    threadpool tp;
+    int t, kind, n, i;
+
+    n = 100000;
+    records = (record*)malloc(n * sizeof(record));
+    sorted = (record**)malloc(n * sizeof(record*));
+
+    for (t = 0; t < 5; t++) {
+        if (threads[t] >= 0 && threadpool_init(&tp, threads[t]) != 0)   {
+            fprintf(stderr, "Pool of %d threads not initialized\n", threads[t]);
+            return -1;
+        }
+
+        for (kind = 0; kind < 4; kind++)    {
+            _fill(records, n, kind);
+            for (i = 0; i < n; i++) {
+                sorted[i] = &records[i];
+            }
+
+            if ((threads[t] < 0? sort_merge((void**)sorted, n, _compare) :
+                    sort_parallel((void**)sorted, n, _compare, &tp)) != 0 || _check(sorted, n) != 0)  {
+                fprintf(stderr, "Values of kind %d not sorted with %d threads\n", kind, threads[t]);
+                return -1;
+            }
+        }
+
+        if (threads[t] >= 0)    {
+            threadpool_destroy(&tp);
+        }
+    }
+
+    free(records);
+    free(sorted);
+    return 0;
+}
+
+static threadpool _pool;
+static int _counts[64];
+
+/* Counts itself, and the first 8 jobs each queue another 7 */
+static void _job(void* arg) {
+    int i = (int)(size_t)arg;
+
+    __atomic_fetch_add(&_counts[i], 1, __ATOMIC_RELAXED);
+    if (i < 8)  {
+        for (i = i * 7 + 8; i < (int)(size_t)arg * 7 + 15; i++)    {
+            threadpool_submit(&_pool, _job, (void*)(size_t)i);
+        }
+    }
+}
+
+/**
+ * Jobs that queue more jobs all run before threadpool_wait returns, with and without threads
+ */
+static int _test_pool() {
+    int threads, i;
+
+    for (threads = 0; threads <= 4; threads += 4)   {
+        memset(_counts, 0, sizeof(_counts));
+        if (threadpool_init(&_pool, threads) != 0)  {
+            fprintf(stderr, "Pool of %d threads not initialized\n", threads);
+            return -1;
+        }
+
+        for (i = 0; i < 8; i++) {
+            threadpool_submit(&_pool, _job, (void*)(size_t)i);
+        }
+        threadpool_wait(&_pool);
+
+        for (i = 0; i < 64; i++)    {
+            if (_counts[i] != 1)    {
+                fprintf(stderr, "Job %d ran %d times with %d threads\n", i, _counts[i], threads);
+                return -1;
+            }
+        }
+
+        threadpool_destroy(&_pool);
+    }
+
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    if (_test_list() != 0)  {
+        fprintf(stderr, "List sort failed\n");
+        return -1;
+    }
+
+    if (_test_pool() != 0)  {
+        fprintf(stderr, "Thread pool failed\n");
+        return -1;
+    }
+
+    if (_test_arrays() != 0)    {
+        fprintf(stderr, "Array sort failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
@@ -1,37 +1,378 @@
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+
 #include "test_utils.h"
 #include "stringbuilder.h"
 
+#define RANDOM_NUMBERS  200000
+
 static void _sb_info(FILE* out, stringbuilder* sb)  {
-    fprintf(out, "sb(%p) cstr: %p  pos: %d  size: %d  reallocs: %d\n", 
-        sb, sb->cstr, sb->pos, sb->size, sb->reallocs);
+    fprintf(out, "sb(%p) cstr: %p  pos: %zu  size: %zu  reallocs: %d\n", 
+        sb, sb->cstr, sb->pos, sb->size, sb->stats.reallocs);
 }
 
-static void _assert_sb_stats(stringbuilder* sb, const char* str, int size, int reallocs)    {
+static void _assert_sb_stats(stringbuilder* sb, const char* str, size_t size, int reallocs) {
     if (str && strcmp(sb_cstring(sb), str)) {
         fprintf(stderr, "SB string (%s) does not match '%s'\n", sb_cstring(sb), str);
         exit(-1);
     }
 
     if (strlen(str) != strlen(sb_cstring(sb))) {
-        fprintf(stderr, "CSTR size expected to be %d, but is %d\n", strlen(str), strlen(sb_cstring(sb)));
+        fprintf(stderr, "CSTR size expected to be %zu, but is %zu\n", strlen(str), strlen(sb_cstring(sb)));
     }
     
     if (size != sb->size)   {
-        fprintf(stderr, "SB Size (%d) does not match required size (%d)\n", sb->size, size);
+        fprintf(stderr, "SB Size (%zu) does not match required size (%zu)\n", sb->size, size);
+        _sb_info(stderr, sb);
         exit(-1);
     }
     
-    if (reallocs != sb->reallocs)   {
-        fprintf(stderr, "SB Reallocs (%d) do not match required reallocs (%d)\n", sb->reallocs, reallocs);
+    if (reallocs != sb->stats.reallocs) {
+        fprintf(stderr, "SB Reallocs (%d) do not match required reallocs (%d)\n", sb->stats.reallocs, reallocs);
+        _sb_info(stderr, sb);
         exit(-1);
     }
 }
 
+static uint64_t _random_bits(uint64_t* x)   {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+/**
+ * Returns the number of significant digits in a formatted double: from the first nonzero digit up to
+ * the exponent, ignoring trailing zeros in plain notation
+ */
+static int _significant_digits(const char* str) {
+    int count = 0, zeros = 0;
+
+    for (; *str && *str != 'e'; str++)  {
+        if (*str >= '1' && *str <= '9') {
+            count += zeros + 1;
+            zeros = 0;
+        } else if (*str == '0' && count)    {
+            zeros++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Checks a double appends as the given string
+ */
+static int _check_double(double value, const char* expected)    {
+    stringbuilder sb;
+
+    sb_init(&sb, 0, 0, SB_LAZY_NUL);
+    sb_append_double(&sb, value);
+    if (strcmp(sb_cstring(&sb), expected))  {
+        fprintf(stderr, "Double appended as %s, should be %s\n", sb_cstring(&sb), expected);
+        return -1;
+    }
+
+    sb_destroy(&sb, 1);
+    return 0;
+}
+
+/**
+ * Integers against printf, and doubles reading back exactly, in no more than 17 significant digits and
+ * nearly always as few as the shortest printf %.*g that does
+ */
+static int _test_numbers()  {
+    static const char* doubles[] = { "0.1", "0.3", "1", "123456", "1e+21", "123456789012345680000", "1.5e-7",
+        "0.000001", "5e-324", "1.7976931348623157e+308", "2.2250738585072014e-308", "9007199254740992",
+        "-2.5", "3.141592653589793", "1e+100", "1.2345e-100" };
+    char expected[64];
+    char shortest[64];
+    stringbuilder sb;
+    uint64_t x = 88172645463325252ULL, bits;
+    double value, back;
+    int i, digits, longer = 0;
+
+    sb_init(&sb, 0, 0, SB_LAZY_NUL);
+    sb_append_i64(&sb, INT64_MIN);
+    sb_append_ch(&sb, ' ');
+    sb_append_i64(&sb, INT64_MAX);
+    sb_append_ch(&sb, ' ');
+    sb_append_u64(&sb, UINT64_MAX);
+    sb_append_ch(&sb, ' ');
+    sb_append_i64(&sb, 0);
+    sb_append_ch(&sb, ' ');
+    sb_append_hex(&sb, 0, 0);
+    sb_append_ch(&sb, ' ');
+    sb_append_hex(&sb, 0xdeadbeef, 12);
+    sb_append_ch(&sb, ' ');
+    sb_append_hex(&sb, UINT64_MAX, 4);
+    if (strcmp(sb_cstring(&sb), "-9223372036854775808 9223372036854775807 18446744073709551615 0 0 "
+            "0000deadbeef ffffffffffffffff"))  {
+        fprintf(stderr, "Integer limits appended as %s\n", sb_cstring(&sb));
+        return -1;
+    }
+
+    for (i = 0; i < RANDOM_NUMBERS; i++)    {
+        // Spread over every magnitude, not just huge numbers
+        bits = _random_bits(&x) >> (i % 64);
+
+        sb_reset(&sb);
+        sb_append_i64(&sb, (int64_t)bits * (i & 1? -1 : 1));
+        sb_append_ch(&sb, ' ');
+        sb_append_u64(&sb, bits);
+        sb_append_ch(&sb, ' ');
+        sb_append_hex(&sb, bits, i % 20);
+        sprintf(expected, "%lld %llu %0*llx", (long long)((int64_t)bits * (i & 1? -1 : 1)),
+            (unsigned long long)bits, i % 20, (unsigned long long)bits);
+        if (strcmp(sb_cstring(&sb), expected))  {
+            fprintf(stderr, "Integers appended as %s, should be %s\n", sb_cstring(&sb), expected);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < (int)(sizeof(doubles) / sizeof(doubles[0])); i++)  {
+        if (_check_double(strtod(doubles[i], 0), doubles[i]) != 0)  {
+            return -1;
+        }
+    }
+
+    if (_check_double(-0.0, "-0") != 0 || _check_double(0.0, "0") != 0 || _check_double(NAN, "nan") != 0 ||
+        _check_double(INFINITY, "inf") != 0 || _check_double(-INFINITY, "-inf") != 0)   {
+        return -1;
+    }
+
+    for (i = 0; i < RANDOM_NUMBERS; i++)    {
+        // Random bits make doubles of every magnitude, and every other one is a short decimal
+        bits = _random_bits(&x);
+        memcpy(&value, &bits, sizeof(value));
+        if (i & 1)  {
+            value = (double)(int)(bits % 100000) / 1000;
+        }
+        if (isnan(value) || isinf(value))   {
+            continue;
+        }
+
+        sb_reset(&sb);
+        sb_append_double(&sb, value);
+        back = strtod(sb_cstring(&sb), 0);
+        if (memcmp(&back, &value, sizeof(value)))   {
+            fprintf(stderr, "%s doesn't read back as %.17g\n", sb_cstring(&sb), value);
+            return -1;
+        }
+
+        for (digits = 1; digits < 17; digits++) {
+            sprintf(shortest, "%.*g", digits, value);
+            if (strtod(shortest, 0) == value)   {
+                break;
+            }
+        }
+
+        if (_significant_digits(sb_cstring(&sb)) > 17)  {
+            fprintf(stderr, "%s is longer than 17 digits\n", sb_cstring(&sb));
+            return -1;
+        }
+        longer += _significant_digits(sb_cstring(&sb)) > digits;
+    }
+
+    if (longer > RANDOM_NUMBERS / 100)  {
+        fprintf(stderr, "%d doubles weren't the shortest\n", longer);
+        return -1;
+    }
+
+    sb_destroy(&sb, 1);
+    return 0;
+}
+
+/**
+ * Reserving, shrinking and the growth policies, and a string past 2GB if there is address space for one
+ */
+static int _test_sizing()   {
+    const size_t far = (size_t)5 << 29;
+    stringbuilder* sb = sb_new_with_size(16);
+    char block[4000];
+    int i;
+
+    // Reserved to exactly the size asked for, then not grown again until it's full
+    if (sb_reserve(sb, 1000) != 0 || sb->size != 1001 || sb_reserve(sb, 10) != 0 || sb->size != 1001) {
+        fprintf(stderr, "Reserved %zu bytes, should be 1001\n", sb->size);
+        return -1;
+    }
+
+    for (i = 0; i < 1000; i++)  {
+        sb_append_ch(sb, 'a' + i % 26);
+    }
+
+    if (sb->stats.reallocs != 1 || sb->pos != 1000) {
+        fprintf(stderr, "Reserved room wasn't used\n");
+        return -1;
+    }
+
+    sb_append_ch(sb, '!');
+    if (sb->size != 2002 || sb_shrink_to_fit(sb) != 0 || sb->size != 1002 || strlen(sb_cstring(sb)) != 1001 ||
+        sb->cstr[999] != 'a' + 999 % 26 || sb->cstr[1000] != '!')   {
+        fprintf(stderr, "Shrunk to %zu bytes, should be 1002\n", sb->size);
+        return -1;
+    }
+
+    sb_set_growth(sb, sb_grow_by_half);
+    sb_append_ch(sb, '?');
+    if (sb->size != 1503)   {
+        fprintf(stderr, "Grew by half to %zu bytes, should be 1503\n", sb->size);
+        return -1;
+    }
+
+    // By half and then up to whole pages, each time copying at most the old size
+    sb_set_growth(sb, sb_grow_pages);
+    memset(block, 'b', sizeof(block));
+    sb_append_strn(sb, block, 1002);
+    sb_append_strn(sb, block, 4000);
+    if (sb->size != 2 * SB_PAGE_SIZE || sb->pos != 6004 || sb->stats.reallocs != 6 ||
+        sb->stats.moves > sb->stats.reallocs || sb->stats.bytes_copied > 16 + 1001 + 1002 + 1002 + 1503 + 4096) {
+        fprintf(stderr, "Grew by pages to %zu bytes, should be %d\n", sb->size, 2 * SB_PAGE_SIZE);
+        return -1;
+    }
+
+    // Too long to ever fit, so nothing is appended
+    sb_append_strn(sb, "x", SIZE_MAX - 1);
+    if (sb->pos != 6004)    {
+        fprintf(stderr, "Appended a string longer than memory\n");
+        return -1;
+    }
+    sb_destroy(sb, 1);
+
+    // Lazily terminated, so none of the reserved pages are touched but the few written past 2GB
+    sb = sb_new_with_flags(16, SB_LAZY_NUL);
+    if (sb_reserve(sb, (size_t)3 << 30) == 0)   {
+        sb->pos = far;
+        sb_append_str(sb, "past ");
+        sb_append_strf(sb, "%dGB", 2);
+        if (sb->pos != far + 8 || strcmp(sb_cstring(sb) + far, "past 2GB"))  {
+            fprintf(stderr, "Appending past 2GB went wrong\n");
+            return -1;
+        }
+    } else {
+        fprintf(stderr, "Not enough address space to append past 2GB, skipping that\n");
+    }
+    sb_destroy(sb, 1);
+
+    return 0;
+}
+
+/**
+ * Sinks bound to a file descriptor and to a FILE, which must write out just what a builder keeping it
+ * all holds, without growing past what one append needs
+ */
+static int _test_sink() {
+    stringbuilder* expected = sb_new();
+    stringbuilder* sinks[2];
+    stringbuilder* sb;
+    FILE* files[2];
+    char long_str[300];
+    char* read_back;
+    size_t i, n;
+    int j;
+
+    memset(long_str, 'L', 299);
+    long_str[299] = '\0';
+
+    // One zero-filled and one lazily terminated
+    files[0] = tmpfile();
+    files[1] = tmpfile();
+    sinks[0] = sb_new_with_flags(0, 0);
+    sinks[1] = sb_new_with_flags(0, SB_LAZY_NUL);
+    if (!files[0] || !files[1] || sb_bind_fd(sinks[0], fileno(files[0]), 100) != 0 ||
+        sb_bind_file(sinks[1], files[1], 100) != 0 || sinks[0]->size != 101) {
+        fprintf(stderr, "Couldn't bind the sinks\n");
+        return -1;
+    }
+
+    for (i = 0; i < 2000; i++)  {
+        for (j = 0; j < 3; j++) {
+            sb = j < 2? sinks[j] : expected;
+            sb_append_strf(sb, "line %d: ", (int)i);
+            sb_append_i64(sb, -(int64_t)i * 1000003);
+            sb_append_ch(sb, ' ');
+            sb_append_double(sb, i / 7.0);
+            if (i % 100 == 0)   {
+                sb_append_str(sb, long_str);
+                if (j < 2 && sb->size < 300)   {
+                    fprintf(stderr, "Sink didn't grow for an append past its mark\n");
+                    return -1;
+                }
+            }
+            sb_append_ch(sb, '\n');
+        }
+
+        // Flushed before the mark is passed, and back down to it after the long string
+        for (j = 0; j < 2; j++) {
+            if (sinks[j]->size != 101 || sinks[j]->pos > 100)   {
+                fprintf(stderr, "Sink holds %zu in %zu bytes, should be at most 100 in 101\n", sinks[j]->pos,
+                    sinks[j]->size);
+                return -1;
+            }
+        }
+
+        for (n = sinks[0]->pos; n < sinks[0]->size; n++)    {
+            if (sinks[0]->cstr[n])  {
+                fprintf(stderr, "Sink isn't zero-filled past pos\n");
+                return -1;
+            }
+        }
+    }
+
+    read_back = (char*)malloc(expected->pos + 1);
+    for (j = 0; j < 2; j++) {
+        if (sb_flush(sinks[j]) != 0 || sinks[j]->pos != 0)   {
+            fprintf(stderr, "Sink didn't flush\n");
+            return -1;
+        }
+
+        fflush(files[j]);
+        rewind(files[j]);
+        n = fread(read_back, 1, expected->pos + 1, files[j]);
+        if (n != expected->pos || memcmp(read_back, expected->cstr, n))   {
+            fprintf(stderr, "Sink wrote %zu bytes, should be %zu\n", n, expected->pos);
+            return -1;
+        }
+
+        sb_destroy(sinks[j], 1);
+        fclose(files[j]);
+    }
+
+    // Nothing is lost when writing fails, the sink just grows
+    sb = sb_new_with_flags(0, SB_LAZY_NUL);
+    sb_bind_fd(sb, -1, 16);
+    sb_append_str(sb, long_str);
+    if (sb->pos != 299 || strcmp(sb_cstring(sb), long_str) || sb_flush(sb) != -1 || sb->pos != 299) {
+        fprintf(stderr, "Failed write lost the sink's string\n");
+        return -1;
+    }
+
+    sb_destroy(sb, 1);
+
+    // Bound when already bigger than the mark, it shrinks to it
+    sb = sb_new_with_flags(1000, 0);
+    sb_append_str(sb, "abc");
+    if (sb_bind_fd(sb, -1, 16) != 0 || sb->size != 17 || strcmp(sb->cstr, "abc"))   {
+        fprintf(stderr, "Binding kept %zu bytes, should be 17\n", sb->size);
+        return -1;
+    }
+
+    sb_destroy(sb, 1);
+    sb_destroy(expected, 1);
+    free(read_back);
+    return 0;
+}
+
 DEFINE_TEST_FUNCTION {  
     char *cstr;
+    char long_str[201];
+    char expected[512];
+    stringbuilder stack_sb;
     stringbuilder* sb = sb_new_with_size(1);
     if (0 != strlen(sb->cstr)) {
-        fprintf(stderr, "CSTR expected to have length 0, has length %d\n", strlen(sb->cstr));
+        fprintf(stderr, "CSTR expected to have length 0, has length %zu\n", strlen(sb->cstr));
         exit(-1);
     }
     
@@ -74,8 +415,96 @@ DEFINE_TEST_FUNCTION {
     
     sb_append_strf(sb, " And %s %s!", "even", "longer");
     _assert_sb_stats(sb, "Hi!This is a longer string that I am appending, doncha know? And even longer!", 128, 6);
-    
+
+    // Fits in the room left, so formats in place without growing
+    sb_append_strf(sb, " %d+%d=%d", 1, 2, 3);
+    _assert_sb_stats(sb, "Hi!This is a longer string that I am appending, doncha know? And even longer! 1+2=3", 128, 6);
+
+    // Doesn't fit, so grows once (to hold all 285 characters) and formats again
+    memset(long_str, 'x', 200);
+    long_str[200] = '\0';
+    sprintf(expected, "%s<%s>", sb_cstring(sb), long_str);
+    sb_append_strf(sb, "<%s>", long_str);
+    _assert_sb_stats(sb, expected, 512, 7);
+
     sb_destroy(sb, 1);
+
+    // Lazily terminated, so the longer string's bytes are still there past pos after the reset
+    sb = sb_new_with_flags(4, SB_LAZY_NUL);
+    sb_append_str(sb, "A long string that grows the buffer");
+    _assert_sb_stats(sb, "A long string that grows the buffer", 64, 1);
+
+    sb_reset(sb);
+    sb_append_str(sb, "Short");
+    _assert_sb_stats(sb, "Short", 64, 1);
+
+    sb_append_strf(sb, " and %d", 42);
+    sb_append_ch(sb, '!');
+    _assert_sb_stats(sb, "Short and 42!", 64, 1);
+
+    cstr = sb_make_cstring(sb);
+    if (strcmp(cstr, "Short and 42!"))  {
+        fprintf(stderr, "CSTR (%s) does not equal SB (%s)\n", cstr, sb_cstring(sb));
+        exit(-1);
+    }
+    free(cstr);
+
+    sb_destroy(sb, 1);
+
+    // On the stack, in the inline buffer until the string outgrows it
+    sb_init(&stack_sb, 0, 0, 0);
+    sb_append_strf(&stack_sb, "%s:%d", "localhost", 8080);
+    _assert_sb_stats(&stack_sb, "localhost:8080", SB_INLINE_SIZE, 0);
+    if (stack_sb.cstr != stack_sb.small)    {
+        fprintf(stderr, "Short string isn't in the inline buffer\n");
+        exit(-1);
+    }
+
+    sb_append_str(&stack_sb, "/a/path/long/enough/to/spill/to/the/heap");
+    _assert_sb_stats(&stack_sb, "localhost:8080/a/path/long/enough/to/spill/to/the/heap", 2 * SB_INLINE_SIZE, 1);
+    if (stack_sb.cstr == stack_sb.small)    {
+        fprintf(stderr, "Long string is still in the inline buffer\n");
+        exit(-1);
+    }
+    sb_destroy(&stack_sb, 1);
+
+    // In a buffer of the caller's, handing the heap string over to the caller at the end
+    sb_init(&stack_sb, long_str, 8, SB_LAZY_NUL);
+    sb_append_str(&stack_sb, "1234567");
+    if (stack_sb.cstr != long_str || strcmp(sb_cstring(&stack_sb), "1234567"))   {
+        fprintf(stderr, "String isn't in the caller's buffer\n");
+        exit(-1);
+    }
+
+    sb_append_ch(&stack_sb, '8');
+    _assert_sb_stats(&stack_sb, "12345678", 16, 1);
+    if (stack_sb.stats.moves != 1 || stack_sb.stats.bytes_copied != 7)   {
+        fprintf(stderr, "Moving to the heap copied %zu bytes, should be 7\n", stack_sb.stats.bytes_copied);
+        exit(-1);
+    }
+    cstr = sb_cstring(&stack_sb);
+    sb_destroy(&stack_sb, 0);
+    if (cstr == long_str || strcmp(cstr, "12345678"))   {
+        fprintf(stderr, "String didn't move to the heap\n");
+        exit(-1);
+    }
+    free(cstr);
+
+    if (_test_numbers() != 0)   {
+        fprintf(stderr, "Numeric appenders failed\n");
+        exit(-1);
+    }
+
+    if (_test_sizing() != 0)    {
+        fprintf(stderr, "Sizing failed\n");
+        exit(-1);
+    }
+
+    if (_test_sink() != 0)  {
+        fprintf(stderr, "Sinks failed\n");
+        exit(-1);
+    }
+
     return 0;
 }
 
@@ -0,0 +1,189 @@
+#include "test_utils.h"
+#include "platform.h"
+#include "timerwheel.h"
+
+#define TIMERS      200000
+#define HORIZON     (1 << 22)   /* Random timers are due within this many time units */
+
+typedef struct  {
+    uint64_t    expires;
+    int         fired;
+    int         rearm;          /* Times left to add it again when it expires */
+    tw_timer    timer;
+} item;
+
+static item _items[TIMERS];
+static timerwheel _wheel;
+static uint64_t _now, _before;  /* The times passed to this and the last tw_advance */
+static int _errors;
+
+/**
+ * Checks each timer is due, wasn't due at the last advance, and then maybe adds it again
+ */
+static void _expire(ilist* expired, void* arg)  {
+    ilist_node *n, *tmp;
+    item* it;
+
+    ILIST_FOREACH_SAFE(expired, n, tmp) {
+        it = ilist_entry(n, item, timer.link);
+        if (it->expires > _now || it->expires + (uint64_t)(size_t)arg <= _before || tw_pending(&it->timer))  {
+            _errors++;
+        }
+
+        it->fired++;
+        if (it->rearm > 0)  {
+            it->rearm--;
+            it->expires = _now + 1 + rand() % 5000;
+            tw_add(&_wheel, &it->timer, it->expires);
+        }
+    }
+}
+
+static int _advance(uint64_t now, uint64_t resolution)  {
+    int count;
+
+    _before = _now;
+    _now = now;
+    count = tw_advance(&_wheel, now, _expire, (void*)(size_t)resolution);
+    if (_errors)    {
+        fprintf(stderr, "Timer expired at the wrong time, at %llu\n", (unsigned long long)now);
+        return -1;
+    }
+
+    return count;
+}
+
+/**
+ * A few timers by hand: rounding to ticks, times already past, cancelling, and a timer beyond the range
+ */
+static int _test_basic()    {
+    uint64_t far = 1000 + 10 * (TWHEEL_RANGE + 12345);
+    int i;
+
+    if (tw_init(&_wheel, 0, 0) != -1 || tw_init(&_wheel, 10, 1000) != 0)    {
+        fprintf(stderr, "Bad initialization\n");
+        return -1;
+    }
+
+    for (i = 0; i < 6; i++) {
+        tw_timer_init(&_items[i].timer);
+        _items[i].fired = _items[i].rearm = 0;
+    }
+
+    _items[0].expires = 500;        // Already past
+    _items[1].expires = 1010;       // Exactly on a tick
+    _items[2].expires = 1011;       // Rounds up to the next
+    _items[3].expires = 1000 + 10 * 300;
+    _items[4].expires = 1000 + 10 * 70000;
+    _items[5].expires = far;
+    for (i = 0; i < 6; i++) {
+        if (tw_add(&_wheel, &_items[i].timer, _items[i].expires) != 0)  {
+            fprintf(stderr, "Couldn't add timer %d\n", i);
+            return -1;
+        }
+    }
+
+    if (tw_add(&_wheel, &_items[0].timer, 2000) != -1 || tw_size(&_wheel) != 6)    {
+        fprintf(stderr, "Pending timer added again\n");
+        return -1;
+    }
+
+    _now = 0;
+    if (_advance(1009, 10) != 1 || !_items[0].fired || _advance(1010, 10) != 1 || !_items[1].fired ||
+        _advance(1019, 10) != 0 || _advance(1020, 10) != 1 || !_items[2].fired)   {
+        fprintf(stderr, "Timers near now expired wrong\n");
+        return -1;
+    }
+
+    // With the first wheel empty, advancing mustn't skip past now and make a timer added next late
+    if (_advance(1030, 10) != 0 || tw_add(&_wheel, &_items[1].timer, _items[1].expires = 1045) != 0 ||
+        _advance(1049, 10) != 0 || _advance(1050, 10) != 1 || _items[1].fired != 2)    {
+        fprintf(stderr, "Timer added after an idle advance expired wrong\n");
+        return -1;
+    }
+
+    if (tw_cancel(&_wheel, &_items[3].timer) != 0 || tw_cancel(&_wheel, &_items[3].timer) != -1 ||
+        tw_cancel(&_wheel, &_items[0].timer) != -1 || tw_size(&_wheel) != 2)    {
+        fprintf(stderr, "Cancelling went wrong\n");
+        return -1;
+    }
+
+    if (_advance(_items[4].expires - 1, 10) != 0 || _advance(_items[4].expires, 10) != 1 || _items[3].fired)   {
+        fprintf(stderr, "Cascaded timer expired wrong\n");
+        return -1;
+    }
+
+    if (_advance(far - 10, 10) != 0 || _advance(far, 10) != 1 || !_items[5].fired || tw_size(&_wheel) != 0)  {
+        fprintf(stderr, "Timer beyond the range expired wrong\n");
+        return -1;
+    }
+
+    tw_destroy(&_wheel);
+    return 0;
+}
+
+/**
+ * Lots of random timers, some cancelled, some added again as they expire, with the wheel advanced by
+ * random steps
+ */
+static int _test_random(uint64_t resolution)    {
+    int i, fired = 0, expected = 0, n;
+
+    tw_init(&_wheel, resolution, 0);
+    _now = 0;
+    for (i = 0; i < TIMERS; i++)    {
+        tw_timer_init(&_items[i].timer);
+        _items[i].expires = rand() % HORIZON;
+        _items[i].fired = 0;
+        _items[i].rearm = i % 10 == 0? 3 : 0;
+        tw_add(&_wheel, &_items[i].timer, _items[i].expires);
+    }
+
+    for (i = 0; i < TIMERS; i += 4) {
+        tw_cancel(&_wheel, &_items[i].timer);
+    }
+
+    while (tw_size(&_wheel))    {
+        if ((n = _advance(_now + rand() % 3000, resolution)) < 0)   {
+            return -1;
+        }
+        fired += n;
+    }
+
+    for (i = 0; i < TIMERS; i++)    {
+        n = i % 4 == 0? 0 : 1 + (i % 10 == 0? 3 : 0);
+        if (_items[i].fired != n)   {
+            fprintf(stderr, "Timer %d expired %d times, should be %d\n", i, _items[i].fired, n);
+            return -1;
+        }
+        expected += n;
+    }
+
+    if (fired != expected)  {
+        fprintf(stderr, "tw_advance counted %d expiries, should be %d\n", fired, expected);
+        return -1;
+    }
+
+    tw_destroy(&_wheel);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    srand(7);
+
+    if (_test_basic() != 0) {
+        fprintf(stderr, "Basic timers failed\n");
+        return -1;
+    }
+
+    if (_test_random(1) != 0 || _test_random(7) != 0)   {
+        fprintf(stderr, "Random timers failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
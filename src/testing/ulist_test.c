@@ -0,0 +1,140 @@
+#include "test_utils.h"
+#include "platform.h"
+#include "ulist.h"
+
+/**
+ * Checks that walking the list gives "count" values counting up from "first"
+ */
+static int _check_walk(ulist* l, int first, int count)  {
+    void** e;
+    int n;
+
+    if (ulist_size(l) != count) {
+        fprintf(stderr, "List has %d values, should have %d\n", ulist_size(l), count);
+        return -1;
+    }
+
+    n = 0;
+    for (e = ulist_head(l); e; e = ulist_next(e))   {
+        if ((size_t)ulist_data(e) != (size_t)(first + n))   {
+            fprintf(stderr, "Value %d is %d\n", n, (int)(size_t)ulist_data(e));
+            return -1;
+        }
+        n++;
+    }
+
+    if (n != count || (count && ulist_data(ulist_tail(l)) != (void*)(size_t)(first + count - 1))) {
+        fprintf(stderr, "Walked %d values, should have walked %d\n", n, count);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Values appended and prepended come back in order, and removing from the front frees emptied chunks
+ */
+static int _test_order()    {
+    void* data;
+    ulist l;
+    int i;
+
+    ulist_init(&l, 0);
+    if (ulist_head(&l) != 0 || ulist_tail(&l) != 0 || ulist_remove_head(&l, &data) != -1)  {
+        fprintf(stderr, "Empty list is wrong\n");
+        return -1;
+    }
+
+    /* 1000 to 1999 appended, then 999 down to 0 prepended */
+    for (i = 1000; i < 2000; i++)   {
+        if (ulist_append(&l, (void*)(size_t)i) != 0)    {
+            fprintf(stderr, "Error appending %d\n", i);
+            return -1;
+        }
+    }
+
+    for (i = 999; i >= 0; i--)  {
+        if (ulist_prepend(&l, (void*)(size_t)i) != 0)   {
+            fprintf(stderr, "Error prepending %d\n", i);
+            return -1;
+        }
+    }
+
+    if (_check_walk(&l, 0, 2000) != 0)  {
+        return -1;
+    }
+
+    for (i = 0; i < 1500; i++)  {
+        if (ulist_remove_head(&l, &data) != 0 || data != (void*)(size_t)i) {
+            fprintf(stderr, "Removed the wrong value\n");
+            return -1;
+        }
+    }
+
+    if (_check_walk(&l, 1500, 500) != 0)    {
+        return -1;
+    }
+
+    /* Emptying the list and using it again */
+    while (ulist_remove_head(&l, &data) == 0)   {
+    }
+
+    if (l.head || l.tail || _check_walk(&l, 0, 0) != 0) {
+        fprintf(stderr, "List not empty after removing everything\n");
+        return -1;
+    }
+
+    ulist_prepend(&l, (void*)(size_t)1);
+    ulist_append(&l, (void*)(size_t)2);
+    ulist_prepend(&l, (void*)(size_t)0);
+    if (_check_walk(&l, 0, 3) != 0) {
+        return -1;
+    }
+
+    ulist_destroy(&l);
+    return 0;
+}
+
+/**
+ * Destroying the list calls destroy on every value
+ */
+static int _test_destroy()  {
+    char buf[32];
+    ulist l;
+    int i;
+
+    ulist_init(&l, free);
+    for (i = 0; i < 100; i++)   {
+        sprintf(buf, "value%d", i);
+        if ((i % 2? ulist_append(&l, xp_strdup(buf)) : ulist_prepend(&l, xp_strdup(buf))) != 0)   {
+            fprintf(stderr, "Error adding %s\n", buf);
+            return -1;
+        }
+    }
+
+    if (strcmp((char*)ulist_data(ulist_head(&l)), "value98") || strcmp((char*)ulist_data(ulist_tail(&l)), "value99"))   {
+        fprintf(stderr, "Head or tail is wrong\n");
+        return -1;
+    }
+
+    ulist_destroy(&l);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    if (_test_order() != 0) {
+        fprintf(stderr, "Order failed\n");
+        return -1;
+    }
+
+    if (_test_destroy() != 0)   {
+        fprintf(stderr, "Destroy failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
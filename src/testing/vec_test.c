@@ -0,0 +1,197 @@
+#include "test_utils.h"
+#include "platform.h"
+#include "vec.h"
+
+VEC_DECLARE(ints, int, vec_cmp_num)
+VEC_DECLARE(strs, const char*, vec_cmp_str)
+
+/**
+ * Checks that the array holds the given values
+ */
+static int _check(ints* v, const int* values, size_t count) {
+    size_t i;
+
+    if (vec_size(v) != count || vec_capacity(v) < count)    {
+        fprintf(stderr, "Array has %d values, should have %d\n", (int)vec_size(v), (int)count);
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (v->data[i] != values[i])    {
+            fprintf(stderr, "Value %d is %d, should be %d\n", (int)i, v->data[i], values[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Growth, reserve and shrinking, and bulk inserts and erases
+ */
+static int _test_edit() {
+    static const int digits[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    static const int after_insert[] = { 0, 1, 7, 8, 9, 2, 3, 4, 5, 6, 7, 8, 9 };
+    static const int after_erase[] = { 0, 1, 7, 5, 6, 7, 8, 9 };
+    size_t capacity;
+    ints v;
+    int i, val;
+
+    if (ints_init(&v, 0) != 0 || v.data != 0 || ints_pop(&v, &val) != -1)  {
+        fprintf(stderr, "Empty array is wrong\n");
+        return -1;
+    }
+
+    /* Geometric growth means only a few reallocations for many pushes */
+    capacity = 0;
+    for (i = 0; i < 100000; i++)    {
+        if (ints_push(&v, i) != 0)  {
+            fprintf(stderr, "Error pushing %d\n", i);
+            return -1;
+        }
+        if (vec_capacity(&v) != capacity)   {
+            if (vec_capacity(&v) < capacity * 2)    {
+                fprintf(stderr, "Capacity grew from %d to %d\n", (int)capacity, (int)vec_capacity(&v));
+                return -1;
+            }
+            capacity = vec_capacity(&v);
+        }
+    }
+
+    if (ints_pop(&v, &val) != 0 || val != 99999 || ints_shrink_to_fit(&v) != 0 || vec_capacity(&v) != 99999) {
+        fprintf(stderr, "Pop or shrink is wrong\n");
+        return -1;
+    }
+
+    /* Erasing everything and starting over */
+    if (ints_erase(&v, 0, 99999) != 0 || vec_size(&v) != 0 || ints_shrink_to_fit(&v) != 0 || v.data != 0)   {
+        fprintf(stderr, "Erasing everything is wrong\n");
+        return -1;
+    }
+
+    if (ints_reserve(&v, 50) != 0 || vec_capacity(&v) != 50 || ints_append(&v, digits, 10) != 0 ||
+        _check(&v, digits, 10) != 0)    {
+        fprintf(stderr, "Reserve or append is wrong\n");
+        return -1;
+    }
+
+    if (ints_insert(&v, 2, digits + 7, 3) != 0 || _check(&v, after_insert, 13) != 0)    {
+        fprintf(stderr, "Insert is wrong\n");
+        return -1;
+    }
+
+    if (ints_erase(&v, 3, 5) != 0 || _check(&v, after_erase, 8) != 0)  {
+        fprintf(stderr, "Erase is wrong\n");
+        return -1;
+    }
+
+    if (ints_insert(&v, 9, digits, 1) != -1 || ints_erase(&v, 6, 3) != -1 || ints_erase(&v, 8, 0) != 0 ||
+        _check(&v, after_erase, 8) != 0)    {
+        fprintf(stderr, "Out of range inserts or erases were accepted\n");
+        return -1;
+    }
+
+    ints_destroy(&v);
+    return 0;
+}
+
+/**
+ * Sorts random, sorted, reversed and constant arrays, and binary searches the results
+ */
+static int _test_sort() {
+    uint32_t x = 2463534242u;
+    size_t i, n;
+    int kind;
+    ints v;
+
+    ints_init(&v, 0);
+    for (kind = 0; kind < 5; kind++)    {
+        for (n = 0; n < 5000; n = n * 3 + 1)    {
+            v.size = 0;
+            for (i = 0; i < n; i++) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                switch (kind)   {
+                case 0:     ints_push(&v, (int)(x % 1000000));  break;
+                case 1:     ints_push(&v, (int)i);              break;
+                case 2:     ints_push(&v, (int)(n - i));        break;
+                case 3:     ints_push(&v, 7);                   break;
+                default:    ints_push(&v, (int)(x % 3));        break;
+                }
+            }
+
+            ints_sort(&v);
+            for (i = 1; i < n; i++) {
+                if (v.data[i - 1] > v.data[i])  {
+                    fprintf(stderr, "%d values of kind %d not sorted at %d\n", (int)n, kind, (int)i);
+                    return -1;
+                }
+            }
+
+            for (i = 0; i < n; i++) {
+                if (*ints_search(&v, v.data[i]) != v.data[i] || v.data[ints_lower_bound(&v, v.data[i])] != v.data[i])   {
+                    fprintf(stderr, "Search didn't find %d\n", v.data[i]);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    if (ints_search(&v, -1) != 0 || ints_lower_bound(&v, 1000) != vec_size(&v))    {
+        fprintf(stderr, "Search found a missing value\n");
+        return -1;
+    }
+
+    ints_destroy(&v);
+    return 0;
+}
+
+/**
+ * An array of strings
+ */
+static int _test_strings()  {
+    static const char* words[] = { "pear", "apple", "fig", "kiwi", "banana" };
+    const char** found;
+    strs v;
+
+    strs_init(&v, 5);
+    strs_append(&v, words, 5);
+    strs_sort(&v);
+
+    if (strcmp(v.data[0], "apple") || strcmp(v.data[4], "pear") || strs_lower_bound(&v, "cherry") != 2)  {
+        fprintf(stderr, "Strings not sorted\n");
+        return -1;
+    }
+
+    if ((found = strs_search(&v, "kiwi")) == 0 || found != &v.data[3] || strs_search(&v, "plum") != 0)   {
+        fprintf(stderr, "String search is wrong\n");
+        return -1;
+    }
+
+    strs_destroy(&v);
+    return 0;
+}
+
+DEFINE_TEST_FUNCTION {
+    if (_test_edit() != 0)  {
+        fprintf(stderr, "Edit failed\n");
+        return -1;
+    }
+
+    if (_test_sort() != 0)  {
+        fprintf(stderr, "Sort failed\n");
+        return -1;
+    }
+
+    if (_test_strings() != 0)   {
+        fprintf(stderr, "Strings failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    RUN_TEST;
+}
@@ -0,0 +1,164 @@
+/**
+ * Fixed size thread pool
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "threadpool.h"
+
+/* Room for this many queued jobs to start with, the ring doubles when it fills up */
+#define THREADPOOL_INITIAL_JOBS     64
+
+/**
+ * Takes the next job off the queue and runs it with the lock released.  The lock must be held and the
+ * queue must not be empty
+ */
+static void _run_one(threadpool* tp)    {
+    threadpool_job job = tp->jobs[tp->first];
+
+    tp->first = (tp->first + 1) % tp->capacity;
+    tp->queued--;
+    tp->running++;
+
+    pthread_mutex_unlock(&tp->lock);
+    job.fn(job.arg);
+    pthread_mutex_lock(&tp->lock);
+
+    if (--tp->running == 0 && tp->queued == 0)  {
+        pthread_cond_broadcast(&tp->idle);
+    }
+}
+
+static void* _worker(void* arg) {
+    threadpool* tp = (threadpool*)arg;
+
+    pthread_mutex_lock(&tp->lock);
+    for (;;)    {
+        while (tp->queued == 0 && !tp->stop)    {
+            pthread_cond_wait(&tp->work, &tp->lock);
+        }
+
+        if (tp->queued == 0)    {
+            break;
+        }
+        _run_one(tp);
+    }
+    pthread_mutex_unlock(&tp->lock);
+
+    return 0;
+}
+
+/**
+ * Initializes the given pool and starts "threads" threads
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int threadpool_init(threadpool* tp, int threads)    {
+    memset(tp, 0, sizeof(threadpool));
+    if (threads < 0)    {
+        return -1;
+    }
+
+    tp->jobs = (threadpool_job*)malloc(THREADPOOL_INITIAL_JOBS * sizeof(threadpool_job));
+    tp->threads = (pthread_t*)malloc((threads? threads : 1) * sizeof(pthread_t));
+    if (!tp->jobs || !tp->threads)  {
+        free(tp->jobs);
+        free(tp->threads);
+        return -1;
+    }
+
+    tp->capacity = THREADPOOL_INITIAL_JOBS;
+    pthread_mutex_init(&tp->lock, 0);
+    pthread_cond_init(&tp->work, 0);
+    pthread_cond_init(&tp->idle, 0);
+
+    for (tp->count = 0; tp->count < threads; tp->count++)   {
+        if (pthread_create(&tp->threads[tp->count], 0, _worker, tp) != 0)   {
+            threadpool_destroy(tp);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Waits for every queued job to finish, then stops the threads and frees the pool
+ */
+void threadpool_destroy(threadpool* tp) {
+    int i;
+
+    threadpool_wait(tp);
+
+    pthread_mutex_lock(&tp->lock);
+    tp->stop = 1;
+    pthread_cond_broadcast(&tp->work);
+    pthread_mutex_unlock(&tp->lock);
+
+    for (i = 0; i < tp->count; i++) {
+        pthread_join(tp->threads[i], 0);
+    }
+
+    pthread_mutex_destroy(&tp->lock);
+    pthread_cond_destroy(&tp->work);
+    pthread_cond_destroy(&tp->idle);
+    free(tp->jobs);
+    free(tp->threads);
+    memset(tp, 0, sizeof(threadpool));
+}
+
+/**
+ * Queues fn(arg) to be run by the pool
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int threadpool_submit(threadpool* tp, void (*fn)(void* arg), void* arg) {
+    threadpool_job* jobs;
+    int i;
+
+    pthread_mutex_lock(&tp->lock);
+    if (tp->queued == tp->capacity) {
+        // Unroll the ring into the front of a ring twice the size
+        if ((jobs = (threadpool_job*)malloc(2 * tp->capacity * sizeof(threadpool_job))) == 0)   {
+            pthread_mutex_unlock(&tp->lock);
+            return -1;
+        }
+
+        for (i = 0; i < tp->queued; i++)    {
+            jobs[i] = tp->jobs[(tp->first + i) % tp->capacity];
+        }
+
+        free(tp->jobs);
+        tp->jobs = jobs;
+        tp->first = 0;
+        tp->capacity *= 2;
+    }
+
+    tp->jobs[(tp->first + tp->queued) % tp->capacity].fn = fn;
+    tp->jobs[(tp->first + tp->queued) % tp->capacity].arg = arg;
+    tp->queued++;
+    pthread_cond_signal(&tp->work);
+    pthread_cond_signal(&tp->idle);
+    pthread_mutex_unlock(&tp->lock);
+
+    return 0;
+}
+
+/**
+ * Runs queued jobs on the calling thread until the queue is empty, then waits for the rest to finish
+ */
+void threadpool_wait(threadpool* tp)    {
+    pthread_mutex_lock(&tp->lock);
+    for (;;)    {
+        if (tp->queued > 0) {
+            _run_one(tp);
+        } else if (tp->running > 0) {
+            // Woken when they are done, or when one of them queues another job to help with
+            pthread_cond_wait(&tp->idle, &tp->lock);
+        } else {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&tp->lock);
+}
@@ -0,0 +1,179 @@
+/**
+ * Hierarchical timer wheel
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "timerwheel.h"
+
+#define TWHEEL_MASK         (TWHEEL_SLOTS - 1)
+
+/* Ticks covered by one slot of the given wheel */
+#define TWHEEL_SPAN(level)  ((uint64_t)1 << ((level) * TWHEEL_SLOT_BITS))
+
+/**
+ * Links a timer into the slot for its tick, which depends on how far off it is
+ */
+static void _place(timerwheel* w, tw_timer* t)  {
+    uint64_t tick = t->tick < w->tick? w->tick : t->tick;
+    int level = 0;
+
+    if (tick - w->tick >= TWHEEL_RANGE) {
+        tick = w->tick + TWHEEL_RANGE - 1;
+    }
+
+    while (tick - w->tick >= TWHEEL_SPAN(level + 1))    {
+        level++;
+    }
+
+    t->slot = &w->slots[level * TWHEEL_SLOTS + ((tick >> (level * TWHEEL_SLOT_BITS)) & TWHEEL_MASK)];
+    ilist_push_back(t->slot, &t->link);
+    if (level == 0) {
+        w->near++;
+    }
+}
+
+/**
+ * Moves the timers in the given slot of a coarser wheel down to where they now belong
+ */
+static void _cascade(timerwheel* w, int level, int index)   {
+    ilist* slot = &w->slots[level * TWHEEL_SLOTS + index];
+    tw_timer* t;
+
+    while (ilist_size(slot))    {
+        t = ilist_entry(ilist_first(slot), tw_timer, link);
+        ilist_remove(slot, &t->link);
+        _place(w, t);
+    }
+}
+
+/**
+ * Initializes the given wheel
+ *
+ * Returns 0 if the wheel was initialized successfully, -1 otherwise
+ */
+int tw_init(timerwheel* w, uint64_t resolution, uint64_t now)   {
+    int i;
+
+    memset(w, 0, sizeof(timerwheel));
+    if (resolution == 0 ||
+        (w->slots = (ilist*)malloc(TWHEEL_LEVELS * TWHEEL_SLOTS * sizeof(ilist))) == 0)    {
+        return -1;
+    }
+
+    for (i = 0; i < TWHEEL_LEVELS * TWHEEL_SLOTS; i++)  {
+        ilist_init(&w->slots[i]);
+    }
+
+    w->origin = now;
+    w->resolution = resolution;
+    return 0;
+}
+
+/**
+ * Destroys the given wheel
+ */
+void tw_destroy(timerwheel* w)  {
+    free(w->slots);
+    memset(w, 0, sizeof(timerwheel));
+}
+
+/**
+ * Schedules the timer
+ *
+ * Returns 0 if successful, -1 if the timer is already pending
+ */
+int tw_add(timerwheel* w, tw_timer* t, uint64_t expires)    {
+    uint64_t since;
+
+    if (t->slot)    {
+        return -1;
+    }
+
+    // Round up, so the timer never expires early
+    since = expires > w->origin? expires - w->origin : 0;
+    t->tick = since / w->resolution + (since % w->resolution != 0);
+
+    _place(w, t);
+    w->size++;
+    return 0;
+}
+
+/**
+ * Unschedules the timer
+ *
+ * Returns 0 if successful, -1 if the timer wasn't pending
+ */
+int tw_cancel(timerwheel* w, tw_timer* t)   {
+    if (!t->slot)   {
+        return -1;
+    }
+
+    if (t->slot < w->slots + TWHEEL_SLOTS)  {
+        w->near--;
+    }
+
+    ilist_remove(t->slot, &t->link);
+    t->slot = 0;
+    w->size--;
+    return 0;
+}
+
+/**
+ * Runs the wheel forward to time "now"
+ *
+ * Returns the number of timers expired
+ */
+int tw_advance(timerwheel* w, uint64_t now, void (*expire)(ilist* expired, void* arg), void* arg) {
+    uint64_t last, next;
+    ilist expired;
+    ilist* slot;
+    tw_timer* t;
+    int level, count = 0;
+
+    if (now < w->origin)    {
+        return 0;
+    }
+
+    last = (now - w->origin) / w->resolution;
+    while (w->tick <= last) {
+        if (w->size == 0)   {
+            w->tick = last + 1;
+            break;
+        }
+
+        // Each time a wheel comes round to slot 0, the next slot of the wheel above is due to come down
+        for (level = 1; level < TWHEEL_LEVELS && (w->tick & (TWHEEL_SPAN(level) - 1)) == 0; level++)   {
+            _cascade(w, level, (int)((w->tick >> (level * TWHEEL_SLOT_BITS)) & TWHEEL_MASK));
+        }
+
+        // Nothing in the first wheel, so skip straight to its next turn (or to "now")
+        if (w->near == 0)   {
+            next = (w->tick | TWHEEL_MASK) + 1;
+            w->tick = next <= last? next : last + 1;
+            continue;
+        }
+
+        slot = &w->slots[w->tick & TWHEEL_MASK];
+        w->tick++;
+        if (ilist_size(slot) == 0)  {
+            continue;
+        }
+
+        ilist_init(&expired);
+        while (ilist_size(slot))    {
+            t = ilist_entry(ilist_first(slot), tw_timer, link);
+            ilist_remove(slot, &t->link);
+            ilist_push_back(&expired, &t->link);
+            t->slot = 0;
+        }
+
+        w->size -= ilist_size(&expired);
+        w->near -= ilist_size(&expired);
+        count += ilist_size(&expired);
+        expire(&expired, arg);
+    }
+
+    return count;
+}
@@ -0,0 +1,136 @@
+/**
+ * Unrolled list implementation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ulist.h"
+
+typedef char _ulist_chunk_size_check[sizeof(ulist_chunk) == ULIST_CHUNK_BYTES? 1 : -1];
+
+/**
+ * Allocates an empty chunk whose values will start at slot "start"
+ *
+ * Returns the chunk, or NULL if it couldn't be allocated
+ */
+static ulist_chunk* _chunk_alloc(unsigned int start)    {
+    ulist_chunk* c;
+
+    if ((c = (ulist_chunk*)aligned_alloc(ULIST_CHUNK_BYTES, sizeof(ulist_chunk))) == 0)  {
+        return 0;
+    }
+
+    c->next = 0;
+    c->first = c->end = start;
+    return c;
+}
+
+/**
+ * Initializes the unrolled list pointed to by "l"
+ */
+void ulist_init(ulist* l, void (*destroy)(void* data))  {
+    l->size = 0;
+    l->destroy = destroy;
+
+    l->head = 0;
+    l->tail = 0;
+}
+
+/**
+ * Destroys the entire list pointed to by "l"
+ */
+void ulist_destroy(ulist* l)    {
+    ulist_chunk *c, *next;
+    unsigned int i;
+
+    for (c = l->head; c; c = next)  {
+        if (l->destroy) {
+            for (i = c->first; i < c->end; i++) {
+                l->destroy(c->items[i]);
+            }
+        }
+
+        next = c->next;
+        free(c);
+    }
+
+    memset(l, 0, sizeof(ulist));
+}
+
+/**
+ * Adds data at the end of the list
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int ulist_append(ulist* l, const void* data)    {
+    ulist_chunk* c = l->tail;
+
+    if (!c || c->end == ULIST_CHUNK_SLOTS)  {
+        if ((c = _chunk_alloc(0)) == 0) {
+            return -1;
+        }
+
+        if (l->tail)    {
+            l->tail->next = c;
+        } else {
+            l->head = c;
+        }
+        l->tail = c;
+    }
+
+    c->items[c->end++] = (void*)data;
+    l->size++;
+    return 0;
+}
+
+/**
+ * Adds data at the front of the list
+ *
+ * Returns 0 if successful, -1 otherwise
+ */
+int ulist_prepend(ulist* l, const void* data)   {
+    ulist_chunk* c = l->head;
+
+    if (!c || c->first == 0)    {
+        // Fill new head chunks from the back, so repeated prepends don't need a chunk each
+        if ((c = _chunk_alloc(ULIST_CHUNK_SLOTS)) == 0) {
+            return -1;
+        }
+
+        c->next = l->head;
+        if (!l->tail)   {
+            l->tail = c;
+        }
+        l->head = c;
+    }
+
+    c->items[--c->first] = (void*)data;
+    l->size++;
+    return 0;
+}
+
+/**
+ * Removes the first value in the list
+ *
+ * Returns 0 if successful, -1 if the list is empty
+ */
+int ulist_remove_head(ulist* l, void** data)    {
+    ulist_chunk* c = l->head;
+
+    if (ulist_size(l) == 0) {
+        return -1;
+    }
+
+    *data = c->items[c->first++];
+    if (c->first == c->end) {
+        l->head = c->next;
+        if (!l->head)   {
+            l->tail = 0;
+        }
+        free(c);
+    }
+
+    l->size--;
+    return 0;
+}